@@ -0,0 +1,130 @@
+/* Binary ncopy drivers, built directly in simulator memory */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "isa.h"
+#include "driver.h"
+
+char *driver_result_names[] = {
+    "OK", "Couldn't run to completion", "Bad count", "Incorrect copying",
+    "Corruption before or after destination", "Program too long"
+};
+
+static word_t align_up(word_t addr, word_t align)
+{
+    return (addr + align - 1) & ~(align - 1);
+}
+
+word_t driver_load(mem_t m, FILE *f)
+{
+    if (load_mem(m, f, 1) == 0)
+	return 0;
+    return m->load_end;
+}
+
+bool_t driver_parse(char *spec, word_t *n, unsigned *seed, bool_t *random)
+{
+    char *end;
+
+    *n = strtoll(spec, &end, 10);
+    if (end == spec || *n < 0)
+	return FALSE;
+    *seed = 1 + *n;
+    *random = FALSE;
+    if (*end == ':') {
+	spec = end+1;
+	*seed = strtoul(spec, &end, 10);
+	if (end == spec)
+	    return FALSE;
+	*random = TRUE;
+    }
+    return *end == '\0';
+}
+
+/* Emit an instruction at addr, returning the address after it */
+static word_t emit(mem_t m, word_t addr, byte_t icode, byte_t regids,
+		   bool_t has_regids, bool_t has_valc, word_t valc)
+{
+    set_byte_val(m, addr++, HPACK(icode, F_NONE));
+    if (has_regids)
+	set_byte_val(m, addr++, regids);
+    if (has_valc) {
+	set_word_val(m, addr, valc);
+	addr += 8;
+    }
+    return addr;
+}
+
+void driver_build(mem_t m, word_t code_len, word_t n, unsigned seed,
+		  bool_t random, driver_t *d)
+{
+    word_t tval = n/2, rval = 0;
+    word_t addr, i;
+
+    /* main is 4 irmovq's of 10 bytes, a call of 9 and a halt */
+    d->n = n;
+    d->main = align_up(code_len, 16);
+    d->src = align_up(d->main + 50, 8);
+    d->predest = align_up(d->src + 8*n + 8, 16);
+    d->dest = d->predest + 8;
+    d->postdest = d->dest + 8*n;
+    d->stack = align_up(d->postdest + 8, 8) + 16*8;
+
+    addr = d->main;
+    addr = emit(m, addr, I_IRMOVQ, HPACK(REG_NONE, REG_RSP),
+		TRUE, TRUE, d->stack);
+    addr = emit(m, addr, I_IRMOVQ, HPACK(REG_NONE, REG_RDX),
+		TRUE, TRUE, n);
+    addr = emit(m, addr, I_IRMOVQ, HPACK(REG_NONE, REG_RSI),
+		TRUE, TRUE, d->dest);
+    addr = emit(m, addr, I_IRMOVQ, HPACK(REG_NONE, REG_RDI),
+		TRUE, TRUE, d->src);
+    addr = emit(m, addr, I_CALL, 0, FALSE, TRUE, 0);
+    addr = emit(m, addr, I_HALT, 0, FALSE, FALSE, 0);
+
+    for (i = 0; i < n; i++) {
+	word_t val = -(i+1);
+	bool_t pos;
+	if (random)
+	    pos = rand_r(&seed) % 2 == 1;
+	else
+	    pos = (rval < tval && rand_r(&seed) % 2 == 1) ||
+		tval - rval >= n - i;
+	if (pos) {
+	    val = -val;
+	    rval++;
+	}
+	set_word_val(m, d->src + 8*i, val);
+	set_word_val(m, d->dest + 8*i, DRIVER_DESTVAL);
+    }
+    set_word_val(m, d->src + 8*n, DRIVER_PREVAL);
+    set_word_val(m, d->predest, DRIVER_PREVAL);
+    set_word_val(m, d->postdest, DRIVER_POSTVAL);
+    d->count = rval;
+}
+
+driver_result_t driver_check(mem_t m, mem_t r, stat_t status, driver_t *d,
+			     word_t code_len, word_t bytelim)
+{
+    word_t i, sval, dval;
+
+    if (bytelim > 0 && code_len > bytelim)
+	return DRV_LONG;
+    if (status != STAT_HLT)
+	return DRV_STATUS;
+    if (get_reg_val(r, REG_RAX) != d->count)
+	return DRV_COUNT;
+    for (i = 0; i < d->n; i++) {
+	get_word_val(m, d->src + 8*i, &sval);
+	get_word_val(m, d->dest + 8*i, &dval);
+	if (sval != dval)
+	    return DRV_COPY;
+    }
+    get_word_val(m, d->predest, &dval);
+    get_word_val(m, d->postdest, &sval);
+    if (dval != DRIVER_PREVAL || sval != DRIVER_POSTVAL)
+	return DRV_CORRUPT;
+    return DRV_OK;
+}
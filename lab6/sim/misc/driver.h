@@ -0,0 +1,67 @@
+/* Binary ncopy drivers, built directly in simulator memory */
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <stdio.h>
+#include "isa.h"
+
+/*
+ * A driver runs an ncopy function that was assembled on its own by
+ * yas, so that ncopy starts at address 0 and its code ends at the
+ * extent of the object file.  Instead of the text that gen-driver.pl
+ * writes and yas assembles, the driver is built as machine code and
+ * data right after the function: a main routine that sets up the
+ * stack and the arguments, calls ncopy and halts, followed by the
+ * source block, the destination block between two guard words, and
+ * the stack.  The checks that gen-driver.pl -c compiles into the
+ * driver are made by driver_check once the program has run.
+ */
+
+#define DRIVER_BYTE_LIMIT 1000  /* Longest allowed ncopy, in bytes */
+#define DRIVER_PREVAL 0xbcdefa  /* Guard words around the destination */
+#define DRIVER_POSTVAL 0xdefabc
+#define DRIVER_DESTVAL 0xcdefab /* Initial destination contents */
+
+/* Outcome of a driver run, as reported by correctness.pl */
+typedef enum { DRV_OK, DRV_STATUS, DRV_COUNT, DRV_COPY, DRV_CORRUPT,
+	       DRV_LONG } driver_result_t;
+
+extern char *driver_result_names[];
+
+/* Where the driver put things */
+typedef struct {
+    word_t n;             /* Block length */
+    word_t main, src, predest, dest, postdest, stack;
+    word_t count;         /* Number of positive source words */
+} driver_t;
+
+/*
+ * Load the ncopy object file or binary image f into m, and return the
+ * length of its code in bytes, or 0 if f holds no code
+ */
+word_t driver_load(mem_t m, FILE *f);
+
+/*
+ * Parse a driver specification n[:seed].  Without a seed, exactly n/2
+ * of the words are positive and the seed is 1+n, as for --sweep in
+ * psim.  With one, each word is positive with probability 1/2, as
+ * with gen-driver.pl -r.  Returns FALSE if spec is malformed
+ */
+bool_t driver_parse(char *spec, word_t *n, unsigned *seed, bool_t *random);
+
+/*
+ * Write the driver for block length n into m, after code_len bytes of
+ * ncopy, and fill in d.  Element i of the source is -(i+1) or i+1.
+ * The program should be started at d->main
+ */
+void driver_build(mem_t m, word_t code_len, word_t n, unsigned seed,
+		  bool_t random, driver_t *d);
+
+/*
+ * Check the memory m and registers r of a driver run that stopped
+ * with status.  The length check is skipped if bytelim is 0
+ */
+driver_result_t driver_check(mem_t m, mem_t r, stat_t status, driver_t *d,
+			     word_t code_len, word_t bytelim);
+
+#endif /* DRIVER_H */
@@ -132,54 +132,217 @@ instr_ptr bad_instr()
 }
 
 
-mem_t init_mem(int len)
+/* Access 8 bytes of memory in little-endian order */
+static inline word_t load_word(byte_t *p)
+{
+    word_t val;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(&val, p, 8);
+#else
+    int i;
+    val = 0;
+    for (i = 0; i < 8; i++)
+	val = val | ((word_t) p[i] << (8*i));
+#endif
+    return val;
+}
+
+static inline void store_word(byte_t *p, word_t val)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(p, &val, 8);
+#else
+    int i;
+    for (i = 0; i < 8; i++) {
+	p[i] = (byte_t) val & 0xFF;
+	val >>= 8;
+    }
+#endif
+}
+
+/* Memory is allocated in pages of MEM_PAGE_SIZE bytes */
+#define MEM_PAGE_BITS 12
+#define MEM_PAGE_SIZE (1<<MEM_PAGE_BITS)
+#define MEM_PAGE_MASK (MEM_PAGE_SIZE-1)
+
+/* Page holding pos, or NULL if it has never been written */
+static inline byte_t *read_page(mem_t m, word_t pos)
+{
+    return m->pages[pos >> MEM_PAGE_BITS];
+}
+
+/* Page holding pos, allocating it if necessary */
+static inline byte_t *write_page(mem_t m, word_t pos)
+{
+    byte_t **pp = &m->pages[pos >> MEM_PAGE_BITS];
+    if (!*pp)
+	*pp = (byte_t *) calloc(MEM_PAGE_SIZE, 1);
+    return *pp;
+}
+
+/* Predecoded instruction table used by step_state_fast.  Holds one
+   entry per memory address, filled in the first time an instruction
+   at that address is executed.  Entries covering bytes that get
+   written are invalidated, so self-modifying code is handled.
+   Like the memory, the table is allocated a page at a time. */
+
+/* Longest Y86-64 instruction */
+#define MAX_INSTR_LEN 10
+
+typedef enum { D_NONE, D_FAST, D_SLOW } dkind_t;
+
+typedef struct {
+    byte_t kind;   /* dkind_t */
+    byte_t icode;
+    byte_t ifun;
+    byte_t ra;
+    byte_t rb;
+    byte_t len;
+    word_t valc;
+} decode_rec, *decode_ptr;
+
+typedef struct {
+    /* Range of addresses with decoded entries */
+    word_t lo;
+    word_t hi;
+    word_t npages;
+    decode_ptr *pages;
+} decode_tab, *decode_tab_ptr;
+
+static void flush_decoded(mem_t m)
+{
+    decode_tab_ptr t = (decode_tab_ptr) m->decoded;
+    if (t) {
+	word_t p;
+	for (p = 0; p < t->npages; p++)
+	    free((void *) t->pages[p]);
+	free((void *) t->pages);
+	free((void *) t);
+	m->decoded = NULL;
+    }
+}
+
+/* Invalidate entries for instructions overlapping bytes [pos, pos+cnt) */
+static inline void invalidate_decoded(mem_t m, word_t pos, int cnt)
+{
+    decode_tab_ptr t = (decode_tab_ptr) m->decoded;
+    word_t lo = pos - (MAX_INSTR_LEN-1);
+    word_t hi = pos + cnt - 1;
+    if (lo < t->lo)
+	lo = t->lo;
+    if (hi > t->hi)
+	hi = t->hi;
+    for (; lo <= hi; lo++) {
+	decode_ptr page = t->pages[lo >> MEM_PAGE_BITS];
+	if (page)
+	    page[lo & MEM_PAGE_MASK].kind = D_NONE;
+    }
+}
+
+mem_t init_mem(word_t len)
 {
 
     mem_t result = (mem_t) malloc(sizeof(mem_rec));
     len = ((len+BPL-1)/BPL)*BPL;
     result->len = len;
-    result->contents = (byte_t *) calloc(len, 1);
+    result->load_end = 0;
+    result->npages = (len+MEM_PAGE_SIZE-1) >> MEM_PAGE_BITS;
+    result->pages = (byte_t **) calloc(result->npages, sizeof(byte_t *));
+    result->decoded = NULL;
     return result;
 }
 
 void clear_mem(mem_t m)
 {
-    memset(m->contents, 0, m->len);
+    word_t p;
+    for (p = 0; p < m->npages; p++) {
+	free((void *) m->pages[p]);
+	m->pages[p] = NULL;
+    }
+    flush_decoded(m);
 }
 
 void free_mem(mem_t m)
 {
-    free((void *) m->contents);
+    clear_mem(m);
+    free((void *) m->pages);
     free((void *) m);
 }
 
 mem_t copy_mem(mem_t oldm)
 {
     mem_t newm = init_mem(oldm->len);
-    memcpy(newm->contents, oldm->contents, oldm->len);
+    word_t p;
+    newm->load_end = oldm->load_end;
+    for (p = 0; p < oldm->npages; p++) {
+	if (oldm->pages[p]) {
+	    newm->pages[p] = (byte_t *) malloc(MEM_PAGE_SIZE);
+	    memcpy(newm->pages[p], oldm->pages[p], MEM_PAGE_SIZE);
+	}
+    }
     return newm;
 }
 
+/* Only pages written in at least one of the memories can differ */
 bool_t diff_mem(mem_t oldm, mem_t newm, FILE *outfile)
 {
-    word_t pos;
-    int len = oldm->len;
+    word_t pos, p, npages;
+    word_t len = oldm->len;
     bool_t diff = FALSE;
     if (newm->len < len)
 	len = newm->len;
-    for (pos = 0; (!diff || outfile) && pos < len; pos += 8) {
-        word_t ov = 0;  word_t nv = 0;
-	get_word_val(oldm, pos, &ov);
-	get_word_val(newm, pos, &nv);
-	if (nv != ov) {
-	    diff = TRUE;
-	    if (outfile)
-		fprintf(outfile, "0x%.4llx:\t0x%.16llx\t0x%.16llx\n", pos, ov, nv);
+    npages = (len+MEM_PAGE_SIZE-1) >> MEM_PAGE_BITS;
+    for (p = 0; (!diff || outfile) && p < npages; p++) {
+	byte_t *op = oldm->pages[p];
+	byte_t *np = newm->pages[p];
+	word_t end = (p+1) << MEM_PAGE_BITS;
+	if (!op && !np)
+	    continue;
+	if (end > len)
+	    end = len;
+	for (pos = p << MEM_PAGE_BITS; (!diff || outfile) && pos < end;
+	     pos += 8) {
+	    word_t ov = op ? load_word(op + (pos & MEM_PAGE_MASK)) : 0;
+	    word_t nv = np ? load_word(np + (pos & MEM_PAGE_MASK)) : 0;
+	    if (nv != ov) {
+		diff = TRUE;
+		if (outfile)
+		    fprintf(outfile, "0x%.4llx:\t0x%.16llx\t0x%.16llx\n",
+			    pos, ov, nv);
+	    }
 	}
     }
     return diff;
 }
 
+word_t parse_mem_size(char *s)
+{
+    char *end;
+    word_t size = strtoll(s, &end, 0);
+    switch (*end) {
+    case 'k':
+    case 'K':
+	size <<= 10;
+	end++;
+	break;
+    case 'm':
+    case 'M':
+	size <<= 20;
+	end++;
+	break;
+    case 'g':
+    case 'G':
+	size <<= 30;
+	end++;
+	break;
+    default:
+	break;
+    }
+    if (end == s || *end != '\0' || size <= 0)
+	return -1;
+    return size;
+}
+
 int hex2dig(char c)
 {
     if (isdigit((int)c))
@@ -190,15 +353,105 @@ int hex2dig(char c)
 	return c - 'a' + 10;
 }
 
+/* Decode 8-byte little-endian field of image header */
+static word_t get_le_word(byte_t *b)
+{
+    int i;
+    uword_t val = 0;
+    for (i = 7; i >= 0; i--)
+	val = (val << 8) | b[i];
+    return (word_t) val;
+}
+
+/* Read up to len bytes into memory starting at addr,
+   with one read per page.  Return number of bytes read */
+static word_t read_mem(mem_t m, word_t addr, word_t len, FILE *infile)
+{
+    word_t cnt = 0;
+    while (cnt < len) {
+	word_t pos = addr + cnt;
+	word_t chunk = MEM_PAGE_SIZE - (pos & MEM_PAGE_MASK);
+	size_t n;
+	if (chunk > len - cnt)
+	    chunk = len - cnt;
+	n = fread(write_page(m, pos) + (pos & MEM_PAGE_MASK), 1, chunk, infile);
+	cnt += n;
+	if (n < chunk)
+	    break;
+    }
+    return cnt;
+}
+
+/* Load binary image.  Magic number has already been consumed */
+static word_t load_image(mem_t m, FILE *infile, char *magic,
+			 int report_error)
+{
+    byte_t hdr[16];
+    word_t byte_cnt = 0;
+    size_t n;
+
+    if (strncmp(magic, IMG_RAW_MAGIC, IMG_MAGIC_LEN) == 0) {
+	/* Whole image goes at address 0 */
+	byte_cnt = read_mem(m, 0, m->len, infile);
+	m->load_end = byte_cnt;
+	if (getc(infile) != EOF) {
+	    if (report_error)
+		fprintf(stderr,
+			"Error reading image. Larger than memory (%lld bytes)\n",
+			m->len);
+	    return 0;
+	}
+	return byte_cnt;
+    }
+    if (strncmp(magic, IMG_SEG_MAGIC, IMG_MAGIC_LEN) != 0) {
+	if (report_error)
+	    fprintf(stderr, "Error reading image. Unknown magic number\n");
+	return 0;
+    }
+    while ((n = fread(hdr, 1, sizeof(hdr), infile)) == sizeof(hdr)) {
+	word_t addr = get_le_word(hdr);
+	word_t len = get_le_word(hdr+8);
+	/* Written so that a huge addr or len can't overflow */
+	if (addr < 0 || len < 0 || addr > m->len || len > m->len - addr) {
+	    if (report_error)
+		fprintf(stderr,
+			"Error reading image. Invalid segment 0x%llx+0x%llx\n",
+			addr, len);
+	    return 0;
+	}
+	if (read_mem(m, addr, len, infile) != len) {
+	    if (report_error)
+		fprintf(stderr,
+			"Error reading image. Truncated segment at 0x%llx\n",
+			addr);
+	    return 0;
+	}
+	byte_cnt += len;
+	if (addr + len > m->load_end)
+	    m->load_end = addr + len;
+    }
+    if (n != 0) {
+	if (report_error)
+	    fprintf(stderr, "Error reading image. Truncated segment header\n");
+	return 0;
+    }
+    return byte_cnt;
+}
+
 #define LINELEN 4096
-int load_mem(mem_t m, FILE *infile, int report_error)
+word_t load_mem(mem_t m, FILE *infile, int report_error)
 {
     /* Read contents of .yo file */
     char buf[LINELEN];
     char c, ch, cl;
-    int byte_cnt = 0;
+    word_t byte_cnt = 0;
     int lineno = 0;
     word_t bytepos = 0;
+    int first = getc(infile);
+
+    /* Contents are about to be overwritten directly */
+    flush_decoded(m);
+    m->load_end = 0;
 #ifdef HAS_GUI
     int empty_line = 1;
     int addr = 0;
@@ -208,6 +461,21 @@ int load_mem(mem_t m, FILE *infile, int report_error)
     char line[LINELEN];
     int index = 0;
 #endif /* HAS_GUI */   
+
+    /* Binary images start with a byte that can't occur in a .yo file */
+    if (first == IMG_RAW_MAGIC[0]) {
+	char magic[IMG_MAGIC_LEN];
+	magic[0] = first;
+	if (fread(magic+1, 1, IMG_MAGIC_LEN-1, infile) != IMG_MAGIC_LEN-1) {
+	    if (report_error)
+		fprintf(stderr, "Error reading image. Missing magic number\n");
+	    return 0;
+	}
+	return load_image(m, infile, magic, report_error);
+    }
+    if (first != EOF)
+	ungetc(first, infile);
+
     while (fgets(buf, LINELEN, infile)) {
 	int cpos = 0;
 #ifdef HAS_GUI
@@ -265,8 +533,11 @@ int load_mem(mem_t m, FILE *infile, int report_error)
 		return 0;
 	    }
 	    byte = hex2dig(ch)*16+hex2dig(cl);
-	    m->contents[bytepos++] = byte;
+	    write_page(m, bytepos)[bytepos & MEM_PAGE_MASK] = byte;
+	    bytepos++;
 	    byte_cnt++;
+	    if (bytepos > m->load_end)
+		m->load_end = bytepos;
 #ifdef HAS_GUI
 	    empty_line = 0;
 	    hexcode[index++] = ch;
@@ -299,26 +570,60 @@ int load_mem(mem_t m, FILE *infile, int report_error)
     return byte_cnt;
 }
 
+/* Write 8-byte little-endian field of image header */
+static void put_le_word(FILE *out, word_t val)
+{
+    int i;
+    for (i = 0; i < 8; i++)
+	putc((val >> (8*i)) & 0xFF, out);
+}
+
+int save_mem(mem_t m, FILE *outfile)
+{
+    word_t p;
+
+    fwrite(IMG_SEG_MAGIC, 1, IMG_MAGIC_LEN, outfile);
+    for (p = 0; p < m->npages; p++) {
+	word_t addr = p << MEM_PAGE_BITS;
+	word_t len = m->len - addr < MEM_PAGE_SIZE ? m->len - addr : MEM_PAGE_SIZE;
+	if (!m->pages[p])
+	    continue;
+	put_le_word(outfile, addr);
+	put_le_word(outfile, len);
+	fwrite(m->pages[p], 1, len, outfile);
+    }
+    return !ferror(outfile);
+}
+
 bool_t get_byte_val(mem_t m, word_t pos, byte_t *dest)
 {
+    byte_t *page;
     if (pos < 0 || pos >= m->len)
 	return FALSE;
-    *dest = m->contents[pos];
+    page = read_page(m, pos);
+    *dest = page ? page[pos & MEM_PAGE_MASK] : 0;
     return TRUE;
 }
 
 bool_t get_word_val(mem_t m, word_t pos, word_t *dest)
 {
-    int i;
-    word_t val;
+    byte_t *page;
     if (pos < 0 || pos + 8 > m->len)
 	return FALSE;
-    val = 0;
-    for (i = 0; i < 8; i++) {
-	word_t b =  m->contents[pos+i] & 0xFF;
-	val = val | (b <<(8*i));
+    if ((pos & MEM_PAGE_MASK) > MEM_PAGE_SIZE - 8) {
+	/* Word spans two pages */
+	int i;
+	word_t val = 0;
+	for (i = 0; i < 8; i++) {
+	    byte_t b = 0;
+	    get_byte_val(m, pos+i, &b);
+	    val = val | ((word_t) b << (8*i));
+	}
+	*dest = val;
+	return TRUE;
     }
-    *dest = val;
+    page = read_page(m, pos);
+    *dest = page ? load_word(page + (pos & MEM_PAGE_MASK)) : 0;
     return TRUE;
 }
 
@@ -326,19 +631,27 @@ bool_t set_byte_val(mem_t m, word_t pos, byte_t val)
 {
     if (pos < 0 || pos >= m->len)
 	return FALSE;
-    m->contents[pos] = val;
+    write_page(m, pos)[pos & MEM_PAGE_MASK] = val;
+    if (m->decoded)
+	invalidate_decoded(m, pos, 1);
     return TRUE;
 }
 
 bool_t set_word_val(mem_t m, word_t pos, word_t val)
 {
-    int i;
     if (pos < 0 || pos + 8 > m->len)
 	return FALSE;
-    for (i = 0; i < 8; i++) {
-	m->contents[pos+i] = (byte_t) val & 0xFF;
-	val >>= 8;
-    }
+    if ((pos & MEM_PAGE_MASK) > MEM_PAGE_SIZE - 8) {
+	/* Word spans two pages */
+	int i;
+	for (i = 0; i < 8; i++) {
+	    write_page(m, pos+i)[(pos+i) & MEM_PAGE_MASK] = (byte_t) val & 0xFF;
+	    val >>= 8;
+	}
+    } else
+	store_word(write_page(m, pos) + (pos & MEM_PAGE_MASK), val);
+    if (m->decoded)
+	invalidate_decoded(m, pos, 8);
     return TRUE;
 }
 
@@ -357,6 +670,8 @@ void dump_memory(FILE *outfile, mem_t m, word_t pos, int len)
 
     for (i = 0; i < len; i+=BPL) {
 	word_t val = 0;
+	if (!read_page(m, pos+i))
+	    continue;
 	fprintf(outfile, "0x%.4llx:", pos+i);
 	for (j = 0; j < BPL; j+= 8) {
 	    get_word_val(m, pos+i+j, &val);
@@ -537,7 +852,7 @@ char *stat_name(stat_t e)
 
 /**************** Implementation of ISA model ************************/
 
-state_ptr new_state(int memlen)
+state_ptr new_state(word_t memlen)
 {
     state_ptr result = (state_ptr) malloc(sizeof(state_rec));
     result->pc = 0;
@@ -941,3 +1256,218 @@ stat_t step_state(state_ptr s, FILE *error_file)
     }
     return STAT_AOK;
 }
+
+/* Fill in decode entry for instruction at pos.  Anything that
+   step_state would treat as an error, or that relies on its handling
+   of invalid function codes and register IDs, is marked D_SLOW */
+static void decode_instr(mem_t m, word_t pos, decode_ptr d)
+{
+    byte_t byte0;
+    itype_t icode;
+    int ifun;
+    int ra = REG_NONE;
+    int rb = REG_NONE;
+    bool_t need_regids, need_imm;
+    int len = 1;
+    bool_t ok;
+
+    get_byte_val(m, pos, &byte0);
+    icode = HI4(byte0);
+    ifun = LO4(byte0);
+    d->kind = D_SLOW;
+    d->icode = icode;
+    d->ifun = ifun;
+    d->valc = 0;
+
+    need_regids =
+	(icode == I_RRMOVQ || icode == I_ALU || icode == I_PUSHQ ||
+	 icode == I_POPQ || icode == I_IRMOVQ || icode == I_RMMOVQ ||
+	 icode == I_MRMOVQ || icode == I_IADDQ);
+    need_imm =
+	(icode == I_IRMOVQ || icode == I_RMMOVQ || icode == I_MRMOVQ ||
+	 icode == I_JMP || icode == I_CALL || icode == I_IADDQ);
+
+    if (need_regids) {
+	byte_t byte1;
+	if (!get_byte_val(m, pos+len, &byte1))
+	    return;
+	ra = HI4(byte1);
+	rb = LO4(byte1);
+	len++;
+    }
+    if (need_imm) {
+	if (!get_word_val(m, pos+len, &d->valc))
+	    return;
+	len += 8;
+    }
+    d->ra = ra;
+    d->rb = rb;
+    d->len = len;
+
+    switch (icode) {
+    case I_NOP:
+    case I_HALT:
+    case I_RET:
+	ok = TRUE;
+	break;
+    case I_RRMOVQ:
+	ok = ifun <= C_G && reg_valid(ra) && reg_valid(rb);
+	break;
+    case I_IRMOVQ:
+    case I_IADDQ:
+	ok = reg_valid(rb);
+	break;
+    case I_RMMOVQ:
+    case I_MRMOVQ:
+	ok = reg_valid(ra) && (reg_valid(rb) || rb == REG_NONE);
+	break;
+    case I_ALU:
+	ok = ifun < A_NONE && reg_valid(ra) && reg_valid(rb);
+	break;
+    case I_JMP:
+	ok = ifun <= C_G;
+	break;
+    case I_CALL:
+	ok = TRUE;
+	break;
+    case I_PUSHQ:
+    case I_POPQ:
+	ok = reg_valid(ra);
+	break;
+    default:
+	ok = FALSE;
+	break;
+    }
+    if (ok)
+	d->kind = D_FAST;
+}
+
+/* Decode entry for address pos, allocating table as necessary */
+static decode_ptr get_decoded(mem_t m, word_t pos)
+{
+    decode_tab_ptr t = (decode_tab_ptr) m->decoded;
+    decode_ptr *pp;
+    if (!t) {
+	t = (decode_tab_ptr) malloc(sizeof(decode_tab));
+	t->npages = m->npages;
+	t->pages = (decode_ptr *) calloc(t->npages, sizeof(decode_ptr));
+	t->lo = m->len;
+	t->hi = -1;
+	m->decoded = t;
+    }
+    pp = &t->pages[pos >> MEM_PAGE_BITS];
+    if (!*pp)
+	*pp = (decode_ptr) calloc(MEM_PAGE_SIZE, sizeof(decode_rec));
+    if (pos < t->lo)
+	t->lo = pos;
+    if (pos > t->hi)
+	t->hi = pos;
+    return &(*pp)[pos & MEM_PAGE_MASK];
+}
+
+/* Register file access without the GUI hooks of get/set_reg_val.
+   Callers guarantee the IDs are valid */
+#define FAST_REG(regs, id) load_word((regs) + 8*(id))
+#define FAST_SET_REG(regs, id, val) store_word((regs) + 8*(id), (val))
+
+stat_t step_state_fast(state_ptr s, FILE *error_file)
+{
+    mem_t m = s->m;
+    word_t pc = s->pc;
+    byte_t *regs;
+    decode_ptr d;
+    word_t addr, val, argB;
+
+    /* Register updates have to be reported to the GUI */
+    if (gui_mode || pc < 0 || pc >= m->len)
+	return step_state(s, error_file);
+
+    d = get_decoded(m, pc);
+    if (d->kind == D_NONE)
+	decode_instr(m, pc, d);
+    if (d->kind != D_FAST)
+	return step_state(s, error_file);
+    regs = write_page(s->r, 0);
+
+    switch (d->icode) {
+    case I_NOP:
+	break;
+    case I_HALT:
+	return STAT_HLT;
+    case I_RRMOVQ:
+	if (cond_holds(s->cc, d->ifun))
+	    FAST_SET_REG(regs, d->rb, FAST_REG(regs, d->ra));
+	break;
+    case I_IRMOVQ:
+	FAST_SET_REG(regs, d->rb, d->valc);
+	break;
+    case I_RMMOVQ:
+	addr = d->valc;
+	if (d->rb != REG_NONE)
+	    addr += FAST_REG(regs, d->rb);
+	if (!set_word_val(m, addr, FAST_REG(regs, d->ra)))
+	    return step_state(s, error_file);
+	break;
+    case I_MRMOVQ:
+	addr = d->valc;
+	if (d->rb != REG_NONE)
+	    addr += FAST_REG(regs, d->rb);
+	if (!get_word_val(m, addr, &val))
+	    return step_state(s, error_file);
+	FAST_SET_REG(regs, d->ra, val);
+	break;
+    case I_ALU:
+	val = FAST_REG(regs, d->ra);
+	argB = FAST_REG(regs, d->rb);
+	FAST_SET_REG(regs, d->rb, compute_alu(d->ifun, val, argB));
+	s->cc = compute_cc(d->ifun, val, argB);
+	break;
+    case I_JMP:
+	if (cond_holds(s->cc, d->ifun)) {
+	    s->pc = d->valc;
+	    return STAT_AOK;
+	}
+	break;
+    case I_CALL:
+	/* Check stack address first, since a failing call
+	   still updates %rsp */
+	addr = FAST_REG(regs, REG_RSP) - 8;
+	if (addr < 0 || addr + 8 > m->len)
+	    return step_state(s, error_file);
+	FAST_SET_REG(regs, REG_RSP, addr);
+	set_word_val(m, addr, pc + d->len);
+	s->pc = d->valc;
+	return STAT_AOK;
+    case I_RET:
+	addr = FAST_REG(regs, REG_RSP);
+	if (!get_word_val(m, addr, &val))
+	    return step_state(s, error_file);
+	FAST_SET_REG(regs, REG_RSP, addr + 8);
+	s->pc = val;
+	return STAT_AOK;
+    case I_PUSHQ:
+	addr = FAST_REG(regs, REG_RSP) - 8;
+	if (addr < 0 || addr + 8 > m->len)
+	    return step_state(s, error_file);
+	val = FAST_REG(regs, d->ra);
+	FAST_SET_REG(regs, REG_RSP, addr);
+	set_word_val(m, addr, val);
+	break;
+    case I_POPQ:
+	addr = FAST_REG(regs, REG_RSP);
+	if (!get_word_val(m, addr, &val))
+	    return step_state(s, error_file);
+	FAST_SET_REG(regs, REG_RSP, addr + 8);
+	FAST_SET_REG(regs, d->ra, val);
+	break;
+    case I_IADDQ:
+	argB = FAST_REG(regs, d->rb);
+	FAST_SET_REG(regs, d->rb, argB + d->valc);
+	s->cc = compute_cc(A_ADD, d->valc, argB);
+	break;
+    default:
+	return step_state(s, error_file);
+    }
+    s->pc = pc + d->len;
+    return STAT_AOK;
+}
@@ -1,4 +1,7 @@
 /* Instruction Set definition for Y86-64 Architecture */
+#ifndef ISA_H
+#define ISA_H
+
 /* Revisions:
    2013-10-25:
        Extended all data widths and addresses to 64 bits
@@ -88,15 +91,18 @@ typedef unsigned char byte_t;
 typedef long long int word_t;
 typedef long long unsigned uword_t;
 
-/* Represent a memory as an array of bytes */
+/* Represent a memory as a table of fixed-size pages.  A page is
+   allocated the first time it is written; until then it reads as 0 */
 typedef struct {
-  int len;
-  word_t maxaddr;
-  byte_t *contents;
+  word_t len;
+  word_t load_end; /* One past the highest address load_mem wrote, or 0 */
+  word_t npages;
+  byte_t **pages; /* NULL for pages that have never been written */
+  void *decoded;  /* Predecoded instructions for step_state_fast, or NULL */
 } mem_rec, *mem_t;
 
 /* Create a memory with len bytes */
-mem_t init_mem(int len);
+mem_t init_mem(word_t len);
 void free_mem(mem_t m);
 
 /* Set contents of memory to 0 */
@@ -107,17 +113,38 @@ mem_t copy_mem(mem_t oldm);
 /* Print the differences between two memories */
 bool_t diff_mem(mem_t oldm, mem_t newm, FILE *outfile);
 
-/* How big should the memory be? */
+/* How big should the memory be by default?
+   The simulators can override this with their -m option */
 #ifdef BIG_MEM
 #define MEM_SIZE (1<<16)
 #else
 #define MEM_SIZE (1<<13)
 #endif
 
+/* Parse memory size with optional K, M, or G suffix.
+   Return -1 if invalid */
+word_t parse_mem_size(char *s);
+
 /*** In the following functions, a return value of 1 means success ***/
 
-/* Load memory from .yo file.  Return number of bytes read */
-int load_mem(mem_t m, FILE *infile, int report_error);
+/* Binary memory images.  load_mem recognizes these by their leading
+   magic number and falls back to parsing a .yo listing otherwise.
+   Raw image:       magic, then the memory contents starting at address 0
+   Segmented image: magic, then any number of segments, each an 8-byte
+                    address, an 8-byte length (both little-endian) and
+                    that many bytes of contents
+*/
+#define IMG_MAGIC_LEN 4
+#define IMG_RAW_MAGIC "\177Y6R"
+#define IMG_SEG_MAGIC "\177Y6S"
+
+/* Load memory from .yo file or binary image.  Return number of bytes
+   read, and set m->load_end to one past the highest address loaded */
+word_t load_mem(mem_t m, FILE *infile, int report_error);
+
+/* Write the pages of m that were ever written as a segmented binary
+   image, which load_mem reads back.  Return 1 on success */
+int save_mem(mem_t m, FILE *outfile);
 
 /* Get byte from memory */
 bool_t get_byte_val(mem_t m, word_t pos, byte_t *dest);
@@ -131,7 +158,7 @@ bool_t set_byte_val(mem_t m, word_t pos, byte_t val);
 /* Set 8 bytes in memory */
 bool_t set_word_val(mem_t m, word_t pos, word_t val);
 
-/* Print contents of memory */
+/* Print contents of memory.  Pages that were never written are skipped */
 void dump_memory(FILE *outfile, mem_t m, word_t pos, int cnt);
 
 /********** Implementation of Register File *************/
@@ -189,7 +216,7 @@ typedef struct {
   cc_t cc;
 } state_rec, *state_ptr;
 
-state_ptr new_state(int memlen);
+state_ptr new_state(word_t memlen);
 void free_state(state_ptr s);
 
 state_ptr copy_state(state_ptr s);
@@ -201,6 +228,12 @@ bool_t cond_holds(cc_t cc, cond_t bcond);
 /* Execute single instruction.  Return status. */
 stat_t step_state(state_ptr s, FILE *error_file);
 
+/* Execute single instruction using a table of predecoded instructions
+   kept with the memory.  Gives exactly the same results as step_state,
+   which it falls back on for anything other than well-formed
+   instructions with valid memory references. */
+stat_t step_state_fast(state_ptr s, FILE *error_file);
+
 /************************ Interface Functions *************/
 
 #ifdef HAS_GUI
@@ -208,3 +241,5 @@ void report_line(word_t line_no, word_t addr, char *hexcode, char *line);
 void signal_register_update(reg_id_t r, word_t val);
 
 #endif
+
+#endif /* ISA_H */
@@ -15,9 +15,19 @@
 void yyerror(const char *str);
 void yyserror(const char *str, char *other);
 
+/* Line number that errors are reported at.  Maintained by lex */
+extern int lineno;
+/* Number of errors reported */
+extern int errcnt;
+
 /* For error reporting */
 static char* show_expr(node_ptr expr);
 
+#if !defined(VLOG) && !defined(UCLID)
+/* Generate deferred function definitions */
+static void gen_deferred();
+#endif
+
 /* The symbol table */
 #define SYM_LIM 100
 static node_ptr sym_tab[2][SYM_LIM];
@@ -26,6 +36,12 @@ static int sym_count = 0;
 /* Optional simulator name */
 char simname[MAXBUF] = "";
 
+/* Generate static inline functions, for including in the simulator? */
+int inline_funct = 0;
+
+/* Count what decides the value of each function? */
+int coverage = 0;
+
 #ifdef UCLID
 int annotate = 0;
 /* Keep list of argument names encountered in node definition */
@@ -48,7 +64,11 @@ static void usage(char *name)
     fprintf(stderr, "Usage: %s [-ah] < HCL_file  > uclid_file\n", name);
     fprintf(stderr, "   -a     Add define/use annotations\n");
 #else /* !UCLID */
-    fprintf(stderr, "Usage: %s [-h][-n NAM] < HCL_file  > C_file\n", name);
+    fprintf(stderr, "Usage: %s [-h][-i][-c][-n NAM] < HCL_file  > C_file\n", name);
+    fprintf(stderr, "   -i     Generate static inline functions, for compiling\n");
+    fprintf(stderr, "          into the same unit as the simulator\n");
+    fprintf(stderr, "   -c     Count function evaluations and the terms that\n");
+    fprintf(stderr, "          decide them, for dumping with hcl_cov_dump\n");
 #endif /* UCLID */
 #endif /* VLOG */
     fprintf(stderr, "   -h     Print this message\n");
@@ -66,7 +86,7 @@ void init_node(int argc, char **argv)
     int other_indents = 2;
 
     /* Parse the command line arguments */
-    while ((c = getopt(argc, argv, "hna")) != -1) {
+    while ((c = getopt(argc, argv, "hnaic")) != -1) {
 	switch(c) {
 	case 'h':
 	    usage(argv[0]);
@@ -74,6 +94,12 @@ void init_node(int argc, char **argv)
 	case 'n': /* Optional simulator name */
 	    strcpy(simname, argv[optind]);
 	    break;
+	case 'i':
+	    inline_funct = 1;
+	    break;
+	case 'c':
+	    coverage = 1;
+	    break;
 #ifdef UCLID
 	case 'a':
 	    annotate = 1;
@@ -120,6 +146,9 @@ static void show_node(node_ptr node)
 
 void finish_node(int check_ref)
 {
+#if !defined(VLOG) && !defined(UCLID)
+    gen_deferred();
+#endif
     if (check_ref) {
 	int i;
 	for (i = 0; i < sym_count; i++)
@@ -144,6 +173,17 @@ static node_ptr find_symbol(char *name)
     return NULL;
 }
 
+/* Like find_symbol, but returns NULL for an unknown name without
+   reporting it */
+static node_ptr lookup_symbol(char *name)
+{
+    int i;
+    for (i = 0; i < sym_count; i++)
+	if (strcmp(name, sym_tab[0][i]->sval) == 0)
+	    return sym_tab[1][i];
+    return NULL;
+}
+
 #ifdef UCLID
 /* See if string should be considered argument.
    Currently, omit strings that are all upper case */
@@ -179,6 +219,7 @@ static node_ptr new_node(node_type_t t, int isbool,
     result->arg1 = a1;
     result->arg2 = a2;
     result->ref = 0;
+    result->cse = 0;
     result->next = NULL;
     return result;
 }
@@ -342,6 +383,7 @@ void add_arg(node_ptr var, node_ptr qstring, int isbool)
 static char expr_buf[1024];
 static int errlen = 0;
 #define MAXERRLEN 80
+static int errmax = MAXERRLEN;
 
 /* Recursively display expression for error reporting */
 static void show_expr_helper(node_ptr expr)
@@ -351,76 +393,76 @@ static void show_expr_helper(node_ptr expr)
 	node_ptr ele;
     case N_QUOTE:
 	len = strlen(expr->sval) + 2;
-	if (len + errlen < MAXERRLEN) {
+	if (len + errlen < errmax) {
 	    sprintf(expr_buf+errlen, "'%s'", expr->sval);
 	    errlen += len;
 	}
 	break;
     case N_VAR:
 	len = strlen(expr->sval);
-	if (len + errlen < MAXERRLEN) {
+	if (len + errlen < errmax) {
 	    sprintf(expr_buf+errlen, "%s", expr->sval);
 	    errlen += len;
 	}
 	break;
     case N_NUM:
 	len = strlen(expr->sval);
-	if (len + errlen < MAXERRLEN) {
+	if (len + errlen < errmax) {
 	    sprintf(expr_buf+errlen, "%s", expr->sval);
 	    errlen += len;
 	}
 	break;
     case N_AND:
-	if (errlen < MAXERRLEN) {
+	if (errlen < errmax) {
 	    sprintf(expr_buf+errlen, "(");
 	    errlen+=1;
 	    show_expr_helper(expr->arg1);
 	    sprintf(expr_buf+errlen, " & ");
 	    errlen+=3;
 	}
-	if (errlen < MAXERRLEN) {
+	if (errlen < errmax) {
 	    show_expr_helper(expr->arg2);
 	    sprintf(expr_buf+errlen, ")");
 	    errlen+=1;
 	}
 	break;
     case N_OR:
-	if (errlen < MAXERRLEN) {
+	if (errlen < errmax) {
 	    sprintf(expr_buf+errlen, "(");
 	    errlen+=1;
 	    show_expr_helper(expr->arg1);
 	    sprintf(expr_buf+errlen, " | ");
 	    errlen+=3;
 	}
-	if (errlen < MAXERRLEN) {
+	if (errlen < errmax) {
 	    show_expr_helper(expr->arg2);
 	    sprintf(expr_buf+errlen, ")");
 	    errlen+=1;
 	}
 	break;
     case N_NOT:
-	if (errlen < MAXERRLEN) {
+	if (errlen < errmax) {
 	    sprintf(expr_buf+errlen, "!");
 	    errlen+=1;
 	    show_expr_helper(expr->arg1);
 	}
 	break;
     case N_COMP:
-	if (errlen < MAXERRLEN) {
+	if (errlen < errmax) {
 	    sprintf(expr_buf+errlen, "(");
 	    errlen+=1;
 	    show_expr_helper(expr->arg1);
 	    sprintf(expr_buf+errlen, " %s ", expr->sval);
 	    errlen+=4;
 	}
-	if (errlen < MAXERRLEN) {
+	if (errlen < errmax) {
 	    show_expr_helper(expr->arg2);
 	    sprintf(expr_buf+errlen, ")");
 	    errlen+=1;
 	}
 	break;
     case N_ELE:
-	if (errlen < MAXERRLEN) {
+	if (errlen < errmax) {
 	    sprintf(expr_buf+errlen, "(");
 	    errlen+=1;
 	    show_expr_helper(expr->arg1);
@@ -428,7 +470,7 @@ static void show_expr_helper(node_ptr expr)
 	    errlen+=5;
 	}
 	for (ele = expr->arg2; ele; ele=ele->next) {
-	    if (errlen < MAXERRLEN) {
+	    if (errlen < errmax) {
 		show_expr_helper(ele);
 		if (ele->next) {
 		    sprintf(expr_buf+errlen, ", ");
@@ -436,29 +478,29 @@ static void show_expr_helper(node_ptr expr)
 		}
 	    }
 	}
-	if (errlen < MAXERRLEN) {
+	if (errlen < errmax) {
 	    sprintf(expr_buf+errlen, "})");
 	    errlen+=2;
 	}
 	break;
     case N_CASE:
-	if (errlen < MAXERRLEN) {
+	if (errlen < errmax) {
 	    sprintf(expr_buf+errlen, "[ ");
 	    errlen+=2;
 	}
-	for (ele = expr; errlen < MAXERRLEN && ele; ele=ele->next) {
+	for (ele = expr; errlen < errmax && ele; ele=ele->next) {
 	    show_expr_helper(ele->arg1);
 	    sprintf(expr_buf+errlen, " : ");
 	    errlen += 3;
 	    show_expr_helper(ele->arg2);
 	}
-	if (errlen < MAXERRLEN) {
+	if (errlen < errmax) {
 	    sprintf(expr_buf+errlen, " ]");
 	    errlen+=2;
 	}
 	break;
     default:
-	if (errlen < MAXERRLEN) {
+	if (errlen < errmax) {
 	    sprintf(expr_buf+errlen, "??");
 	    errlen+=2;
 	}
@@ -470,15 +512,733 @@ static char *show_expr(node_ptr expr)
 {
     errlen = 0;
     show_expr_helper(expr);
-    if (errlen >= MAXERRLEN)
+    if (errlen >= errmax)
 	sprintf(expr_buf+errlen, "...");
     return expr_buf;
 }
 
+#if !defined(VLOG) && !defined(UCLID)
+/*
+ * Pipeline control for C output.
+ * Function definitions are collected as they are parsed and generated
+ * by finish_node.  If the file defines the stall and bubble signals of
+ * all five PIPE registers, they are also generated as one function,
+ * gen_pipe_control, which psim calls once per cycle in place of the
+ * ten signal functions.  HCL_PIPE_CONTROL tells a unit that includes
+ * the output that gen_pipe_control is there.  The conditions for
+ * load/use hazards, returns and mispredicted branches each appear in
+ * several of these signals.  Within gen_pipe_control, every
+ * subexpression that is needed in more than one place, and is costly
+ * enough, is evaluated once into a local variable.  Each distinct
+ * subexpression has a record counting those places.  Only these ten
+ * signals share terms: the signals the stages compute, such as
+ * d_srcA or e_Cnd, are still evaluated by their own functions each
+ * time they are used.
+ */
+#define MIN_CSE_COST 3
+
+typedef struct {
+    char *key;      /* Canonical form of expression */
+    node_ptr expr;  /* First occurrence of expression */
+    int count;      /* Number of places value is used */
+    int id;         /* Local variable number, once generated, or 0 */
+} cse_rec, *cse_ptr;
+
+static cse_ptr cse_tab = NULL;
+static int cse_count = 0;
+static int cse_max = 0;
+static int cse_id = 0;
+
+/* Local variable currently being generated */
+static node_ptr cse_root = NULL;
+
+/* Function definitions awaiting generation, and the lines they end on */
+static node_ptr *def_tab[2] = {NULL, NULL};
+static int *def_line = NULL;
+static int def_count = 0;
+static int def_max = 0;
+
+/* Buffer for building canonical form of expression */
+static char *key_buf = NULL;
+static int key_len = 0;
+static int key_max = 0;
+
+static void key_add(char *s)
+{
+    int len = strlen(s);
+    if (key_len + len + 1 > key_max) {
+	key_max = 2*(key_len + len + 1);
+	key_buf = realloc(key_buf, key_max);
+    }
+    strcpy(key_buf+key_len, s);
+    key_len += len;
+}
+
+static void key_expr(node_ptr expr)
+{
+    node_ptr ele;
+    key_add(node_names[expr->type]);
+    key_add("(");
+    switch(expr->type) {
+    case N_NOT:
+	key_expr(expr->arg1);
+	break;
+    case N_AND:
+    case N_OR:
+    case N_COMP:
+	key_add(expr->sval);
+	key_add(",");
+	key_expr(expr->arg1);
+	key_add(",");
+	key_expr(expr->arg2);
+	break;
+    case N_ELE:
+	key_expr(expr->arg1);
+	for (ele = expr->arg2; ele; ele=ele->next) {
+	    key_add(",");
+	    key_expr(ele);
+	}
+	break;
+    case N_CASE:
+	for (ele = expr; ele; ele=ele->next) {
+	    key_expr(ele->arg1);
+	    key_add(":");
+	    key_expr(ele->arg2);
+	    key_add(";");
+	}
+	break;
+    default:
+	key_add(expr->sval);
+	break;
+    }
+    key_add(")");
+}
+
+/* Rough number of operations needed to evaluate expression */
+static int expr_cost(node_ptr expr)
+{
+    node_ptr ele;
+    int cost = 0;
+    switch(expr->type) {
+    case N_NOT:
+	cost = 1 + expr_cost(expr->arg1);
+	break;
+    case N_AND:
+    case N_OR:
+    case N_COMP:
+	cost = 1 + expr_cost(expr->arg1) + expr_cost(expr->arg2);
+	break;
+    case N_ELE:
+	for (ele = expr->arg2; ele; ele=ele->next)
+	    cost += 1 + expr_cost(expr->arg1) + expr_cost(ele);
+	break;
+    case N_CASE:
+	for (ele = expr; ele; ele=ele->next)
+	    cost += 1 + expr_cost(ele->arg1) + expr_cost(ele->arg2);
+	break;
+    default:
+	break;
+    }
+    return cost;
+}
+
+/* Find record for expression, creating one if necessary */
+static int find_cse(node_ptr expr)
+{
+    int i;
+    key_len = 0;
+    key_expr(expr);
+    for (i = 0; i < cse_count; i++)
+	if (strcmp(key_buf, cse_tab[i].key) == 0)
+	    return i;
+    if (cse_count >= cse_max) {
+	cse_max = cse_max ? 2*cse_max : 64;
+	cse_tab = realloc(cse_tab, cse_max * sizeof(cse_rec));
+    }
+    cse_tab[cse_count].key = strdup(key_buf);
+    cse_tab[cse_count].expr = expr;
+    cse_tab[cse_count].count = 0;
+    cse_tab[cse_count].id = 0;
+    return cse_count++;
+}
+
+/* Count uses of subexpressions.  Once an expression has been seen,
+   further occurrences reuse its value, so their parts are not counted */
+static void cse_walk(node_ptr expr)
+{
+    node_ptr ele;
+    int i;
+    if (expr->type == N_VAR || expr->type == N_NUM || expr->type == N_QUOTE)
+	return;
+    i = find_cse(expr);
+    expr->cse = i+1;
+    if (++cse_tab[i].count > 1)
+	return;
+    switch(expr->type) {
+    case N_NOT:
+	cse_walk(expr->arg1);
+	break;
+    case N_AND:
+    case N_OR:
+    case N_COMP:
+	cse_walk(expr->arg1);
+	cse_walk(expr->arg2);
+	break;
+    case N_ELE:
+	cse_walk(expr->arg1);
+	for (ele = expr->arg2; ele; ele=ele->next)
+	    cse_walk(ele);
+	break;
+    case N_CASE:
+	for (ele = expr; ele; ele=ele->next) {
+	    cse_walk(ele->arg1);
+	    cse_walk(ele->arg2);
+	}
+	break;
+    default:
+	break;
+    }
+}
+
+/*
+ * Membership tests and case blocks over small constants.
+ * Constants are numbers and signals whose C text is an upper case
+ * identifier, such as the I_ and REG_ enumeration values.  A set of
+ * them becomes a 64-bit mask.  Numbers are checked here.  For named
+ * constants, HCL_BIT in the generated C makes the compiler check that
+ * they lie in the range 0..63.
+ */
+
+static int is_default(node_ptr cond)
+{
+    return cond->type == N_NUM && atoll(cond->sval) == 1;
+}
+
+/* An undefined signal is not constant, so that the == chain for it
+   reports the error */
+static int is_const(node_ptr expr)
+{
+    node_ptr sym;
+    char *s;
+    if (expr->type == N_NUM)
+	return 1;
+    if (expr->type != N_VAR || !(sym = lookup_symbol(expr->sval)))
+	return 0;
+    s = sym->sval;
+    if (!isupper((int) *s) && *s != '_')
+	return 0;
+    for (; *s; s++)
+	if (!isupper((int) *s) && !isdigit((int) *s) && *s != '_')
+	    return 0;
+    return 1;
+}
+
+/* Can constant be placed in a 64-bit set? */
+static int is_small_const(node_ptr expr)
+{
+    if (expr->type == N_NUM) {
+	long long val = atoll(expr->sval);
+	return val >= 0 && val < 64;
+    }
+    return is_const(expr);
+}
+
+/* Is this a membership test with at least two small constants? */
+static int is_small_set(node_ptr expr)
+{
+    node_ptr ele;
+    if (expr->type != N_ELE || !expr->arg2 || !expr->arg2->next)
+	return 0;
+    for (ele = expr->arg2; ele; ele=ele->next)
+	if (!is_small_const(ele))
+	    return 0;
+    return 1;
+}
+
+/* If condition compares an expression against constants, return
+   that expression.  Otherwise return NULL */
+static node_ptr case_selector(node_ptr cond)
+{
+    node_ptr ele;
+    if (cond->type == N_ELE) {
+	for (ele = cond->arg2; ele; ele=ele->next)
+	    if (!is_const(ele))
+		return NULL;
+	return cond->arg1;
+    }
+    if (cond->type == N_COMP && strcmp(cond->sval, "==") == 0) {
+	if (is_const(cond->arg2))
+	    return cond->arg1;
+	if (is_const(cond->arg1))
+	    return cond->arg2;
+    }
+    return NULL;
+}
+
+/* Constants tested by condition for which case_selector succeeded */
+static int case_consts(node_ptr cond, node_ptr *consts, int max)
+{
+    node_ptr ele;
+    int cnt = 0;
+    if (cond->type == N_COMP) {
+	consts[0] = is_const(cond->arg2) ? cond->arg2 : cond->arg1;
+	return 1;
+    }
+    for (ele = cond->arg2; ele && cnt < max; ele=ele->next)
+	consts[cnt++] = ele;
+    return cnt;
+}
+
+/* Text of constant, for detecting duplicates */
+static char *const_text(node_ptr expr)
+{
+    node_ptr sym;
+    if (expr->type == N_NUM || !(sym = lookup_symbol(expr->sval)))
+	return expr->sval;
+    return sym->sval;
+}
+
+#define MAX_CASE_CONSTS 256
+
+/* Can case block become a switch statement?  All conditions before
+   the default must test the same expression against constants, with
+   no constant appearing twice, so that they are mutually exclusive.
+   The values must be constants too, letting the C compiler turn the
+   switch into a table lookup.  Otherwise a jump table is slower than
+   the conditional moves it makes of the nested ?: operators */
+static int is_switch(node_ptr expr)
+{
+    node_ptr consts[MAX_CASE_CONSTS];
+    node_ptr ele, sel;
+    char *sel_key;
+    int cnt = 0;
+    int ncase = 0;
+    int ok = 1;
+    if (coverage || expr->type != N_CASE || is_default(expr->arg1))
+	return 0;
+    sel = case_selector(expr->arg1);
+    if (!sel)
+	return 0;
+    key_len = 0;
+    key_expr(sel);
+    sel_key = strdup(key_buf);
+    for (ele = expr; ok && ele; ele=ele->next) {
+	int i, j, n;
+	node_ptr s;
+	if (!is_const(ele->arg2)) {
+	    ok = 0;
+	    break;
+	}
+	if (is_default(ele->arg1))
+	    break;
+	s = case_selector(ele->arg1);
+	if (!s) {
+	    ok = 0;
+	    break;
+	}
+	key_len = 0;
+	key_expr(s);
+	if (strcmp(key_buf, sel_key) != 0) {
+	    ok = 0;
+	    break;
+	}
+	n = case_consts(ele->arg1, consts+cnt, MAX_CASE_CONSTS-cnt);
+	for (i = cnt; ok && i < cnt+n; i++)
+	    for (j = 0; ok && j < i; j++)
+		if (strcmp(const_text(consts[i]), const_text(consts[j])) == 0)
+		    ok = 0;
+	cnt += n;
+	if (cnt >= MAX_CASE_CONSTS)
+	    ok = 0;
+	ncase++;
+    }
+    free(sel_key);
+    return ok && ncase > 1;
+}
+
+static void gen_expr(node_ptr expr);
+
+/* Generate case block as switch statement returning value */
+static void gen_switch(node_ptr expr)
+{
+    node_ptr consts[MAX_CASE_CONSTS];
+    node_ptr ele;
+    int done = 0;
+    outgen_print("    switch (");
+    gen_expr(case_selector(expr->arg1));
+    outgen_print(") {");
+    outgen_terminate();
+    for (ele = expr; ele && !done; ele=ele->next) {
+	if (is_default(ele->arg1)) {
+	    outgen_print("    default:");
+	    outgen_terminate();
+	    done = 1;
+	} else {
+	    int i;
+	    int n = case_consts(ele->arg1, consts, MAX_CASE_CONSTS);
+	    for (i = 0; i < n; i++) {
+		outgen_print("    case ");
+		gen_expr(consts[i]);
+		outgen_print(":");
+		outgen_terminate();
+	    }
+	}
+	outgen_print("        return ");
+	gen_expr(ele->arg2);
+	outgen_print(";");
+	outgen_terminate();
+    }
+    if (!done) {
+	outgen_print("    default:");
+	outgen_terminate();
+	outgen_print("        return 0;");
+	outgen_terminate();
+    }
+    outgen_print("    }");
+    outgen_terminate();
+}
+
+/* Is expression worth a local variable of gen_pipe_control? */
+static int is_shared(node_ptr expr)
+{
+    return expr->cse && cse_tab[expr->cse-1].count > 1 &&
+	expr_cost(expr) >= MIN_CSE_COST;
+}
+
+/* Declare the local variables expression uses, innermost first */
+static void gen_locals(node_ptr expr)
+{
+    node_ptr ele;
+    if (expr->cse && cse_tab[expr->cse-1].id)
+	return;
+    switch(expr->type) {
+    case N_NOT:
+	gen_locals(expr->arg1);
+	break;
+    case N_AND:
+    case N_OR:
+    case N_COMP:
+	gen_locals(expr->arg1);
+	gen_locals(expr->arg2);
+	break;
+    case N_ELE:
+	gen_locals(expr->arg1);
+	for (ele = expr->arg2; ele; ele=ele->next)
+	    gen_locals(ele);
+	break;
+    case N_CASE:
+	for (ele = expr; ele; ele=ele->next) {
+	    gen_locals(ele->arg1);
+	    gen_locals(ele->arg2);
+	}
+	break;
+    default:
+	return;
+    }
+    if (is_shared(expr)) {
+	cse_root = expr;
+	outgen_print("    long long t%d = ", ++cse_id);
+	gen_expr(expr);
+	outgen_print(";");
+	outgen_terminate();
+	cse_tab[expr->cse-1].id = cse_id;
+	cse_root = NULL;
+    }
+}
+
+/* Stages whose pipe registers psim controls, in order */
+static char *control_stages[] = {"F", "D", "E", "M", "W"};
+#define NUM_STAGES 5
+
+/* Index in def_tab of signal stage_kind, or -1 */
+static int find_def(char *stage, char *kind)
+{
+    char name[64];
+    int i;
+    sprintf(name, "%s_%s", stage, kind);
+    for (i = 0; i < def_count; i++)
+	if (strcmp(def_tab[0][i]->sval, name) == 0)
+	    return i;
+    return -1;
+}
+
+/* Generate gen_pipe_control, if all of its signals are defined */
+static void gen_pipe_control()
+{
+    int defs[2*NUM_STAGES];
+    int i;
+    /* Errors in the signals were reported with their own functions */
+    if (errcnt)
+	return;
+    for (i = 0; i < 2*NUM_STAGES; i++) {
+	defs[i] = find_def(control_stages[i/2], i%2 ? "bubble" : "stall");
+	if (defs[i] < 0)
+	    return;
+    }
+    outgen_print("/* Stall and bubble signals of the pipe registers, F to W */");
+    outgen_terminate();
+    outgen_print("#define HCL_PIPE_CONTROL");
+    outgen_terminate();
+    outgen_print("%svoid gen_pipe_control(long long *stall, long long *bubble)",
+		 inline_funct ? "static inline " : "");
+    outgen_terminate();
+    outgen_print("{");
+    outgen_terminate();
+    if (!coverage) {
+	for (i = 0; i < 2*NUM_STAGES; i++)
+	    cse_walk(def_tab[1][defs[i]]);
+	for (i = 0; i < 2*NUM_STAGES; i++)
+	    gen_locals(def_tab[1][defs[i]]);
+    }
+    for (i = 0; i < 2*NUM_STAGES; i++) {
+	outgen_print("    %s[%d] = ", i%2 ? "bubble" : "stall", i/2);
+	if (coverage)
+	    /* Each signal counts its own evaluations */
+	    outgen_print("gen_%s()", def_tab[0][defs[i]]->sval);
+	else
+	    gen_expr(def_tab[1][defs[i]]);
+	outgen_print(";");
+	outgen_terminate();
+    }
+    outgen_print("}");
+    outgen_terminate();
+    outgen_terminate();
+}
+
+/*
+ * Coverage instrumentation (-c).  Each function counts its evaluations
+ * and which part of its expression decided the result: the arm of a
+ * case block, the first false term of a conjunction, the first true
+ * term of a disjunction, or otherwise the value of a Boolean.  Switch
+ * statements are not generated, so that the conditions are tested one
+ * at a time, in order, and gen_pipe_control calls the signal functions
+ * instead of sharing terms among them.  The counters are shared by all
+ * threads of the simulator
+ */
+#define MAX_COV_TERMS 64
+#define MAX_COV_LABEL 512
+
+typedef struct {
+    char *signal;  /* Function name, for its evaluation count, or NULL */
+    char *label;   /* What else the counter counts */
+} cov_rec, *cov_ptr;
+
+static cov_ptr cov_tab = NULL;
+static int cov_count = 0;
+static int cov_max = 0;
+
+/* Add counter, returning its index */
+static int cov_add(char *signal, char *prefix, node_ptr expr)
+{
+    char *text = "";
+    char *label;
+    if (expr) {
+	errmax = MAX_COV_LABEL;
+	text = show_expr(expr);
+	errmax = MAXERRLEN;
+    }
+    label = malloc(strlen(prefix) + strlen(text) + 1);
+    strcpy(label, prefix);
+    strcat(label, text);
+    if (cov_count >= cov_max) {
+	cov_max = cov_max ? 2*cov_max : 64;
+	cov_tab = realloc(cov_tab, cov_max * sizeof(cov_rec));
+    }
+    cov_tab[cov_count].signal = signal;
+    cov_tab[cov_count].label = label;
+    return cov_count++;
+}
+
+/* Split a chain of &'s or |'s into its terms */
+static int cov_terms(node_ptr expr, node_type_t type, node_ptr *terms, int cnt)
+{
+    if (expr->type != type || cnt >= MAX_COV_TERMS-1) {
+	terms[cnt] = expr;
+	return cnt+1;
+    }
+    cnt = cov_terms(expr->arg1, type, terms, cnt);
+    return cov_terms(expr->arg2, type, terms, cnt);
+}
+
+/* Count with counter k and return value */
+static void gen_cov_return(int k, char *indent, node_ptr val, char *cval)
+{
+    outgen_print("%sHCL_COV(%d);", indent, k);
+    outgen_terminate();
+    outgen_print("%sreturn ", indent);
+    if (val)
+	gen_expr(val);
+    else
+	outgen_print("%s", cval);
+    outgen_print(";");
+    outgen_terminate();
+}
+
+/* Generate the body of an instrumented function */
+static void gen_cov_body(node_ptr var, node_ptr expr)
+{
+    node_ptr terms[MAX_COV_TERMS];
+    node_ptr ele;
+    int i, n;
+    outgen_print("    HCL_COV(%d);", cov_add(var->sval, "", NULL));
+    outgen_terminate();
+    if (expr->type == N_CASE) {
+	for (ele = expr; ele; ele=ele->next) {
+	    if (is_default(ele->arg1)) {
+		gen_cov_return(cov_add(NULL, "default", NULL), "    ",
+			       ele->arg2, NULL);
+		return;
+	    }
+	    outgen_print("    if (");
+	    gen_expr(ele->arg1);
+	    outgen_print(") {");
+	    outgen_terminate();
+	    gen_cov_return(cov_add(NULL, "", ele->arg1), "        ",
+			   ele->arg2, NULL);
+	    outgen_print("    }");
+	    outgen_terminate();
+	}
+	gen_cov_return(cov_add(NULL, "no case", NULL), "    ", NULL, "0");
+    } else if (var->isbool && (expr->type == N_AND || expr->type == N_OR)) {
+	int is_and = expr->type == N_AND;
+	n = cov_terms(expr, expr->type, terms, 0);
+	for (i = 0; i < n; i++) {
+	    outgen_print(is_and ? "    if (!" : "    if (");
+	    gen_expr(terms[i]);
+	    outgen_print(") {");
+	    outgen_terminate();
+	    gen_cov_return(cov_add(NULL, is_and ? "0 by " : "1 by ", terms[i]),
+			   "        ", NULL, is_and ? "0" : "1");
+	    outgen_print("    }");
+	    outgen_terminate();
+	}
+	gen_cov_return(cov_add(NULL, is_and ? "1" : "0", NULL), "    ",
+		       NULL, is_and ? "1" : "0");
+    } else if (var->isbool) {
+	outgen_print("    if (");
+	gen_expr(expr);
+	outgen_print(") {");
+	outgen_terminate();
+	gen_cov_return(cov_add(NULL, "1", NULL), "        ", NULL, "1");
+	outgen_print("    }");
+	outgen_terminate();
+	gen_cov_return(cov_add(NULL, "0", NULL), "    ", NULL, "0");
+    } else {
+	outgen_print("    return ");
+	gen_expr(expr);
+	outgen_print(";");
+	outgen_terminate();
+    }
+}
+
+/* Define the counters and the function that prints them */
+static void gen_cov_dump()
+{
+    int i;
+    char *s;
+    outgen_print("unsigned long long hcl_cov[%d];", cov_count);
+    outgen_terminate();
+    outgen_terminate();
+    outgen_print("static char *hcl_cov_names[%d][2] = {", cov_count);
+    outgen_terminate();
+    for (i = 0; i < cov_count; i++) {
+	/* Printed directly, since outgen would break up the labels */
+	fprintf(outfile, "    {%s%s%s, \"",
+		cov_tab[i].signal ? "\"" : "",
+		cov_tab[i].signal ? cov_tab[i].signal : "NULL",
+		cov_tab[i].signal ? "\"" : "");
+	for (s = cov_tab[i].label; *s; s++) {
+	    if (*s == '"' || *s == '\\')
+		fputc('\\', outfile);
+	    fputc(*s, outfile);
+	}
+	fprintf(outfile, "\"},\n");
+    }
+    outgen_print("};");
+    outgen_terminate();
+    outgen_terminate();
+    fprintf(outfile,
+	    "void hcl_cov_dump(FILE *out)\n"
+	    "{\n"
+	    "    int i;\n"
+	    "    fprintf(out, \"HCL coverage for %%s\\n\", simname);\n"
+	    "    for (i = 0; i < %d; i++)\n"
+	    "        if (hcl_cov_names[i][0])\n"
+	    "            fprintf(out, \"%%s: %%llu\\n\", hcl_cov_names[i][0], hcl_cov[i]);\n"
+	    "        else\n"
+	    "            fprintf(out, \"    %%12llu  %%s\\n\", hcl_cov[i], hcl_cov_names[i][1]);\n"
+	    "}\n", cov_count);
+}
+
+static void gen_deferred()
+{
+    int i;
+    int eof_line = lineno;
+    if (coverage) {
+	outgen_print("#include <stdio.h>");
+	outgen_terminate();
+	outgen_print("extern unsigned long long hcl_cov[];");
+	outgen_terminate();
+	outgen_print("#define HCL_COV(k) __atomic_fetch_add(&hcl_cov[k], 1, __ATOMIC_RELAXED)");
+	outgen_terminate();
+	outgen_terminate();
+    }
+    outgen_print("/* Is x in the set of small constants given as a bit mask? */");
+    outgen_terminate();
+    outgen_print("static inline int hcl_in(unsigned long long x, unsigned long long set)");
+    outgen_terminate();
+    outgen_print("{");
+    outgen_terminate();
+    outgen_print("    return ((set >> (x & 63)) & 1) & (x < 64);");
+    outgen_terminate();
+    outgen_print("}");
+    outgen_terminate();
+    outgen_terminate();
+    fprintf(outfile,
+	    "/* Bit for named constant c in such a mask, which must be below 64 */\n"
+	    "#define HCL_BIT(c) (1ULL << ((c) + 0*sizeof(struct {\\\n"
+	    "    _Static_assert((c) < 64, \"constant \" #c \" in an HCL set is not below 64\");\\\n"
+	    "    char x; })))\n\n");
+    for (i = 0; i < def_count; i++) {
+	/* Errors are reported at the definition */
+	lineno = def_line[i];
+	/* Print function header */
+	outgen_print("%slong long gen_%s()",
+		     inline_funct ? "static inline " : "", def_tab[0][i]->sval);
+	outgen_terminate();
+	outgen_print("{");
+	outgen_terminate();
+	if (coverage)
+	    gen_cov_body(def_tab[0][i], def_tab[1][i]);
+	else if (is_switch(def_tab[1][i]))
+	    gen_switch(def_tab[1][i]);
+	else {
+	    outgen_print("    return ");
+	    gen_expr(def_tab[1][i]);
+	    outgen_print(";");
+	    outgen_terminate();
+	}
+	outgen_print("}");
+	outgen_terminate();
+	outgen_terminate();
+    }
+    gen_pipe_control();
+    lineno = eof_line;
+    if (coverage)
+	gen_cov_dump();
+}
+#endif /* !VLOG && !UCLID */
+
 /* Recursively generate code for function */
 static void gen_expr(node_ptr expr)
 {
     node_ptr ele;
+#if !defined(VLOG) && !defined(UCLID)
+    if (expr != cse_root && expr->cse && cse_tab[expr->cse-1].id) {
+	outgen_print("t%d", cse_tab[expr->cse-1].id);
+	return;
+    }
+#endif
     switch(expr->type) {
     case N_QUOTE:
 	yyserror("Unexpected quoted string", expr->sval);
@@ -540,10 +1300,14 @@ static void gen_expr(node_ptr expr)
     case N_NOT:
 #if defined(VLOG) || defined(UCLID)
 	outgen_print("~");
+	gen_expr(expr->arg1);
 #else
-	outgen_print("!");
-#endif
+	/* Operand may be a helper call, which needs parentheses
+	   to keep gcc quiet when combined with & or | */
+	outgen_print("(!");
 	gen_expr(expr->arg1);
+	outgen_print(")");
+#endif
 	break;
     case N_COMP:
 	outgen_print("(");
@@ -564,6 +1328,25 @@ static void gen_expr(node_ptr expr)
 	outgen_downindent();
 	break;
     case N_ELE:
+#if !defined(VLOG) && !defined(UCLID)
+	if (is_small_set(expr)) {
+	    /* Single test against constant bit mask */
+	    outgen_print("hcl_in(");
+	    outgen_upindent();
+	    gen_expr(expr->arg1);
+	    outgen_print(", ");
+	    for (ele = expr->arg2; ele; ele=ele->next) {
+		outgen_print(ele->type == N_NUM ? "(1ULL << " : "HCL_BIT(");
+		gen_expr(ele);
+		outgen_print(")");
+		if (ele->next)
+		    outgen_print(" | ");
+	    }
+	    outgen_print(")");
+	    outgen_downindent();
+	    break;
+	}
+#endif
 	outgen_print("(");
 	outgen_upindent();
 	for (ele = expr->arg2; ele; ele=ele->next) {
@@ -686,18 +1469,18 @@ void gen_funct(node_ptr var, node_ptr expr, int isbool)
     }
     outgen_terminate();
 #else /* !UCLID */
-    /* Print function header */
-    outgen_print("long long gen_%s()", var->sval);
-    outgen_terminate();
-    outgen_print("{");
-    outgen_terminate();
-    outgen_print("    return ");
-    gen_expr(expr);
-    outgen_print(";");
-    outgen_terminate();
-    outgen_print("}");
-    outgen_terminate();
-    outgen_terminate();
+    /* Generated by finish_node, once gen_pipe_control can see all signals */
+    if (def_count >= def_max) {
+	def_max = def_max ? 2*def_max : 64;
+	def_tab[0] = realloc(def_tab[0], def_max * sizeof(node_ptr));
+	def_tab[1] = realloc(def_tab[1], def_max * sizeof(node_ptr));
+	def_line = realloc(def_line, def_max * sizeof(int));
+    }
+    var->isbool = isbool;
+    def_tab[0][def_count] = var;
+    def_tab[1][def_count] = expr;
+    def_line[def_count] = lineno;
+    def_count++;
 #endif /* UCLID */
 #endif /* VLOG */
 }
@@ -8,6 +8,7 @@ typedef struct NODE {
     struct NODE *arg1;
     struct NODE *arg2;
     int ref;     /* For var, how many times has it been referenced? */
+    int cse;     /* Index+1 of subexpression record, or 0 [C only] */
     struct NODE *next;
 } node_rec, *node_ptr;
 
@@ -0,0 +1,57 @@
+/* Writer for binary cycle traces (see trace.h) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+/* Records are buffered and written out this many at a time */
+#define TRACE_BUF 4096
+
+static FILE *trace_file = NULL;
+static trace_rec_t trace_buf[TRACE_BUF];
+static int trace_cnt = 0;
+
+bool_t trace_open(char *fname, trace_kind_t kind, char *simname)
+{
+    trace_hdr_t hdr;
+
+    trace_file = fopen(fname, "wb");
+    if (!trace_file)
+	return FALSE;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+    hdr.kind = kind;
+    hdr.rec_size = sizeof(trace_rec_t);
+    strncpy(hdr.simname, simname, sizeof(hdr.simname)-1);
+    fwrite(&hdr, sizeof(hdr), 1, trace_file);
+    trace_cnt = 0;
+    return TRUE;
+}
+
+static void trace_flush()
+{
+    if (trace_cnt > 0 &&
+	fwrite(trace_buf, sizeof(trace_rec_t), trace_cnt, trace_file) != trace_cnt) {
+	perror("Couldn't write trace");
+	exit(1);
+    }
+    trace_cnt = 0;
+}
+
+void trace_write(trace_rec_t *rec)
+{
+    if (trace_cnt == TRACE_BUF)
+	trace_flush();
+    trace_buf[trace_cnt++] = *rec;
+}
+
+void trace_close()
+{
+    if (!trace_file)
+	return;
+    trace_flush();
+    fclose(trace_file);
+    trace_file = NULL;
+}
@@ -0,0 +1,61 @@
+/* Binary cycle traces written by psim and ssim (-T) and read by ytrace */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "isa.h"
+
+/*
+ * A trace file is a header followed by one fixed-size record per
+ * cycle, in the byte order of the machine that wrote it.  The
+ * simulators fill in a record and copy it into a buffer, so tracing
+ * costs little more than the copy; ytrace turns the records back into
+ * text or into VCD waveforms.
+ */
+
+#define TRACE_MAGIC "Y86TRACE"
+
+/* Which simulator wrote the trace */
+typedef enum { TRACE_PIPE, TRACE_SEQ } trace_kind_t;
+
+/* Stages of PIPE.  A SEQ trace uses only the first */
+typedef enum { TRACE_F, TRACE_D, TRACE_E, TRACE_M, TRACE_W,
+	       TRACE_STAGES } trace_stage_t;
+
+typedef struct {
+    char magic[8];      /* TRACE_MAGIC, not null terminated */
+    word_t kind;        /* trace_kind_t */
+    word_t rec_size;    /* sizeof(trace_rec_t) of the writer */
+    char simname[48];   /* Simulator name, null terminated */
+} trace_hdr_t;
+
+typedef struct {
+    word_t cycle;
+    /* PIPE: F is the PC selected for fetch, and D to W the PC of the
+       instruction held in each pipe register.  SEQ: the PC */
+    word_t pc[TRACE_STAGES];
+    /* PIPE: the operands leaving decode, after forwarding, the ALU
+       result and the word read in memory.  SEQ: the same signals */
+    word_t vala;
+    word_t valb;
+    word_t vale;
+    word_t valm;
+    byte_t instr[TRACE_STAGES]; /* icode:ifun, as in HPACK */
+    byte_t stat[TRACE_STAGES];  /* Status of each stage (stat_t) */
+    byte_t op[TRACE_STAGES];    /* PIPE: control applied to each pipe
+				   register at the end of the cycle:
+				   load, stall, bubble or error */
+    byte_t cc;
+    byte_t status;              /* Processor status (stat_t) */
+    byte_t pad[3];
+} trace_rec_t;
+
+/* Open fname for writing and emit the header.  Returns FALSE on error */
+bool_t trace_open(char *fname, trace_kind_t kind, char *simname);
+
+/* Append a record */
+void trace_write(trace_rec_t *rec);
+
+/* Flush the buffered records and close the file */
+void trace_close();
+
+#endif /* TRACE_H */
@@ -9,7 +9,10 @@
 
 void add_symbol(char *, int);
 int find_symbol(char *);
+int find_symbol_pos(char *);
 int instr_size(char *);
+static word_t label_value(char *, int, int, word_t);
+static void emit_code(int);
 
 int gui_mode = 0;
 
@@ -22,12 +25,17 @@ int vcode = 0;
 /* Should it generate code for banked memory? */
 int block_factor = 0;
 
+/* Generate segmented binary image instead of .yo listing? */
+int bcode = 0;
+
 int lineno = 1; /* Line number of input file */
 int bytepos = 0; /* Address of current instruction being processed */
 int error_mode = 0; /* Am I trying to finish off a line with an error? */
 int hit_error = 0; /* Have I hit any errors? */
 
 int pass = 1; /* Am I in pass 1 or 2? */
+int npasses = 1; /* Reread the input for a second pass, or patch up
+		    forward references at the end of a single pass? */
 
 /* General strategy is to read tokens for a complete line and then
    process them.
@@ -130,9 +138,73 @@ static void hexstuff(char *dest, word_t value, int len)
     }
 }
 
+/* Segments of binary image, in order of generation */
+typedef struct {
+    word_t addr;
+    int len;
+    int maxlen;
+    byte_t *bytes;
+} segment_rec, *segment_ptr;
+
+segment_ptr segments = NULL;
+int segment_cnt = 0;
+int segment_max = 0;
+
+/* Add bytes of current instruction to binary image.
+   Extends the last segment when the code is contiguous with it */
+void add_image_code(int pos)
+{
+    segment_ptr seg = segment_cnt ? &segments[segment_cnt-1] : NULL;
+    if (!seg || seg->addr + seg->len != pos) {
+	if (segment_cnt == segment_max) {
+	    segment_max = segment_max ? 2*segment_max : 16;
+	    segments = (segment_ptr)
+		realloc(segments, segment_max*sizeof(segment_rec));
+	}
+	seg = &segments[segment_cnt++];
+	seg->addr = pos;
+	seg->len = 0;
+	seg->maxlen = 0;
+	seg->bytes = NULL;
+    }
+    if (seg->len + bcount > seg->maxlen) {
+	seg->maxlen = seg->maxlen ? 2*seg->maxlen : 256;
+	if (seg->maxlen < seg->len + bcount)
+	    seg->maxlen = seg->len + bcount;
+	seg->bytes = (byte_t *) realloc(seg->bytes, seg->maxlen);
+    }
+    memcpy(seg->bytes + seg->len, code, bcount);
+    seg->len += bcount;
+}
+
+/* Write 8-byte little-endian field of image header */
+static void put_le_word(FILE *out, word_t val)
+{
+    int i;
+    for (i = 0; i < 8; i++)
+	putc((val >> (8*i)) & 0xFF, out);
+}
+
+/* Write binary image in the format read by load_mem */
+void print_image(FILE *out)
+{
+    int i;
+    fwrite(IMG_SEG_MAGIC, 1, IMG_MAGIC_LEN, out);
+    for (i = 0; i < segment_cnt; i++) {
+	put_le_word(out, segments[i].addr);
+	put_le_word(out, segments[i].len);
+	fwrite(segments[i].bytes, 1, segments[i].len, out);
+    }
+}
+
 void print_code(FILE *out, int pos)
 {
     char outstring[33];
+    if (bcode) {
+	if (tcount && bcount)
+	    add_image_code(pos);
+	return;
+    }
     if (pos > 0xFFF) {
 	/* Printing format:
 	   0xHHHH: cccccccccccccccccccc | <line>
@@ -189,6 +261,115 @@ void print_code(FILE *out, int pos)
     }
 }
 
+/*
+ * In a single pass, the listing is kept until the end of the input,
+ * so that the code for references to labels that come later can be
+ * patched before it is written.  A fixup records one such reference
+ */
+typedef struct {
+    int pos;       /* Address of the code */
+    int lineno;    /* Input line that produced it */
+    int tcount;
+    int bcount;
+    char code[10];
+    char *line;    /* Input line */
+} listing_rec, *listing_ptr;
+
+listing_ptr listing = NULL;
+int listing_cnt = 0;
+int listing_max = 0;
+
+typedef struct {
+    char *name;    /* Label referenced */
+    int rec;       /* Listing record that holds the field */
+    int codepos;   /* Position of field in its code */
+    int bytes;     /* Length of field */
+    word_t offset; /* Value to subtract from label */
+} fixup_rec, *fixup_ptr;
+
+fixup_ptr fixups = NULL;
+int fixup_cnt = 0;
+int fixup_max = 0;
+
+/* Note that the field of the current instruction at codepos refers to
+   a label that hasn't been seen yet */
+static void add_fixup(char *name, int codepos, int bytes, word_t offset)
+{
+    fixup_ptr f;
+    if (fixup_cnt == fixup_max) {
+	fixup_max = fixup_max ? 2*fixup_max : 256;
+	fixups = (fixup_ptr) realloc(fixups, fixup_max*sizeof(fixup_rec));
+    }
+    f = &fixups[fixup_cnt++];
+    f->name = strdup(name);
+    f->rec = listing_cnt;
+    f->codepos = codepos;
+    f->bytes = bytes;
+    f->offset = offset;
+}
+
+/* Drop fixups of a line that ended in an error and won't be listed */
+static void drop_fixups()
+{
+    while (fixup_cnt > 0 && fixups[fixup_cnt-1].rec == listing_cnt) {
+	fixup_cnt--;
+	free(fixups[fixup_cnt].name);
+    }
+}
+
+/* Output the current line, or save it until the end of a single pass */
+static void emit_code(int pos)
+{
+    listing_ptr r;
+    if (npasses > 1) {
+	print_code(outfile, pos);
+	return;
+    }
+    if (listing_cnt == listing_max) {
+	listing_max = listing_max ? 2*listing_max : 1024;
+	listing = (listing_ptr)
+	    realloc(listing, listing_max*sizeof(listing_rec));
+    }
+    r = &listing[listing_cnt++];
+    r->pos = pos;
+    r->lineno = lineno;
+    r->tcount = tcount;
+    r->bcount = bcount;
+    memcpy(r->code, code, sizeof(r->code));
+    r->line = strdup(input_line);
+}
+
+/* Patch in the labels that were forward references, and output the
+   saved listing */
+static void finish_listing(FILE *out)
+{
+    int i, j;
+    for (i = 0; i < fixup_cnt; i++) {
+	fixup_ptr f = &fixups[i];
+	listing_ptr r = &listing[f->rec];
+	int p = find_symbol_pos(f->name);
+	if (p < 0) {
+	    /* Report it as the second pass would */
+	    lineno = r->lineno;
+	    bytepos = r->pos + r->bcount;
+	    strcpy(input_line, r->line);
+	    error_mode = 0;
+	    fail("Can't find label");
+	}
+	for (j = 0; j < f->bytes; j++)
+	    r->code[f->codepos+j] = ((p - f->offset) >> (j*8)) & 0xFF;
+    }
+    for (i = 0; i < listing_cnt; i++) {
+	listing_ptr r = &listing[i];
+	lineno = r->lineno;
+	tcount = r->tcount;
+	bcount = r->bcount;
+	memcpy(code, r->code, sizeof(code));
+	strcpy(input_line, r->line);
+	print_code(out, r->pos);
+    }
+}
+
 void fail(char *message)
 {
     if (!error_mode) {
@@ -231,7 +412,7 @@ void get_num(int codepos, int bytes, int offset)
     if (tokens[tpos].type == TOK_NUM) {
 	val = tokens[tpos].ival;
     } else if (tokens[tpos].type == TOK_IDENT) {
-	val = find_symbol(tokens[tpos].sval);
+	val = label_value(tokens[tpos].sval, codepos, bytes, offset);
     } else {
 	fail("Number Expected");
 	return;
@@ -264,7 +445,7 @@ void get_mem(int codepos)
 	val = tokens[tpos++].ival;
 	type = tokens[tpos].type;
     } else if (type == TOK_IDENT) {
-	val = find_symbol(tokens[tpos++].sval);
+	val = label_value(tokens[tpos++].sval, codepos+1, 8, 0);
 	type = tokens[tpos].type;    
     }
     /* Check for optional register */
@@ -293,6 +474,7 @@ void get_mem(int codepos)
 void start_line()
 {
     int t;
+    drop_fixups();
     error_mode = 0;
     tpos = 0;
     tcount = 0;
@@ -310,8 +492,8 @@ void finish_line()
     tpos = 0;
     codepos = 0;
     if (tcount == 0) {
-	if (pass > 1)
-	    print_code(outfile, savebytepos);
+	if (pass == npasses)
+	    emit_code(savebytepos);
 	start_line();
 	return; /* Empty line */
     }
@@ -334,8 +516,8 @@ void finish_line()
 	    tpos+=2;
 	    if (tcount == 2) {
 		/* That's all for this line */
-		if (pass > 1)
-		    print_code(outfile, savebytepos);
+		if (pass == npasses)
+		    emit_code(savebytepos);
 		start_line();
 		return;
 	    }
@@ -355,8 +537,8 @@ void finish_line()
 	    return;
 	}
 	bytepos = tokens[tpos].ival;
-	if (pass > 1) {
-	    print_code(outfile, bytepos);
+	if (pass == npasses) {
+	    emit_code(bytepos);
 	}
 	start_line();
 	return;
@@ -371,8 +553,8 @@ void finish_line()
 	}
 	bytepos = ((bytepos+a-1)/a)*a;
 
-	if (pass > 1) {
-	    print_code(outfile, bytepos);
+	if (pass == npasses) {
+	    emit_code(bytepos);
 	}
 	start_line();
 	return;
@@ -388,8 +570,8 @@ void finish_line()
     bcount = size;
 
 
-    /* If this is pass 1, then we're done */
-    if (pass == 1) {
+    /* If this is pass 1 of 2, then we're done */
+    if (pass < npasses) {
 	start_line();
 	return;
     }
@@ -438,7 +620,7 @@ void finish_line()
 	}
     }
 
-    print_code(outfile, savebytepos);
+    emit_code(savebytepos);
     start_line();
 }
 
@@ -492,33 +674,112 @@ void add_punct(char c)
     add_token(TOK_PUNCT, NULL, 0, c);
 }
 
-#define STAB 1000
-
-#define INIT_CNT 0
-
-int symbol_cnt = INIT_CNT;
-struct {
+/*
+ * Symbols are kept in the order they are defined, and found through an
+ * open-addressed hash table of indices into that array.  The table is
+ * sized from the length of the input, and doubles whenever it gets
+ * half full
+ */
+typedef struct {
     char *name;
     int pos;
-} symbol_table[STAB];
+} symbol_rec, *symbol_ptr;
+
+symbol_ptr symbol_table = NULL;
+int symbol_cnt = 0;
+int symbol_max = 0;
+
+int *symbol_hash = NULL; /* Index into symbol_table, or -1 if empty */
+int hash_size = 0;       /* Always a power of 2 */
+
+static unsigned hash_name(char *name)
+{
+    unsigned h = 2166136261u;
+    while (*name)
+	h = (h ^ (unsigned char) *name++) * 16777619u;
+    return h;
+}
+
+/* Slot where name is, or where it should go */
+static int hash_slot(char *name)
+{
+    int i = hash_name(name) & (hash_size-1);
+    while (symbol_hash[i] >= 0 &&
+	   strcmp(name, symbol_table[symbol_hash[i]].name) != 0)
+	i = (i+1) & (hash_size-1);
+    return i;
+}
+
+static void hash_resize(int size)
+{
+    int i;
+    free(symbol_hash);
+    hash_size = size;
+    symbol_hash = (int *) malloc(hash_size*sizeof(int));
+    for (i = 0; i < hash_size; i++)
+	symbol_hash[i] = -1;
+    for (i = 0; i < symbol_cnt; i++)
+	symbol_hash[hash_slot(symbol_table[i].name)] = i;
+}
+
+/* Make room for the labels of an input file of len bytes, guessing
+   that a label takes at least 16 */
+void init_symbols(long len)
+{
+    int size = 64;
+    while (size < len/8)
+	size *= 2;
+    hash_resize(size);
+}
 
 void add_symbol(char *name, int p)
 {
-    char *t = (char *) malloc(strlen(name)+1);
-    strcpy(t, name);
-    symbol_table[symbol_cnt].name = t;
+    int i;
+    if (2*(symbol_cnt+1) > hash_size)
+	hash_resize(hash_size ? 2*hash_size : 64);
+    i = hash_slot(name);
+    if (symbol_hash[i] >= 0)
+	return; /* References go to the first definition */
+    if (symbol_cnt == symbol_max) {
+	symbol_max = symbol_max ? 2*symbol_max : 256;
+	symbol_table = (symbol_ptr)
+	    realloc(symbol_table, symbol_max*sizeof(symbol_rec));
+    }
+    symbol_table[symbol_cnt].name = strdup(name);
     symbol_table[symbol_cnt].pos = p;
-    symbol_cnt++;
+    symbol_hash[i] = symbol_cnt++;
 }
 
-int find_symbol(char *name)
+/* Address of label, or -1 if it hasn't been defined */
+int find_symbol_pos(char *name)
 {
     int i;
-    for (i = 0; i < symbol_cnt; i++)
-	if (strcmp(name, symbol_table[i].name) == 0)
-	    return symbol_table[i].pos;
-    fail("Can't find label");
-    return -1;
+    if (hash_size == 0)
+	return -1;
+    i = symbol_hash[hash_slot(name)];
+    return i < 0 ? -1 : symbol_table[i].pos;
+}
+
+int find_symbol(char *name)
+{
+    int p = find_symbol_pos(name);
+    if (p < 0)
+	fail("Can't find label");
+    return p;
+}
+
+/* Value of a label used for the field of the current instruction at
+   code[codepos].  In a single pass, a label that isn't defined yet
+   gets a fixup and is patched in at the end */
+static word_t label_value(char *name, int codepos, int bytes, word_t offset)
+{
+    int p = find_symbol_pos(name);
+    if (p >= 0)
+	return p;
+    if (npasses > 1)
+	return find_symbol(name);
+    add_fixup(name, codepos, bytes, offset);
+    return 0;
 }
 
 int yywrap()
@@ -527,9 +788,9 @@ int yywrap()
     if (tcount > 0) {
 	fail("Missing end-of-line on final line\n");
     }
-    if (verbose && pass > 1) {
+    if (verbose && pass == npasses) {
 	printf("Symbol Table:\n");
-	for (i = INIT_CNT; i < symbol_cnt; i++)
+	for (i = 0; i < symbol_cnt; i++)
 	    printf(" %s\t0x%x\n", symbol_table[i].name, symbol_table[i].pos);
     }
     return 1;
@@ -538,10 +799,52 @@ int yywrap()
 extern FILE *yyin;
 int yylex();
 
+/*
+ * Assemble file in to the listing (or, with bcode, the image) out in a
+ * single pass, starting afresh.  This is what is left of yas when it
+ * is compiled with -DYAS_LIBRARY, to be linked into a program that
+ * assembles in memory.  Returns nonzero if there were errors
+ */
+int yas_assemble(FILE *in, FILE *out)
+{
+    int i;
+    for (i = 0; i < symbol_cnt; i++)
+	free(symbol_table[i].name);
+    symbol_cnt = 0;
+    hash_resize(hash_size ? hash_size : 64);
+    for (i = 0; i < listing_cnt; i++)
+	free(listing[i].line);
+    listing_cnt = 0;
+    for (i = 0; i < fixup_cnt; i++)
+	free(fixups[i].name);
+    fixup_cnt = 0;
+    for (i = 0; i < segment_cnt; i++)
+	free(segments[i].bytes);
+    segment_cnt = 0;
+
+    outfile = out;
+    pass = npasses = 1;
+    lineno = 1;
+    bytepos = 0;
+    error_mode = hit_error = 0;
+    tcount = 0;
+    /* The scanner is always at the end of its last file */
+    yyin = in;
+    yylex();
+    finish_listing(out);
+    if (bcode)
+	print_image(out);
+    return hit_error;
+}
+
+#ifndef YAS_LIBRARY
+
 static void usage(char *pname)
 {
-    printf("Usage: %s [-V[n]] file.ys\n", pname);
+    printf("Usage: %s [-2] [-V[n] | -b] file.ys\n", pname);
+    printf("   -2     Read the input twice instead of patching forward references\n");
     printf("   -V[n]  Generate memory initialization in Verilog format (n-way blocking)\n");
+    printf("   -b     Generate binary memory image file.ybo instead of file.yo\n");
     exit(0);
 }
 
@@ -553,9 +856,13 @@ int main(int argc, char *argv[])
     int nextarg = 1;
     if (argc < 2)
 	usage(argv[0]);
-    if (argv[nextarg][0] == '-') {
+    while (nextarg < argc && argv[nextarg][0] == '-') {
       char flag = argv[nextarg][1];
       switch (flag) {
+      case '2':
+	npasses = 2;
+	nextarg++;
+	break;
       case 'V':
 	vcode = 1;
 	if (argv[nextarg][2]) {
@@ -567,10 +874,16 @@ int main(int argc, char *argv[])
 	}
 	nextarg++;
 	break;
+      case 'b':
+	bcode = 1;
+	nextarg++;
+	break;
       default:
 	usage(argv[0]);
       }
     }
+    if (nextarg >= argc)
+	usage(argv[0]);
     rootlen = strlen(argv[nextarg])-3;
     if (strcmp(argv[nextarg]+rootlen, ".ys"))
 	usage(argv[0]);
@@ -586,19 +899,30 @@ int main(int argc, char *argv[])
 	fprintf(stderr, "Can't open input file '%s'\n", infname);
 	exit(1);
     }
+    if (fseek(yyin, 0, SEEK_END) == 0) {
+	init_symbols(ftell(yyin));
+	rewind(yyin);
+    }
 
     if (vcode) {
       outfile = stdout;
     } else {
       strncpy(outfname, argv[nextarg], rootlen);
-      strcpy(outfname+rootlen, ".yo");
-      outfile = fopen(outfname, "w");
+      strcpy(outfname+rootlen, bcode ? ".ybo" : ".yo");
+      outfile = fopen(outfname, bcode ? "wb" : "w");
       if (!outfile) {
 	fprintf(stderr, "Can't open output file '%s'\n", outfname);
 	exit(1);
       }
     }
 
+    if (npasses == 1) {
+	int err = yas_assemble(yyin, outfile);
+	fclose(yyin);
+	fclose(outfile);
+	return err;
+    }
+
     pass = 1;
 
     yylex();
@@ -619,9 +943,12 @@ int main(int argc, char *argv[])
 
     yylex();
     fclose(yyin);
+    if (bcode)
+	print_image(outfile);
     fclose(outfile);
     return hit_error;
 }
+#endif /* YAS_LIBRARY */
 
 unsigned long long atollh(const char *p) {
     return strtoull(p, (char **) NULL, 16);
@@ -7,6 +7,7 @@ void add_punct(char);
 void add_num(long long);
 void fail(char *msg);
 unsigned long long atollh(const char *);
+int yas_assemble(FILE *in, FILE *out);
 
 
 /* Current line number */
@@ -2,15 +2,21 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "isa.h"
+#include "driver.h"
 
 /* YIS never runs in GUI mode */
 int gui_mode = 0;
 
 void usage(char *pname)
 {
-    printf("Usage: %s code_file [max_steps]\n", pname);
+    printf("Usage: %s [-m size] [-d n[:seed]] code_file [max_steps]\n", pname);
+    printf("   -m s   Set memory size to s bytes, with optional K/M/G suffix (default %d)\n", MEM_SIZE);
+    printf("   -d n[:seed] Run code_file, an ncopy assembled by itself, under a driver\n");
+    printf("          for n elements built in memory, and check the result.  With a\n");
+    printf("          seed, the words are positive at random (as gen-driver.pl -r)\n");
     exit(0);
 }
 
@@ -18,34 +24,75 @@ int main(int argc, char *argv[])
 {
     FILE *code_file;
     int max_steps = 10000;
-
-    state_ptr s = new_state(MEM_SIZE);
-    mem_t saver = copy_reg(s->r);
+    word_t mem_size = MEM_SIZE;
+    int c;
+    char *driver_option = NULL;
+    driver_t drv;
+    word_t drv_n = 0;
+    unsigned drv_seed = 0;
+    bool_t drv_random = FALSE;
+    word_t code_len;
+
+    state_ptr s;
+    mem_t saver;
     mem_t savem;
     int step = 0;
 
     stat_t e = STAT_AOK;
 
-    if (argc < 2 || argc > 3)
+    while ((c = getopt(argc, argv, "m:d:")) != -1) {
+	switch(c) {
+	case 'm':
+	    mem_size = parse_mem_size(optarg);
+	    if (mem_size <= 0) {
+		printf("Invalid memory size '%s'\n", optarg);
+		usage(argv[0]);
+	    }
+	    break;
+	case 'd':
+	    driver_option = optarg;
+	    if (!driver_parse(optarg, &drv_n, &drv_seed, &drv_random)) {
+		printf("Invalid driver '%s'\n", optarg);
+		usage(argv[0]);
+	    }
+	    break;
+	default:
+	    usage(argv[0]);
+	    break;
+	}
+    }
+
+    if (argc - optind < 1 || argc - optind > 2)
 	usage(argv[0]);
-    code_file = fopen(argv[1], "r");
+    code_file = fopen(argv[optind], "r");
     if (!code_file) {
-	fprintf(stderr, "Can't open code file '%s'\n", argv[1]);
+	fprintf(stderr, "Can't open code file '%s'\n", argv[optind]);
 	exit(1);
     }
 
-    if (!load_mem(s->m, code_file, 1)) {
+    s = new_state(mem_size);
+    saver = copy_reg(s->r);
+
+    if (driver_option) {
+	code_len = driver_load(s->m, code_file);
+	if (code_len == 0) {
+	    printf("Exiting\n");
+	    return 1;
+	}
+	driver_build(s->m, code_len, drv_n, drv_seed, drv_random, &drv);
+	s->pc = drv.main;
+    } else if (!load_mem(s->m, code_file, 1)) {
 	printf("Exiting\n");
 	return 1;
     }
 
     savem = copy_mem(s->m);
   
-    if (argc > 2)
-	max_steps = atoi(argv[2]);
+    if (argc - optind > 1)
+	max_steps = atoi(argv[optind+1]);
 
     for (step = 0; step < max_steps && e == STAT_AOK; step++)
-	e = step_state(s, stdout);
+	e = step_state_fast(s, stdout);
 
     printf("Stopped in %d steps at PC = 0x%llx.  Status '%s', CC %s\n",
 	   step, s->pc, stat_name(e), cc_name(s->cc));
@@ -56,6 +103,11 @@ int main(int argc, char *argv[])
     printf("\nChanges to memory:\n");
     diff_mem(savem, s->m, stdout);
 
+    if (driver_option)
+	printf("Driver check: %s\n",
+	       driver_result_names[driver_check(s->m, s->r, e, &drv,
+						code_len, 0)]);
+
     free_state(s);
     free_reg(saver);
     free_mem(savem);
@@ -0,0 +1,219 @@
+/* ytrace - Print a binary cycle trace from psim or ssim (-T) as text or VCD */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "isa.h"
+#include "trace.h"
+
+/* ytrace never runs in GUI mode */
+int gui_mode = 0;
+
+static char stage_names[TRACE_STAGES] = {'F', 'D', 'E', 'M', 'W'};
+
+/* Pipe register controls, in the order of p_stat_t in pipe/pipeline.h */
+static char *ctl_names[] = {"load", "stall", "bubble", "error"};
+
+static char *ctl_name(byte_t op)
+{
+    return op < sizeof(ctl_names)/sizeof(ctl_names[0]) ? ctl_names[op] : "????";
+}
+
+void usage(char *pname)
+{
+    printf("Usage: %s [-hV] trace_file\n", pname);
+    printf("   -h     Print this message\n");
+    printf("   -V     Write VCD waveforms instead of text\n");
+    exit(0);
+}
+
+/************************* Text output ****************************/
+
+static void print_text(trace_kind_t kind, trace_rec_t *r)
+{
+    int s;
+
+    printf("\nCycle %lld. CC=%s, Stat=%s\n",
+	   r->cycle, cc_name(r->cc), stat_name(r->status));
+    if (kind == TRACE_SEQ) {
+	printf("PC = 0x%llx, instr = %s, Stat = %s\n",
+	       r->pc[0], iname(r->instr[0]), stat_name(r->stat[0]));
+	printf("valA = 0x%llx, valB = 0x%llx, valE = 0x%llx, valM = 0x%llx\n",
+	       r->vala, r->valb, r->vale, r->valm);
+	return;
+    }
+    for (s = 0; s < TRACE_STAGES; s++)
+	printf("%c: PC = 0x%llx, instr = %s, Stat = %s, next = %s\n",
+	       stage_names[s], r->pc[s], iname(r->instr[s]),
+	       stat_name(r->stat[s]), ctl_name(r->op[s]));
+    printf("d_valA = 0x%llx, d_valB = 0x%llx, e_valE = 0x%llx, m_valM = 0x%llx\n",
+	   r->vala, r->valb, r->vale, r->valm);
+}
+
+/************************* VCD output *****************************/
+
+#define MAXSIG 32
+
+/* A signal in the VCD file */
+typedef struct {
+    char name[16];
+    int width;
+    char id;        /* VCD identifier code */
+    word_t last;    /* Last value written */
+} signal_t;
+
+static signal_t sigs[MAXSIG];
+static int nsigs = 0;
+
+static void add_signal(char *name, int width)
+{
+    signal_t *sg = &sigs[nsigs];
+    strncpy(sg->name, name, sizeof(sg->name)-1);
+    sg->width = width;
+    sg->id = '!' + nsigs;
+    nsigs++;
+}
+
+/* Declare the signals, in the order that vcd_values fills them in */
+static void vcd_header(trace_kind_t kind, char *simname)
+{
+    int s, i;
+    char name[16];
+
+    if (kind == TRACE_SEQ) {
+	add_signal("PC", 64);
+	add_signal("instr", 8);
+	add_signal("stat", 4);
+    } else {
+	for (s = 0; s < TRACE_STAGES; s++) {
+	    sprintf(name, "%c_pc", stage_names[s]);
+	    add_signal(name, 64);
+	    sprintf(name, "%c_instr", stage_names[s]);
+	    add_signal(name, 8);
+	    sprintf(name, "%c_stat", stage_names[s]);
+	    add_signal(name, 4);
+	    sprintf(name, "%c_op", stage_names[s]);
+	    add_signal(name, 2);
+	}
+    }
+    add_signal(kind == TRACE_SEQ ? "valA" : "d_valA", 64);
+    add_signal(kind == TRACE_SEQ ? "valB" : "d_valB", 64);
+    add_signal(kind == TRACE_SEQ ? "valE" : "e_valE", 64);
+    add_signal(kind == TRACE_SEQ ? "valM" : "m_valM", 64);
+    add_signal("cc", 3);
+    add_signal("Stat", 4);
+
+    printf("$version %s $end\n", simname);
+    printf("$timescale 1 ns $end\n");
+    printf("$scope module %s $end\n", kind == TRACE_SEQ ? "seq" : "pipe");
+    for (i = 0; i < nsigs; i++)
+	printf("$var wire %d %c %s $end\n",
+	       sigs[i].width, sigs[i].id, sigs[i].name);
+    printf("$upscope $end\n");
+    printf("$enddefinitions $end\n");
+}
+
+static int vcd_values(trace_kind_t kind, trace_rec_t *r, word_t *vals)
+{
+    int n = 0;
+    int s;
+
+    for (s = 0; s < (kind == TRACE_SEQ ? 1 : TRACE_STAGES); s++) {
+	vals[n++] = r->pc[s];
+	vals[n++] = r->instr[s];
+	vals[n++] = r->stat[s];
+	if (kind != TRACE_SEQ)
+	    vals[n++] = r->op[s];
+    }
+    vals[n++] = r->vala;
+    vals[n++] = r->valb;
+    vals[n++] = r->vale;
+    vals[n++] = r->valm;
+    vals[n++] = r->cc;
+    vals[n++] = r->status;
+    return n;
+}
+
+/* Write the signals that changed since the last record */
+static void print_vcd(trace_kind_t kind, trace_rec_t *r, bool_t first)
+{
+    word_t vals[MAXSIG];
+    int n = vcd_values(kind, r, vals);
+    bool_t stamped = FALSE;
+    int i, b;
+
+    for (i = 0; i < n; i++) {
+	signal_t *sg = &sigs[i];
+	if (!first && vals[i] == sg->last)
+	    continue;
+	if (!stamped) {
+	    printf("#%lld\n", r->cycle);
+	    stamped = TRUE;
+	}
+	putchar('b');
+	for (b = sg->width-1; b > 0 && !((uword_t) vals[i] >> b & 1); b--)
+	    ;
+	for (; b >= 0; b--)
+	    putchar('0' + ((uword_t) vals[i] >> b & 1));
+	printf(" %c\n", sg->id);
+	sg->last = vals[i];
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *f;
+    trace_hdr_t hdr;
+    trace_rec_t rec;
+    bool_t vcd = FALSE;
+    bool_t first = TRUE;
+    trace_kind_t kind;
+    int c;
+
+    while ((c = getopt(argc, argv, "hV")) != -1) {
+	switch(c) {
+	case 'V':
+	    vcd = TRUE;
+	    break;
+	case 'h':
+	default:
+	    usage(argv[0]);
+	}
+    }
+    if (optind != argc - 1)
+	usage(argv[0]);
+
+    f = fopen(argv[optind], "rb");
+    if (!f) {
+	fprintf(stderr, "Can't open trace file '%s'\n", argv[optind]);
+	exit(1);
+    }
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+	memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic)) != 0) {
+	fprintf(stderr, "'%s' is not a trace file\n", argv[optind]);
+	exit(1);
+    }
+    if (hdr.rec_size != sizeof(trace_rec_t) ||
+	(hdr.kind != TRACE_PIPE && hdr.kind != TRACE_SEQ)) {
+	fprintf(stderr, "Trace file '%s' has an unknown format\n", argv[optind]);
+	exit(1);
+    }
+    kind = hdr.kind;
+    hdr.simname[sizeof(hdr.simname)-1] = '\0';
+
+    if (vcd)
+	vcd_header(kind, hdr.simname);
+    else
+	printf("%s\n", hdr.simname);
+    while (fread(&rec, sizeof(rec), 1, f) == 1) {
+	if (vcd)
+	    print_vcd(kind, &rec, first);
+	else
+	    print_text(kind, &rec);
+	first = FALSE;
+    }
+    fclose(f);
+    return 0;
+}
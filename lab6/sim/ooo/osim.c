@@ -0,0 +1,1032 @@
+/**************************************************************************
+ * osim.c - Out-of-order Y86-64 simulator
+ *
+ * A Tomasulo-style core with a reorder buffer.  Each cycle runs, from
+ * the back of the machine to the front:
+ *
+ *   commit    Up to width finished instructions leave the head of the
+ *             reorder buffer (ROB) in program order, writing the
+ *             register file and condition codes.  Stores write memory
+ *             here, one per cycle.  A faulting instruction or halt
+ *             stops the machine when it reaches the head.
+ *   execute   Ready entries in the reservation stations (RS) issue to
+ *             width ALUs, oldest first.  Entries in the load/store
+ *             queue (LSQ) compute their addresses once their base
+ *             register is known, and one load per cycle reads memory
+ *             or takes its value from an older store.  Results go out
+ *             on the common data bus at the end of the cycle and wake
+ *             up the instructions waiting on them.
+ *   dispatch  Up to width instructions from the fetch queue are
+ *             renamed: each source is read from the register file or
+ *             tagged with the ROB entry that will produce it, and the
+ *             instruction takes a ROB entry plus an RS or LSQ entry.
+ *   fetch     Up to width instructions are fetched along the predicted
+ *             path.  Conditional jumps are predicted taken, as in
+ *             PIPE.  Fetch waits for the target of a ret.
+ *
+ * Condition codes are renamed like a register, so jumps and
+ * conditional moves wait only on the instruction that set them.  A
+ * conditional move always writes its destination, with the old value
+ * when the condition fails.  A mispredicted jump is resolved when it
+ * executes: everything younger is squashed, and the rename table is
+ * rebuilt from the instructions left in the ROB.
+ *
+ * Programs are loaded and instructions evaluated with the routines in
+ * isa.c, and -t compares the committed state against its ISA
+ * simulator.
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "isa.h"
+
+#define MAX_WIDTH 8     /* Largest fetch, dispatch, issue and commit width */
+#define MAX_ROB 512     /* Largest reorder buffer */
+#define MAX_RS 256      /* Largest number of reservation stations */
+#define MAX_LSQ 256     /* Largest load/store queue */
+#define LOAD_PORTS 1    /* Loads that can read memory per cycle */
+#define STORE_PORTS 1   /* Stores that can commit per cycle */
+
+/* osim never runs in GUI mode */
+int gui_mode = 0;
+
+/***************
+ * Begin Globals
+ ***************/
+
+/* Parameters modified by the command line */
+int width = 2;              /* Fetch, dispatch, issue, commit width (-w) */
+int rob_size = 32;          /* Reorder buffer entries (-r) */
+int rs_size = 16;           /* Reservation stations (-s) */
+int lsq_size = 16;          /* Load/store queue entries (-q) */
+int verbosity = 2;          /* Verbosity level (-v) */
+word_t instr_limit = 10000; /* Instruction limit (-l) */
+bool_t do_check = FALSE;    /* Test with ISA simulator? (-t) */
+word_t mem_size = MEM_SIZE; /* Memory size in bytes (-m) */
+
+/* Architectural state, written at commit */
+static mem_t mem;
+static mem_t reg;
+static cc_t cc = DEFAULT_CC;
+
+/* Which result of a ROB entry an operand waits for */
+typedef enum { FIELD_E, FIELD_M, FIELD_CC } field_t;
+
+/* A source operand: a value, or the ROB entry that will produce it */
+typedef struct {
+    bool_t ready;
+    word_t val;
+    int tag;
+    field_t field;
+} operand_t;
+
+/* A decoded instruction */
+typedef struct {
+    word_t pc;
+    stat_t stat;
+    byte_t icode, ifun, ra, rb;
+    word_t valc, valp;
+} fetched_t;
+
+/* Reorder buffer entry */
+typedef struct {
+    fetched_t in;
+    word_t seq;             /* Position in program order */
+    byte_t deste, destm;
+    bool_t sets_cc;
+    word_t vale, valm;
+    cc_t cc;
+    bool_t ready_e, ready_m, ready_cc;
+    bool_t is_store;        /* Writes data to addr at commit */
+    word_t addr, data;
+    bool_t done;
+} rob_t;
+
+/* Reservation station entry */
+typedef struct {
+    bool_t busy;
+    int rob;
+    operand_t a, b, c;      /* c is the condition codes */
+} rs_t;
+
+/* Load/store queue entry */
+typedef struct {
+    int rob;
+    bool_t load;
+    bool_t store;
+    operand_t base;         /* Register the address is computed from */
+    operand_t data;         /* Value to store */
+    bool_t addr_ready;
+    word_t addr;
+} lsq_t;
+
+static fetched_t fq[2*MAX_WIDTH];     /* Fetch queue */
+static int fq_head = 0, fq_count = 0;
+static word_t fetch_pc = 0;
+static bool_t fetch_ret_wait = FALSE; /* Waiting for the target of a ret */
+static bool_t fetch_stopped = FALSE;  /* Fetched a halt or a bad instruction */
+
+static rob_t rob[MAX_ROB];
+static int rob_head = 0, rob_count = 0;
+static word_t next_seq = 0;
+
+static rs_t rs[MAX_RS];
+static int rs_count = 0;
+
+static lsq_t lsq[MAX_LSQ];
+static int lsq_head = 0, lsq_count = 0;
+
+/* Rename table: the ROB entry that last writes each register, or -1 */
+static int rat[REG_NONE];
+static field_t rat_field[REG_NONE];
+static int rat_cc = -1;
+
+/* Results to broadcast at the end of the cycle */
+typedef struct {
+    int rob;
+    word_t seq;
+    field_t field;
+    word_t val;
+} result_t;
+static result_t results[2*MAX_WIDTH + 2*MAX_LSQ];
+static int nresults = 0;
+
+/* Performance counters */
+static word_t cycles = 0;
+static word_t instructions = 0;
+static int starting_up = 1;
+static word_t branches = 0, mispredicts = 0, squashed = 0;
+static word_t loads_forwarded = 0;
+
+/* Occupancy of each resource, summed over the cycles */
+typedef enum { RES_FQ, RES_ROB, RES_RS, RES_LSQ, NUM_RES } res_t;
+static char *res_names[NUM_RES] =
+    { "Fetch queue", "Reorder buffer", "Reservation stations",
+      "Load/store queue" };
+static word_t occ_sum[NUM_RES], occ_full[NUM_RES];
+static int occ_peak[NUM_RES], occ_size[NUM_RES];
+static word_t sim_cycles = 0;       /* All cycles, including start-up */
+
+/* Why dispatch took fewer than width instructions */
+typedef enum { DS_EMPTY, DS_ROB, DS_RS, DS_LSQ, NUM_DS } dstall_t;
+static char *dstall_names[NUM_DS] =
+    { "fetch queue empty", "ROB full", "RS full", "LSQ full" };
+static word_t dstall[NUM_DS];
+
+/*************
+ * End Globals
+ *************/
+
+static void trace(const char *format, ...)
+    __attribute__((format(printf, 1, 2)));
+
+static void trace(const char *format, ...)
+{
+    if (verbosity >= 2) {
+	va_list arg;
+	va_start(arg, format);
+	vprintf(format, arg);
+	va_end(arg);
+    }
+}
+
+static int rob_index(int k)
+{
+    return (rob_head + k) % rob_size;
+}
+
+/* Position of ROB entry r, counting from the head */
+static int rob_age(int r)
+{
+    return (r - rob_head + rob_size) % rob_size;
+}
+
+static int lsq_index(int k)
+{
+    return (lsq_head + k) % lsq_size;
+}
+
+static bool_t is_load(byte_t icode)
+{
+    return icode == I_MRMOVQ || icode == I_POPQ || icode == I_RET;
+}
+
+static bool_t is_store(byte_t icode)
+{
+    return icode == I_RMMOVQ || icode == I_PUSHQ || icode == I_CALL;
+}
+
+/*********
+ * Fetch
+ *********/
+
+/* Decode the instruction at pc into in.  Return the predicted next PC */
+static word_t fetch_one(word_t pc, fetched_t *in)
+{
+    byte_t instr = HPACK(I_NOP, F_NONE);
+    byte_t regids = HPACK(REG_NONE, REG_NONE);
+    word_t valp = pc;
+    bool_t imem_error;
+    byte_t junk;
+
+    in->pc = pc;
+    in->valc = 0;
+    imem_error = !get_byte_val(mem, valp, &instr) ||
+	!get_byte_val(mem, valp+5, &junk);
+    in->icode = imem_error ? I_NOP : HI4(instr);
+    in->ifun = imem_error ? F_NONE : LO4(instr);
+    in->stat = imem_error ? STAT_ADR : in->icode > I_IADDQ ? STAT_INS :
+	in->icode == I_HALT ? STAT_HLT : STAT_AOK;
+    valp++;
+    switch (in->icode) {
+    case I_RRMOVQ: case I_ALU: case I_PUSHQ: case I_POPQ:
+    case I_IRMOVQ: case I_RMMOVQ: case I_MRMOVQ: case I_IADDQ:
+	get_byte_val(mem, valp, &regids);
+	valp++;
+	break;
+    default:
+	break;
+    }
+    in->ra = HI4(regids);
+    in->rb = LO4(regids);
+    switch (in->icode) {
+    case I_IRMOVQ: case I_RMMOVQ: case I_MRMOVQ: case I_JMP:
+    case I_CALL: case I_IADDQ:
+	get_word_val(mem, valp, &in->valc);
+	valp += 8;
+	break;
+    default:
+	break;
+    }
+    in->valp = valp;
+    return (in->icode == I_JMP || in->icode == I_CALL) ? in->valc : valp;
+}
+
+static void do_fetch()
+{
+    int n;
+    for (n = 0; n < width && fq_count < 2*width; n++) {
+	fetched_t *in;
+	if (fetch_ret_wait || fetch_stopped)
+	    return;
+	in = &fq[(fq_head + fq_count++) % (2*width)];
+	fetch_pc = fetch_one(fetch_pc, in);
+	trace("\tFetch: 0x%llx: %s\n", in->pc,
+	      in->stat == STAT_ADR ? "(bad address)" :
+	      iname(HPACK(in->icode, in->ifun)));
+	if (in->stat != STAT_AOK)
+	    fetch_stopped = TRUE;
+	if (in->icode == I_RET)
+	    fetch_ret_wait = TRUE;
+	/* A fetch block ends at a change of control */
+	if (in->icode == I_JMP || in->icode == I_CALL || in->icode == I_RET)
+	    return;
+    }
+}
+
+/************
+ * Dispatch
+ ************/
+
+/* Read register r (REG_NONE for none) through the rename table */
+static void read_operand(operand_t *op, byte_t r)
+{
+    int p;
+    op->ready = TRUE;
+    op->val = 0;
+    if (r == REG_NONE)
+	return;
+    p = rat[r];
+    if (p < 0) {
+	op->val = get_reg_val(reg, r);
+    } else if (rat_field[r] == FIELD_E ? rob[p].ready_e : rob[p].ready_m) {
+	op->val = rat_field[r] == FIELD_E ? rob[p].vale : rob[p].valm;
+    } else {
+	op->ready = FALSE;
+	op->tag = p;
+	op->field = rat_field[r];
+    }
+}
+
+static void read_cc(operand_t *op)
+{
+    op->ready = TRUE;
+    op->val = cc;
+    if (rat_cc >= 0) {
+	if (rob[rat_cc].ready_cc) {
+	    op->val = rob[rat_cc].cc;
+	} else {
+	    op->ready = FALSE;
+	    op->tag = rat_cc;
+	    op->field = FIELD_CC;
+	}
+    }
+}
+
+static void rename_dests(int r)
+{
+    rob_t *e = &rob[r];
+    if (e->deste != REG_NONE) {
+	rat[e->deste] = r;
+	rat_field[e->deste] = FIELD_E;
+    }
+    /* For popq %rsp, the loaded value wins */
+    if (e->destm != REG_NONE) {
+	rat[e->destm] = r;
+	rat_field[e->destm] = FIELD_M;
+    }
+    if (e->sets_cc)
+	rat_cc = r;
+}
+
+/* Register fields of an instruction, as d_srcA .. d_dstM in PIPE */
+static byte_t src_a(fetched_t *in)
+{
+    switch (in->icode) {
+    case I_RRMOVQ: case I_RMMOVQ: case I_ALU: case I_PUSHQ:
+	return in->ra;
+    default:
+	return REG_NONE;
+    }
+}
+
+static byte_t src_b(fetched_t *in)
+{
+    switch (in->icode) {
+    case I_ALU: case I_RMMOVQ: case I_MRMOVQ: case I_IADDQ:
+	return in->rb;
+    case I_PUSHQ: case I_POPQ: case I_CALL: case I_RET:
+	return REG_RSP;
+    default:
+	return REG_NONE;
+    }
+}
+
+static byte_t dst_e(fetched_t *in)
+{
+    switch (in->icode) {
+    case I_RRMOVQ: case I_IRMOVQ: case I_ALU: case I_IADDQ:
+	return in->rb;
+    case I_PUSHQ: case I_POPQ: case I_CALL: case I_RET:
+	return REG_RSP;
+    default:
+	return REG_NONE;
+    }
+}
+
+static byte_t dst_m(fetched_t *in)
+{
+    return (in->icode == I_MRMOVQ || in->icode == I_POPQ) ?
+	in->ra : REG_NONE;
+}
+
+/* Take one instruction from the fetch queue.  Return FALSE if it must wait */
+static bool_t dispatch_one(dstall_t *why)
+{
+    fetched_t *in = &fq[fq_head];
+    bool_t mem_op = in->stat == STAT_AOK &&
+	(is_load(in->icode) || is_store(in->icode));
+    bool_t alu_op = in->stat == STAT_AOK &&
+	(in->icode == I_RRMOVQ || in->icode == I_ALU ||
+	 in->icode == I_IADDQ || (in->icode == I_JMP && in->ifun != C_YES));
+    int r;
+    rob_t *e;
+
+    if (rob_count == rob_size) {
+	*why = DS_ROB;
+	return FALSE;
+    }
+    if (alu_op && rs_count == rs_size) {
+	*why = DS_RS;
+	return FALSE;
+    }
+    if (mem_op && lsq_count == lsq_size) {
+	*why = DS_LSQ;
+	return FALSE;
+    }
+
+    r = rob_index(rob_count++);
+    e = &rob[r];
+    memset(e, 0, sizeof(*e));
+    e->in = *in;
+    e->seq = next_seq++;
+    e->deste = in->stat == STAT_AOK ? dst_e(in) : REG_NONE;
+    e->destm = in->stat == STAT_AOK ? dst_m(in) : REG_NONE;
+    e->sets_cc = in->stat == STAT_AOK &&
+	(in->icode == I_ALU || in->icode == I_IADDQ);
+    trace("\tDispatch: 0x%llx: %s -> ROB %d\n", in->pc,
+	  iname(HPACK(in->icode, in->ifun)), r);
+
+    if (alu_op) {
+	rs_t *s = NULL;
+	int i;
+	for (i = 0; i < rs_size; i++)
+	    if (!rs[i].busy) {
+		s = &rs[i];
+		break;
+	    }
+	s->busy = TRUE;
+	s->rob = r;
+	read_operand(&s->a, src_a(in));
+	s->c.ready = TRUE;
+	if (in->icode == I_RRMOVQ && in->ifun != C_YES) {
+	    /* A conditional move also needs the value it may keep */
+	    read_operand(&s->b, in->rb);
+	    read_cc(&s->c);
+	} else {
+	    read_operand(&s->b, src_b(in));
+	    if (in->icode == I_JMP)
+		read_cc(&s->c);
+	}
+	rs_count++;
+    } else if (mem_op) {
+	lsq_t *q = &lsq[lsq_index(lsq_count++)];
+	q->rob = r;
+	q->load = is_load(in->icode);
+	q->store = is_store(in->icode);
+	q->addr_ready = FALSE;
+	read_operand(&q->base, src_b(in));
+	if (in->icode == I_CALL) {
+	    q->data.ready = TRUE;
+	    q->data.val = in->valp;
+	} else {
+	    read_operand(&q->data, src_a(in));
+	}
+	e->is_store = q->store;
+    } else {
+	/* Nothing to execute: nop, halt, jmp, call's jump, irmovq, faults */
+	if (in->icode == I_IRMOVQ && in->stat == STAT_AOK) {
+	    e->vale = in->valc;
+	    e->ready_e = TRUE;
+	}
+	e->done = TRUE;
+    }
+    rename_dests(r);
+    fq_head = (fq_head + 1) % (2*width);
+    fq_count--;
+    return TRUE;
+}
+
+static void do_dispatch()
+{
+    int n;
+    dstall_t why = DS_EMPTY;
+    for (n = 0; n < width; n++) {
+	if (fq_count == 0) {
+	    why = DS_EMPTY;
+	    break;
+	}
+	if (!dispatch_one(&why))
+	    break;
+    }
+    if (n < width)
+	dstall[why]++;
+}
+
+/***********
+ * Execute
+ ***********/
+
+static void broadcast(int r, field_t field, word_t val)
+{
+    result_t *res = &results[nresults++];
+    res->rob = r;
+    res->seq = rob[r].seq;
+    res->field = field;
+    res->val = val;
+}
+
+/* Squash everything younger than ROB entry r and fetch from pc */
+static void squash_after(int r, word_t pc)
+{
+    int keep = rob_age(r) + 1;
+    int i, k;
+
+    squashed += rob_count - keep;
+    rob_count = keep;
+    for (i = 0; i < rs_size; i++)
+	if (rs[i].busy && rob_age(rs[i].rob) >= keep) {
+	    rs[i].busy = FALSE;
+	    rs_count--;
+	}
+    while (lsq_count > 0 &&
+	   rob_age(lsq[lsq_index(lsq_count-1)].rob) >= keep)
+	lsq_count--;
+    squashed += fq_count;
+    fq_count = 0;
+    fetch_pc = pc;
+    fetch_ret_wait = FALSE;
+    fetch_stopped = FALSE;
+
+    /* Rebuild the rename table from the instructions that remain */
+    for (i = 0; i < REG_NONE; i++)
+	rat[i] = -1;
+    rat_cc = -1;
+    for (k = 0; k < rob_count; k++)
+	rename_dests(rob_index(k));
+}
+
+/* Execute one reservation station entry.  Return FALSE if it squashed */
+static bool_t execute_alu(rs_t *s)
+{
+    rob_t *e = &rob[s->rob];
+    fetched_t *in = &e->in;
+
+    switch (in->icode) {
+    case I_RRMOVQ:
+	/* A conditional move that fails keeps the old value */
+	e->vale = cond_holds(s->c.val, in->ifun) ? s->a.val : s->b.val;
+	broadcast(s->rob, FIELD_E, e->vale);
+	break;
+    case I_ALU:
+	e->vale = compute_alu(in->ifun, s->a.val, s->b.val);
+	e->cc = compute_cc(in->ifun, s->a.val, s->b.val);
+	broadcast(s->rob, FIELD_E, e->vale);
+	broadcast(s->rob, FIELD_CC, e->cc);
+	break;
+    case I_IADDQ:
+	e->vale = compute_alu(A_ADD, in->valc, s->b.val);
+	e->cc = compute_cc(A_ADD, in->valc, s->b.val);
+	broadcast(s->rob, FIELD_E, e->vale);
+	broadcast(s->rob, FIELD_CC, e->cc);
+	break;
+    case I_JMP:
+	branches++;
+	e->done = TRUE;
+	trace("\tExecute: jump at 0x%llx %staken\n", in->pc,
+	      cond_holds(s->c.val, in->ifun) ? "" : "not ");
+	if (!cond_holds(s->c.val, in->ifun)) {
+	    mispredicts++;
+	    squash_after(s->rob, in->valp);
+	    return FALSE;
+	}
+	break;
+    default:
+	break;
+    }
+    return TRUE;
+}
+
+/* The oldest ready reservation station, or NULL */
+static rs_t *select_rs()
+{
+    rs_t *best = NULL;
+    int i;
+    for (i = 0; i < rs_size; i++) {
+	rs_t *s = &rs[i];
+	if (s->busy && s->a.ready && s->b.ready && s->c.ready &&
+	    (!best || rob_age(s->rob) < rob_age(best->rob)))
+	    best = s;
+    }
+    return best;
+}
+
+/*
+ * Try to perform load q.  Every older store must know its address; the
+ * youngest one that overlaps must be to the same address, with its
+ * data ready, and then supplies the value.  Return TRUE if done.
+ */
+static bool_t try_load(int k)
+{
+    lsq_t *q = &lsq[lsq_index(k)];
+    rob_t *e = &rob[q->rob];
+    lsq_t *match = NULL;
+    int j;
+
+    for (j = 0; j < k; j++) {
+	lsq_t *o = &lsq[lsq_index(j)];
+	if (!o->store)
+	    continue;
+	if (!o->addr_ready)
+	    return FALSE;
+	if (rob[o->rob].in.stat == STAT_AOK &&
+	    o->addr < q->addr + 8 && q->addr < o->addr + 8)
+	    match = o;
+    }
+    if (match) {
+	if (match->addr != q->addr || !match->data.ready)
+	    return FALSE;
+	e->valm = match->data.val;
+	loads_forwarded++;
+    } else if (!get_word_val(mem, q->addr, &e->valm)) {
+	e->in.stat = STAT_ADR;
+	e->done = TRUE;
+	return TRUE;
+    }
+    trace("\tMemory: Read 0x%llx from 0x%llx\n", e->valm, q->addr);
+    broadcast(q->rob, FIELD_M, e->valm);
+    return TRUE;
+}
+
+/* Generate the address of LSQ entry q */
+static void agu(lsq_t *q)
+{
+    rob_t *e = &rob[q->rob];
+    word_t base = q->base.val;
+    word_t junk;
+
+    switch (e->in.icode) {
+    case I_PUSHQ: case I_CALL:
+	q->addr = e->vale = base - 8;
+	broadcast(q->rob, FIELD_E, e->vale);
+	break;
+    case I_POPQ: case I_RET:
+	q->addr = base;
+	e->vale = base + 8;
+	broadcast(q->rob, FIELD_E, e->vale);
+	break;
+    default:
+	q->addr = base + e->in.valc;
+	break;
+    }
+    q->addr_ready = TRUE;
+    e->addr = q->addr;
+    if (q->store && !get_word_val(mem, q->addr, &junk)) {
+	e->in.stat = STAT_ADR;
+	e->done = TRUE;
+    }
+}
+
+static void do_execute()
+{
+    int n, k, ports = LOAD_PORTS;
+
+    nresults = 0;
+    for (n = 0; n < width; n++) {
+	rs_t *s = select_rs();
+	if (!s)
+	    break;
+	s->busy = FALSE;
+	rs_count--;
+	if (!execute_alu(s))
+	    break;
+    }
+
+    /* Loads whose addresses were generated in an earlier cycle */
+    for (k = 0; k < lsq_count && ports > 0; k++) {
+	lsq_t *q = &lsq[lsq_index(k)];
+	rob_t *e = &rob[q->rob];
+	if (q->load && q->addr_ready && !e->done && !e->ready_m &&
+	    e->in.stat == STAT_AOK) {
+	    if (try_load(k))
+		ports--;
+	}
+    }
+    for (k = 0; k < lsq_count; k++) {
+	lsq_t *q = &lsq[lsq_index(k)];
+	if (!q->addr_ready && q->base.ready)
+	    agu(q);
+    }
+}
+
+/* Put the results of this cycle on the common data bus */
+static void do_writeback()
+{
+    int i, j, k;
+    for (i = 0; i < nresults; i++) {
+	result_t *res = &results[i];
+	int r = res->rob;
+	rob_t *e = &rob[r];
+	/* Results of squashed instructions are dropped */
+	if (rob_age(r) >= rob_count || e->seq != res->seq)
+	    continue;
+	switch (res->field) {
+	case FIELD_E: e->vale = res->val; e->ready_e = TRUE; break;
+	case FIELD_M: e->valm = res->val; e->ready_m = TRUE; break;
+	case FIELD_CC: e->cc = res->val; e->ready_cc = TRUE; break;
+	}
+	for (j = 0; j < rs_size; j++) {
+	    operand_t *ops[3] = { &rs[j].a, &rs[j].b, &rs[j].c };
+	    if (!rs[j].busy)
+		continue;
+	    for (k = 0; k < 3; k++)
+		if (!ops[k]->ready && ops[k]->tag == r &&
+		    ops[k]->field == res->field) {
+		    ops[k]->ready = TRUE;
+		    ops[k]->val = res->val;
+		}
+	}
+	for (j = 0; j < lsq_count; j++) {
+	    lsq_t *q = &lsq[lsq_index(j)];
+	    operand_t *ops[2] = { &q->base, &q->data };
+	    for (k = 0; k < 2; k++)
+		if (!ops[k]->ready && ops[k]->tag == r &&
+		    ops[k]->field == res->field) {
+		    ops[k]->ready = TRUE;
+		    ops[k]->val = res->val;
+		}
+	}
+	/* A ret tells fetch where to go */
+	if (e->in.icode == I_RET && res->field == FIELD_M &&
+	    fetch_ret_wait) {
+	    fetch_pc = res->val;
+	    fetch_ret_wait = FALSE;
+	}
+    }
+
+    /* Mark finished instructions */
+    for (k = 0; k < rob_count; k++) {
+	rob_t *e = &rob[rob_index(k)];
+	if (e->done)
+	    continue;
+	switch (e->in.icode) {
+	case I_RRMOVQ: case I_ALU: case I_IADDQ:
+	    e->done = e->ready_e;
+	    break;
+	case I_MRMOVQ: case I_POPQ: case I_RET:
+	    e->done = e->ready_m;
+	    break;
+	default:
+	    break;
+	}
+    }
+    for (k = 0; k < lsq_count; k++) {
+	lsq_t *q = &lsq[lsq_index(k)];
+	rob_t *e = &rob[q->rob];
+	if (q->store && !e->done && q->addr_ready && q->data.ready) {
+	    e->data = q->data.val;
+	    e->done = TRUE;
+	}
+    }
+}
+
+/**********
+ * Commit
+ **********/
+
+/* Commit finished instructions.  Return the status of the processor */
+static stat_t do_commit(word_t *completed)
+{
+    int n, stores = STORE_PORTS;
+    *completed = 0;
+    for (n = 0; n < width && rob_count > 0; n++) {
+	rob_t *e = &rob[rob_head];
+	if (!e->done || instructions + *completed >= instr_limit)
+	    break;
+	if (e->is_store && e->in.stat == STAT_AOK && stores == 0)
+	    break;
+	(*completed)++;
+	trace("\tCommit: 0x%llx: %s\n", e->in.pc,
+	      iname(HPACK(e->in.icode, e->in.ifun)));
+	if (e->in.stat != STAT_AOK)
+	    return e->in.stat;
+	if (e->deste != REG_NONE)
+	    set_reg_val(reg, e->deste, e->vale);
+	if (e->destm != REG_NONE)
+	    set_reg_val(reg, e->destm, e->valm);
+	if (e->sets_cc)
+	    cc = e->cc;
+	if (e->is_store) {
+	    set_word_val(mem, e->addr, e->data);
+	    trace("\tWrote 0x%llx to address 0x%llx\n", e->data, e->addr);
+	    stores--;
+	}
+
+	/* The entry no longer renames anything */
+	if (e->deste != REG_NONE && rat[e->deste] == rob_head)
+	    rat[e->deste] = -1;
+	if (e->destm != REG_NONE && rat[e->destm] == rob_head)
+	    rat[e->destm] = -1;
+	if (rat_cc == rob_head)
+	    rat_cc = -1;
+	if (lsq_count > 0 && lsq[lsq_head].rob == rob_head) {
+	    lsq_head = (lsq_head + 1) % lsq_size;
+	    lsq_count--;
+	}
+	rob_head = (rob_head + 1) % rob_size;
+	rob_count--;
+    }
+    return STAT_AOK;
+}
+
+/*****************
+ * Cycle control
+ *****************/
+
+static void note_occupancy(res_t r, int count, int size)
+{
+    occ_size[r] = size;
+    occ_sum[r] += count;
+    if (count > occ_peak[r])
+	occ_peak[r] = count;
+    if (count == size)
+	occ_full[r]++;
+}
+
+/* Simulate one cycle.  Return the status of the processor */
+static stat_t step_cycle(word_t ccount)
+{
+    word_t completed;
+    stat_t status;
+
+    trace("\nCycle %lld. CC=%s, ROB %d, RS %d, LSQ %d\n", ccount,
+	  cc_name(cc), rob_count, rs_count, lsq_count);
+    note_occupancy(RES_FQ, fq_count, 2*width);
+    note_occupancy(RES_ROB, rob_count, rob_size);
+    note_occupancy(RES_RS, rs_count, rs_size);
+    note_occupancy(RES_LSQ, lsq_count, lsq_size);
+    sim_cycles++;
+
+    status = do_commit(&completed);
+    if (status == STAT_AOK) {
+	do_execute();
+	do_writeback();
+	do_dispatch();
+	do_fetch();
+    }
+
+    /* Cycles are counted from the first commit, as in psim */
+    if (completed > 0) {
+	starting_up = 0;
+	instructions += completed;
+	cycles++;
+    } else if (!starting_up)
+	cycles++;
+    return status;
+}
+
+static stat_t run_ooo()
+{
+    word_t ccount = 0;
+    stat_t status = STAT_AOK;
+    int i;
+
+    for (i = 0; i < REG_NONE; i++)
+	rat[i] = -1;
+    while (instructions < instr_limit && ccount < 5*instr_limit) {
+	status = step_cycle(ccount++);
+	if (status != STAT_AOK)
+	    break;
+    }
+    return status;
+}
+
+static void usage(char *name)
+{
+    printf("Usage: %s [-ht] [-w n] [-r n] [-s n] [-q n] [-l m] [-v n] [-m s] file.yo\n", name);
+    printf("   -h     Print this message\n");
+    printf("   -w n   Fetch, dispatch, issue and commit up to n instructions per cycle,\n");
+    printf("          1 <= n <= %d (default %d)\n", MAX_WIDTH, width);
+    printf("   -r n   Use a reorder buffer of n entries, n <= %d (default %d)\n", MAX_ROB, rob_size);
+    printf("   -s n   Use n reservation stations, n <= %d (default %d)\n", MAX_RS, rs_size);
+    printf("   -q n   Use a load/store queue of n entries, n <= %d (default %d)\n", MAX_LSQ, lsq_size);
+    printf("   -l m   Set instruction limit to m (default %lld)\n", instr_limit);
+    printf("   -v n   Set verbosity level to 0 <= n <= 2 (default %d)\n", verbosity);
+    printf("   -t     Test result against ISA simulator\n");
+    printf("   -m s   Set memory size to s bytes, with optional K/M/G suffix (default %d)\n", MEM_SIZE);
+    exit(0);
+}
+
+/* Parse a size option between 1 and max */
+static int parse_size(char *arg, int max, char *what, char *name)
+{
+    int n = atoi(arg);
+    if (n < 1 || n > max) {
+	printf("Invalid %s %s\n", what, arg);
+	usage(name);
+    }
+    return n;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *object_file;
+    mem_t mem0, reg0;
+    state_ptr isa_state = NULL;
+    stat_t run_status;
+    int c, i;
+
+    while ((c = getopt(argc, argv, "htw:r:s:q:l:v:m:")) != -1) {
+	switch(c) {
+	case 'h':
+	    usage(argv[0]);
+	    break;
+	case 'w':
+	    width = parse_size(optarg, MAX_WIDTH, "width", argv[0]);
+	    break;
+	case 'r':
+	    rob_size = parse_size(optarg, MAX_ROB, "ROB size", argv[0]);
+	    break;
+	case 's':
+	    rs_size = parse_size(optarg, MAX_RS, "number of reservation stations",
+				 argv[0]);
+	    break;
+	case 'q':
+	    lsq_size = parse_size(optarg, MAX_LSQ, "LSQ size", argv[0]);
+	    break;
+	case 'l':
+	    instr_limit = atoll(optarg);
+	    break;
+	case 'v':
+	    verbosity = atoi(optarg);
+	    if (verbosity < 0 || verbosity > 2) {
+		printf("Invalid verbosity %d\n", verbosity);
+		usage(argv[0]);
+	    }
+	    break;
+	case 't':
+	    do_check = TRUE;
+	    break;
+	case 'm':
+	    mem_size = parse_mem_size(optarg);
+	    if (mem_size <= 0) {
+		printf("Invalid memory size '%s'\n", optarg);
+		usage(argv[0]);
+	    }
+	    break;
+	default:
+	    printf("Invalid option '%c'\n", c);
+	    usage(argv[0]);
+	    break;
+	}
+    }
+    if (optind < argc - 1)
+	usage(argv[0]);
+    object_file = stdin;
+    if (optind < argc && (object_file = fopen(argv[optind], "r")) == NULL) {
+	fprintf(stderr, "Couldn't open object file %s\n", argv[optind]);
+	exit(1);
+    }
+
+    mem = init_mem(mem_size);
+    reg = init_reg();
+    if (verbosity >= 2)
+	printf("Y86-64 Processor: out-of-order, width %d, ROB %d, RS %d, LSQ %d\n",
+	       width, rob_size, rs_size, lsq_size);
+    if (load_mem(mem, object_file, 1) == 0) {
+	fprintf(stderr, "No lines of code found\n");
+	exit(1);
+    }
+    fclose(object_file);
+    if (do_check) {
+	isa_state = new_state(0);
+	free_mem(isa_state->r);
+	free_mem(isa_state->m);
+	isa_state->m = copy_mem(mem);
+	isa_state->r = copy_mem(reg);
+	isa_state->cc = cc;
+    }
+    mem0 = copy_mem(mem);
+    reg0 = copy_mem(reg);
+
+    run_status = run_ooo();
+    if (verbosity > 0) {
+	printf("%lld instructions executed\n", instructions);
+	printf("Status = %s\n", stat_name(run_status));
+	printf("Condition Codes: %s\n", cc_name(cc));
+	printf("Changed Register State:\n");
+	diff_reg(reg0, reg, stdout);
+	printf("Changed Memory State:\n");
+	diff_mem(mem0, mem, stdout);
+    }
+    if (do_check) {
+	stat_t e = STAT_AOK;
+	word_t step;
+	bool_t match = TRUE;
+
+	for (step = 0; step < instr_limit && e == STAT_AOK; step++)
+	    e = step_state(isa_state, stdout);
+	if (diff_reg(isa_state->r, reg, NULL)) {
+	    match = FALSE;
+	    if (verbosity > 0) {
+		printf("ISA Register != Pipeline Register File\n");
+		diff_reg(isa_state->r, reg, stdout);
+	    }
+	}
+	if (diff_mem(isa_state->m, mem, NULL)) {
+	    match = FALSE;
+	    if (verbosity > 0) {
+		printf("ISA Memory != Pipeline Memory\n");
+		diff_mem(isa_state->m, mem, stdout);
+	    }
+	}
+	if (isa_state->cc != cc) {
+	    match = FALSE;
+	    if (verbosity > 0)
+		printf("ISA Cond. Codes (%s) != Pipeline Cond. Codes (%s)\n",
+		       cc_name(isa_state->cc), cc_name(cc));
+	}
+	printf(match ? "ISA Check Succeeds\n" : "ISA Check Fails\n");
+    }
+
+    printf("CPI: %lld cycles/%lld instructions = %.2f\n", cycles, instructions,
+	   instructions > 0 ? (double) cycles/instructions : 1.0);
+    printf("IPC: %.2f\n", cycles > 0 ? (double) instructions/cycles : 0.0);
+    printf("Conditional jumps: %lld, mispredicted %lld, instructions squashed %lld\n",
+	   branches, mispredicts, squashed);
+    printf("Loads forwarded from stores: %lld\n", loads_forwarded);
+    printf("Occupancy:              %8s %8s %8s %10s\n",
+	   "Size", "Average", "Peak", "Full");
+    for (i = 0; i < NUM_RES; i++)
+	printf("  %-21s %8d %8.2f %8d %9.1f%%\n", res_names[i], occ_size[i],
+	       sim_cycles ? (double) occ_sum[i]/sim_cycles : 0.0, occ_peak[i],
+	       sim_cycles ? 100.0*occ_full[i]/sim_cycles : 0.0);
+    printf("Dispatch stalls:\n");
+    for (i = 0; i < NUM_DS; i++)
+	printf("  %-21s %8lld\n", dstall_names[i], dstall[i]);
+    return 0;
+}
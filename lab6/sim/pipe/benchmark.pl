@@ -13,7 +13,6 @@ use Getopt::Std;
 $blocklen = 64;
 $yas = "../misc/yas";
 $pipe = "./psim";
-$gendriver = "./gen-driver.pl";
 $fname = "bdriver";
 $verbose = 1;
 
@@ -69,19 +68,21 @@ if ($verbose) {
     print "\t$ncopy\n";
 }
 
+# Assemble ncopy by itself and let psim build the driver for every
+# block size in memory, simulating them all in one run (--sweep)
+!(system "cp $ncopy.ys $fname.ys") ||
+    die "Couldn't copy $ncopy.ys to $fname.ys\n";
+!(system "$yas $fname.ys") ||
+    die "Couldn't assemble file $fname.ys\n";
+@stats = grep(/^\d+\t/, `$pipe --sweep $fname.yo`);
+($? == 0 && @stats >= $blocklen + 1) ||
+    die "Couldn't simulate file $fname.yo\n";
+!(system "rm $fname.ys $fname.yo") ||
+    die "Couldn't remove files $fname.ys and/or $fname.yo\n";
+
 $tcpe = 0;
 for ($i = 0; $i <= $blocklen; $i++) {
-    !(system "$gendriver -n $i -f $ncopy.ys > $fname$i.ys") ||
-	die "Couldn't generate driver file $fname$i.ys\n";
-    !(system "$yas $fname$i.ys") ||
-	die "Couldn't assemble file $fname$i.ys\n";
-    $stat = `$pipe -v 0 $fname$i.yo` ||
-	die "Couldn't simulate file $fname$i.yo\n";
-    !(system "rm $fname$i.ys $fname$i.yo") ||
-	die "Couldn't remove files $fname$i.ys and/or $fname$i.yo\n";
-    chomp $stat;
-    $stat =~ s/[ ]*CPI:[ ]*//;
-    $stat =~ s/ cycles.*//;
+    ($len, $stat) = split(/\t/, $stats[$i]);
     if ($i > 0) {
       $cpe = $stat/$i;
       if ($verbose) {
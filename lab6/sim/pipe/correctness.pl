@@ -14,7 +14,6 @@ $over = 3;
 $yas = "../misc/yas";
 $yis = "../misc/yis";
 $pipe = "./psim";
-$gendriver = "./gen-driver.pl";
 $fname = "cdriver";
 $verbose = 1;
 # Maximum allowable code length
@@ -78,6 +77,24 @@ if ($verbose) {
     print "\t$ncopy\n";
 }
 
+# Assemble ncopy by itself.  The simulators build the driver for each
+# length in memory (-d) and check the result
+!(system "cp $ncopy.ys $fname.ys") ||
+    die "Couldn't copy $ncopy.ys to $fname.ys\n";
+!(system "$yas $fname.ys") ||
+    die "Couldn't assemble file $fname.ys\n";
+
+# Code length, as one past the highest address given code
+$codelen = 0;
+open(YO, "$fname.yo") || die "Couldn't open $fname.yo\n";
+while (<YO>) {
+    if (/^\s*0x([0-9a-fA-F]+):\s*([0-9a-fA-F]*)/) {
+	$end = hex($1) + length($2)/2;
+	$codelen = $end if ($end > $codelen);
+    }
+}
+close(YO);
+
 $goodcnt = 0;
 
 for ($i = 0; $i <= $blocklen+$over; $i++) {
@@ -86,52 +103,35 @@ for ($i = 0; $i <= $blocklen+$over; $i++) {
 	# Try some larger values
 	$len = $blocklen * ($i - $blocklen + 1);
     }
-    !(system "$gendriver -rc -n $len -f $ncopy.ys -b $bytelim > $fname$len.ys") ||
-	die "Couldn't generate driver file $fname$len.ys\n";
-    !(system "$yas $fname$len.ys") ||
-	die "Couldn't assemble file $fname$len.ys\n";
+    if ($codelen > $bytelim) {
+	printf "%d\t%s\n", $len, "Program too long";
+	last;
+    }
+    $seed = int(rand(1 << 30));
     if ($usepipe) {
-	!(system "$pipe -v 1 $fname$len.yo > $fname$len.pipe") ||
-	    die "Couldn't simulate file $fname$len.yo with pipeline simulator\n";
-	$stat = `grep "rax:" $fname$len.pipe`;
-	!(system "rm $fname$len.ys $fname$len.yo $fname$len.pipe") ||
-	    die "Couldn't remove files $fname$len.ys and/or $fname$len.yo and/or $fname$len.pipe\n";
-	chomp $stat;
+	$stat = `$pipe -v 0 -d $len:$seed $fname.yo`;
+	$? == 0 ||
+	    die "Couldn't simulate file $fname.yo with pipeline simulator\n";
     } else {
-	!(system "$yis $fname$len.yo > $fname$len.yis") ||
-	    die "Couldn't simulate file $fname$len.yo with instruction set simulator\n";
-	$stat = `grep rax $fname$len.yis`;
-	!(system "rm $fname$len.ys $fname$len.yo $fname$len.yis") ||
-	    die "Couldn't remove files $fname$len.ys and/or $fname$len.yo and/or $fname$len.yis\n";
-	chomp $stat;
+	$stat = `$yis -d $len:$seed $fname.yo`;
+	$? == 0 ||
+	    die "Couldn't simulate file $fname.yo with instruction set simulator\n";
     }
     $result = "failed";
-    if ($stat =~ "zzzz") {
-	$result = "Couldn't run checking code";
+    if ($stat =~ /Driver check: (.*)/) {
+	$result = $1;
     }
-    if ($stat =~ "aaaa") {
-	$result = "OK";
+    if ($result eq "OK") {
 	$goodcnt ++;
     }
-    if ($stat =~ "bbbb") {
-	$result = "Bad count";
-    }
-    if ($stat =~ "cccc") {
-	$result = "Program too long";
-	printf "%d\t%s\n", $len, $result;
-	last;
-    }
-    if ($stat =~ "dddd") {
-	$result = "Incorrect copying";
-    }
-    if ($stat =~ "eeee") {
-	$result = "Corruption before or after destination";
-    }
     if ($verbose) {
 	printf "%d\t%s\n", $len, $result;
     }
 }
 
+!(system "rm $fname.ys $fname.yo") ||
+    die "Couldn't remove files $fname.ys and/or $fname.yo\n";
+
 $bp1 = $blocklen+$over+1;
 printf "$goodcnt/$bp1 pass correctness test\n";
 
@@ -18,7 +18,7 @@
  ******************************************************************************/
 
 /* Different control operations for pipeline register */
-/* LOAD:   Copy next state to current   */
+/* LOAD:   Next state becomes current   */
 /* STALL:  Keep current state unchanged */
 /* BUBBLE: Set current state to nop     */
 /* ERROR:  Occurs when both stall & load signals set */
@@ -41,15 +41,18 @@ typedef struct {
  *	function declarations
  ******************************************************************************/
 
-/* Create new pipe with count bytes of state */
+/* Set up pipe p with count bytes of state */
 /* bubble_val indicates state corresponding to pipeline bubble */
-pipe_ptr new_pipe(int count, void *bubble_val);
+void init_pipe(pipe_ptr p, int count, void *bubble_val);
 
-/* Update all pipes */
-void update_pipes();
+/* Free the state of pipe p */
+void free_pipe(pipe_ptr p);
 
-/* Set all pipes to bubble values */
-void clear_pipes();
+/* Update the n pipes in array pipes */
+void update_pipes(pipe_ptr pipes, int n);
+
+/* Set the n pipes in array pipes to bubble values */
+void clear_pipes(pipe_ptr pipes, int n);
 
 /* Utility code */
 
@@ -0,0 +1,654 @@
+/**************************************************************************
+ * psim-gui.c - Tcl/Tk interface of the pipelined Y86-64 simulator
+ *
+ * Copyright (c) 2010, 2015. Bryant and D. O'Hallaron, All rights reserved.
+ * May not be used, modified, or copied without permission.
+ **************************************************************************/
+
+/*
+ * The GUI runs one simulation context of the core (sim.c), and follows
+ * it through the show_cycle and show_store hooks of the context.  This
+ * file is only compiled into a simulator built with HAS_GUI.
+ */
+
+#ifdef HAS_GUI
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tk.h>
+
+#include "isa.h"
+#include "pipeline.h"
+#include "stages.h"
+#include "sim.h"
+
+/* Simulator name defined and initialized by the compiled HCL file */
+extern char simname[];
+
+/**********************
+ * Begin globals
+ **********************/
+
+/* Hack for SunOS */
+// extern int matherr();
+// int *tclDummyMathPtr = (int *) matherr;
+
+static char tcl_msg[256];
+
+/* Keep track of the TCL Interpreter */
+static Tcl_Interp *sim_interp = NULL;
+
+static mem_t post_load_mem;
+
+/* The context being displayed, and what every new one is created with */
+static sim_ctx_ptr gui_ctx = NULL;
+static sim_opts_rec gui_opts;
+static word_t gui_mem_size;
+
+/* Keep track of range of addresses that have been written */
+static word_t minAddr = 0;
+static word_t memCnt = 0;
+
+/* Simulator operating mode */
+static sim_mode_t sim_mode = S_FORWARD;
+
+/**********************
+ * End globals
+ **********************/
+
+
+/******************************************************************************
+ *	function declarations
+ ******************************************************************************/
+
+int simResetCmd(ClientData clientData, Tcl_Interp *interp,
+		int argc, char *argv[]);
+
+int simLoadCodeCmd(ClientData clientData, Tcl_Interp *interp,
+		   int argc, char *argv[]);
+
+int simLoadDataCmd(ClientData clientData, Tcl_Interp *interp,
+		   int argc, char *argv[]);
+
+int simRunCmd(ClientData clientData, Tcl_Interp *interp,
+	      int argc, char *argv[]);
+
+int simModeCmd(ClientData clientData, Tcl_Interp *interp,
+	       int argc, char *argv[]);
+
+void addAppCommands(Tcl_Interp *interp);
+
+static void gui_reset(mem_t m);
+static void signal_register_clear();
+static void create_memory_display();
+
+
+/*****************************************************************************
+ * reporting code
+ *****************************************************************************/
+
+/* used for formatting instructions */
+static char status_msg[128];
+
+static char *format_pc(pc_ptr state)
+{
+    char pstring[17];
+    wstring(state->pc, 4, 64, pstring);
+    sprintf(status_msg, "%s %s", stat_name(state->status), pstring);
+    return status_msg;
+}
+
+static char *format_if_id(if_id_ptr state)
+{
+    char valcstring[17];
+    char valpstring[17];
+    wstring(state->valc, 4, 64, valcstring);
+    wstring(state->valp, 4, 64, valpstring);
+    sprintf(status_msg, "%s %s %s %s %s %s",
+	    stat_name(state->status),
+	    iname(HPACK(state->icode,state->ifun)),
+	    reg_name(state->ra),
+	    reg_name(state->rb),
+	    valcstring,
+	    valpstring);
+    return status_msg;
+}
+
+static char *format_id_ex(id_ex_ptr state)
+{
+    char valcstring[17];
+    char valastring[17];
+    char valbstring[17];
+    wstring(state->valc, 4, 64, valcstring);
+    wstring(state->vala, 4, 64, valastring);
+    wstring(state->valb, 4, 64, valbstring);
+    sprintf(status_msg, "%s %s %s %s %s %s %s %s %s",
+	    stat_name(state->status),
+	    iname(HPACK(state->icode, state->ifun)),
+	    valcstring,
+	    valastring,
+	    valbstring,
+	    reg_name(state->deste),
+	    reg_name(state->destm),
+	    reg_name(state->srca),
+	    reg_name(state->srcb));
+    return status_msg;
+}
+
+static char *format_ex_mem(ex_mem_ptr state)
+{
+    char valestring[17];
+    char valastring[17];
+    wstring(state->vale, 4, 64, valestring);
+    wstring(state->vala, 4, 64, valastring);
+    sprintf(status_msg, "%s %s %c %s %s %s %s",
+	    stat_name(state->status),
+	    iname(HPACK(state->icode, state->ifun)),
+	    state->takebranch ? 'Y' : 'N',
+	    valestring,
+	    valastring,
+	    reg_name(state->deste),
+	    reg_name(state->destm));
+
+    return status_msg;
+}
+
+static char *format_mem_wb(mem_wb_ptr state)
+{
+    char valestring[17];
+    char valmstring[17];
+    wstring(state->vale, 4, 64, valestring);
+    wstring(state->valm, 4, 64, valmstring);
+    sprintf(status_msg, "%s %s %s %s %s %s",
+	    stat_name(state->status),
+	    iname(HPACK(state->icode, state->ifun)),
+	    valestring,
+	    valmstring,
+	    reg_name(state->deste),
+	    reg_name(state->destm));
+
+    return status_msg;
+}
+
+
+/******************************************************************************
+ *	tcl command definitions
+ ******************************************************************************/
+
+/* Implement command versions of the simulation functions */
+int simResetCmd(ClientData clientData, Tcl_Interp *interp,
+		int argc, char *argv[])
+{
+    sim_interp = interp;
+    if (argc != 1) {
+	interp->result = "No arguments allowed";
+	return TCL_ERROR;
+    }
+    gui_reset(post_load_mem ? copy_mem(post_load_mem)
+	      : init_mem(gui_mem_size));
+    interp->result = stat_name(STAT_AOK);
+    return TCL_OK;
+}
+
+int simLoadCodeCmd(ClientData clientData, Tcl_Interp *interp,
+		   int argc, char *argv[])
+{
+    FILE *code_file;
+    word_t code_count;
+    sim_interp = interp;
+    if (argc != 2) {
+	interp->result = "One argument required";
+	return TCL_ERROR;
+    }
+    code_file = fopen(argv[1], "r");
+    if (!code_file) {
+	sprintf(tcl_msg, "Couldn't open code file '%s'", argv[1]);
+	interp->result = tcl_msg;
+	return TCL_ERROR;
+    }
+    gui_reset(init_mem(gui_mem_size));
+    code_count = load_mem(gui_ctx->mem, code_file, 0);
+    if (post_load_mem)
+	free_mem(post_load_mem);
+    post_load_mem = copy_mem(gui_ctx->mem);
+    sprintf(tcl_msg, "%lld", code_count);
+    interp->result = tcl_msg;
+    fclose(code_file);
+    return TCL_OK;
+}
+
+int simLoadDataCmd(ClientData clientData, Tcl_Interp *interp,
+		   int argc, char *argv[])
+{
+    FILE *data_file;
+    word_t word_count = 0;
+    interp->result = "Not implemented";
+    return TCL_ERROR;
+
+
+    sim_interp = interp;
+    if (argc != 2) {
+	interp->result = "One argument required";
+	return TCL_ERROR;
+    }
+    data_file = fopen(argv[1], "r");
+    if (!data_file) {
+	sprintf(tcl_msg, "Couldn't open data file '%s'", argv[1]);
+	interp->result = tcl_msg;
+	return TCL_ERROR;
+    }
+    sprintf(tcl_msg, "%lld", word_count);
+    interp->result = tcl_msg;
+    fclose(data_file);
+    return TCL_OK;
+}
+
+
+int simRunCmd(ClientData clientData, Tcl_Interp *interp,
+	      int argc, char *argv[])
+{
+    word_t cycle_limit = 1;
+    sim_ctx_ptr c = gui_ctx;
+    sim_interp = interp;
+    if (argc > 2) {
+	interp->result = "At most one argument allowed";
+	return TCL_ERROR;
+    }
+    if (argc >= 2 &&
+	(sscanf(argv[1], "%lld", &cycle_limit) != 1 ||
+	 cycle_limit < 0)) {
+	sprintf(tcl_msg, "Cannot run for '%s' cycles!", argv[1]);
+	interp->result = tcl_msg;
+	return TCL_ERROR;
+    }
+    if (!c)
+	gui_reset(init_mem(gui_mem_size));
+    c = gui_ctx;
+    sim_ctx_run(c, c->icount + cycle_limit + 5, c->ccount + cycle_limit);
+    interp->result = stat_name(c->run_status);
+    return TCL_OK;
+}
+
+int simModeCmd(ClientData clientData, Tcl_Interp *interp,
+	       int argc, char *argv[])
+{
+    sim_interp = interp;
+    if (argc != 2) {
+	interp->result = "One argument required";
+	return TCL_ERROR;
+    }
+    interp->result = argv[1];
+    if (strcmp(argv[1], "wedged") == 0)
+	sim_mode = S_WEDGED;
+    else if (strcmp(argv[1], "stall") == 0)
+	sim_mode = S_STALL;
+    else if (strcmp(argv[1], "forward") == 0)
+	sim_mode = S_FORWARD;
+    else {
+	sprintf(tcl_msg, "Unknown mode '%s'", argv[1]);
+	interp->result = tcl_msg;
+	return TCL_ERROR;
+    }
+    return TCL_OK;
+}
+
+
+/******************************************************************************
+ *	registering the commands with tcl
+ ******************************************************************************/
+
+void addAppCommands(Tcl_Interp *interp)
+{
+    sim_interp = interp;
+    Tcl_CreateCommand(interp, "simReset", (Tcl_CmdProc *) simResetCmd,
+		      (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
+    Tcl_CreateCommand(interp, "simCode", (Tcl_CmdProc *) simLoadCodeCmd,
+		      (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
+    Tcl_CreateCommand(interp, "simData", (Tcl_CmdProc *) simLoadDataCmd,
+		      (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
+    Tcl_CreateCommand(interp, "simRun", (Tcl_CmdProc *) simRunCmd,
+		      (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
+    Tcl_CreateCommand(interp, "setSimMode", (Tcl_CmdProc *) simModeCmd,
+		      (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
+}
+
+/******************************************************************************
+ *	tcl functionality called from within C
+ ******************************************************************************/
+
+/* Provide mechanism for simulator to update register display */
+void signal_register_update(reg_id_t r, word_t val) {
+    int code;
+    sprintf(tcl_msg, "setReg %d %lld 1", (int) r, (word_t) val);
+    code = Tcl_Eval(sim_interp, tcl_msg);
+    if (code != TCL_OK) {
+	fprintf(stderr, "Failed to signal register set\n");
+	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+    }
+}
+
+/* Provide mechanism for simulator to generate memory display */
+static void create_memory_display() {
+    int code;
+    sprintf(tcl_msg, "createMem %lld %lld", minAddr, memCnt);
+    code = Tcl_Eval(sim_interp, tcl_msg);
+    if (code != TCL_OK) {
+	fprintf(stderr, "Command '%s' failed\n", tcl_msg);
+	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+    } else {
+	word_t i;
+	for (i = 0; i < memCnt && code == TCL_OK; i+=8) {
+	    word_t addr = minAddr+i;
+	    word_t val;
+	    if (!get_word_val(gui_ctx->mem, addr, &val)) {
+		fprintf(stderr, "Out of bounds memory display\n");
+		return;
+	    }
+	    sprintf(tcl_msg, "setMem %lld %lld", addr, val);
+	    code = Tcl_Eval(sim_interp, tcl_msg);
+	}
+	if (code != TCL_OK) {
+	    fprintf(stderr, "Couldn't set memory value\n");
+	    fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+	}
+    }
+}
+
+/* Provide mechanism for simulator to update memory value */
+static void set_memory(word_t addr, word_t val) {
+    int code;
+    word_t nminAddr = minAddr;
+    word_t nmemCnt = memCnt;
+
+    /* First see if we need to expand memory range */
+    if (memCnt == 0) {
+	nminAddr = addr;
+	nmemCnt = 8;
+    } else if (addr < minAddr) {
+	nminAddr = addr;
+	nmemCnt = minAddr + memCnt - addr;
+    } else if (addr >= minAddr+memCnt) {
+	nmemCnt = addr-minAddr+8;
+    }
+    /* Now make sure nminAddr & nmemCnt are multiples of 16 */
+    nmemCnt = ((nminAddr & 0xF) + nmemCnt + 0xF) & ~0xF;
+    nminAddr = nminAddr & ~0xF;
+
+    if (nminAddr != minAddr || nmemCnt != memCnt) {
+	minAddr = nminAddr;
+	memCnt = nmemCnt;
+	create_memory_display();
+    } else {
+	sprintf(tcl_msg, "setMem %lld %lld", addr, val);
+	code = Tcl_Eval(sim_interp, tcl_msg);
+	if (code != TCL_OK) {
+	    fprintf(stderr, "Couldn't set memory value 0x%llx to 0x%llx\n",
+		    addr, val);
+	    fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+	}
+    }
+}
+
+/* Provide mechanism for simulator to update condition code display */
+static void show_cc(cc_t cc)
+{
+    int code;
+    sprintf(tcl_msg, "setCC %d %d %d",
+	    GET_ZF(cc), GET_SF(cc), GET_OF(cc));
+    code = Tcl_Eval(sim_interp, tcl_msg);
+    if (code != TCL_OK) {
+	fprintf(stderr, "Failed to display condition codes\n");
+	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+    }
+}
+
+/* Provide mechanism for simulator to update status display */
+static void show_stat(stat_t stat)
+{
+    int code;
+    sprintf(tcl_msg, "showStat %s", stat_name(stat));
+    code = Tcl_Eval(sim_interp, tcl_msg);
+    if (code != TCL_OK) {
+	fprintf(stderr, "Failed to display status\n");
+	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+    }
+}
+
+
+
+/* Provide mechanism for simulator to update performance information */
+static void show_cpi(sim_ctx_ptr c) {
+    int code;
+    double cpi = c->instructions > 0 ?
+	(double) c->cycles/c->instructions : 1.0;
+    sprintf(tcl_msg, "showCPI %lld %lld %.2f",
+	    c->cycles, c->instructions, (double) cpi);
+    code = Tcl_Eval(sim_interp, tcl_msg);
+    if (code != TCL_OK) {
+	fprintf(stderr, "Failed to display CPI\n");
+	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+    }
+}
+
+static char *rname[] = {"none", "ea", "eb", "me", "wm", "we"};
+
+/* provide mechanism for simulator to specify source registers */
+void signal_sources(sim_ctx_ptr c) {
+    int code;
+    sprintf(tcl_msg, "showSources %s %s",
+	    rname[c->amux], rname[c->bmux]);
+    code = Tcl_Eval(sim_interp, tcl_msg);
+    if (code != TCL_OK) {
+	fprintf(stderr, "Failed to signal forwarding sources\n");
+	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+    }
+}
+
+/* Provide mechanism for simulator to clear register display */
+static void signal_register_clear() {
+    int code;
+    code = Tcl_Eval(sim_interp, "clearReg");
+    if (code != TCL_OK) {
+	fprintf(stderr, "Failed to signal register clear\n");
+	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+    }
+}
+
+/* Provide mechanism for simulator to report instructions as they are
+   read in
+*/
+
+void report_line(word_t line_no, word_t addr, char *hex, char *text) {
+    int code;
+    sprintf(tcl_msg, "addCodeLine %lld %lld {%s} {%s}", line_no, addr, hex, text);
+    code = Tcl_Eval(sim_interp, tcl_msg);
+    if (code != TCL_OK) {
+	fprintf(stderr, "Failed to report code line 0x%llx\n", addr);
+	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+    }
+}
+
+
+/* Provide mechanism for simulator to report which instructions are in
+   which stages */
+static void report_pc(unsigned fpc, unsigned char fpcv,
+		      unsigned dpc, unsigned char dpcv,
+		      unsigned epc, unsigned char epcv,
+		      unsigned mpc, unsigned char mpcv,
+		      unsigned wpc, unsigned char wpcv)
+{
+    int status;
+    char addr[10];
+    char code[12];
+    Tcl_DString cmd;
+    Tcl_DStringInit(&cmd);
+    Tcl_DStringAppend(&cmd, "simLabel ", -1);
+    Tcl_DStringStartSublist(&cmd);
+    if (fpcv) {
+	sprintf(addr, "%u", fpc);
+	Tcl_DStringAppendElement(&cmd, addr);
+    }
+    if (dpcv) {
+	sprintf(addr, "%u", dpc);
+	Tcl_DStringAppendElement(&cmd, addr);
+    }
+    if (epcv) {
+	sprintf(addr, "%u", epc);
+	Tcl_DStringAppendElement(&cmd, addr);
+    }
+    if (mpcv) {
+	sprintf(addr, "%u", mpc);
+	Tcl_DStringAppendElement(&cmd, addr);
+    }
+    if (wpcv) {
+	sprintf(addr, "%u", wpc);
+	Tcl_DStringAppendElement(&cmd, addr);
+    }
+    Tcl_DStringEndSublist(&cmd);
+    Tcl_DStringStartSublist(&cmd);
+    sprintf(code, "%s %s %s %s %s",
+	    fpcv ? "F" : "",
+	    dpcv ? "D" : "",
+	    epcv ? "E" : "",
+	    mpcv ? "M" : "",
+	    wpcv ? "W" : "");
+    Tcl_DStringAppend(&cmd, code, -1);
+    Tcl_DStringEndSublist(&cmd);
+    /* Debug
+       fprintf(stderr, "Code '%s'\n", Tcl_DStringValue(&cmd));
+    */
+    status = Tcl_Eval(sim_interp, Tcl_DStringValue(&cmd));
+    if (status != TCL_OK) {
+	fprintf(stderr, "Failed to report pipe code '%s'\n", code);
+	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+    }
+}
+
+/* Report single line of pipeline state */
+static void report_state(char *id, word_t current, char *txt)
+{
+    int status;
+    sprintf(tcl_msg, "updateStage %s %lld {%s}", id, current,txt);
+    status = Tcl_Eval(sim_interp, tcl_msg);
+    if (status != TCL_OK) {
+	fprintf(stderr, "Failed to report pipe status\n");
+	fprintf(stderr, "\tStage %s.%s, status '%s'\n",
+		id, current ? "current" : "next", txt);
+	fprintf(stderr, "\tError Message was '%s'\n", sim_interp->result);
+    }
+}
+
+
+/******************************************************************************
+ *	following the simulation context
+ ******************************************************************************/
+
+/* Report the state of context c after a cycle (its show_cycle hook) */
+static void gui_report(sim_ctx_ptr c)
+{
+    pc_ptr pc_c = c->pipes[IF_STAGE].current;
+    if_id_ptr if_id_c = c->pipes[ID_STAGE].current;
+    id_ex_ptr id_ex_c = c->pipes[EX_STAGE].current;
+    ex_mem_ptr ex_mem_c = c->pipes[MEM_STAGE].current;
+    mem_wb_ptr mem_wb_c = c->pipes[WB_STAGE].current;
+
+    report_pc(c->f_pc, pc_c->status != STAT_BUB,
+	      if_id_c->stage_pc, if_id_c->status != STAT_BUB,
+	      id_ex_c->stage_pc, id_ex_c->status != STAT_BUB,
+	      ex_mem_c->stage_pc, ex_mem_c->status != STAT_BUB,
+	      mem_wb_c->stage_pc, mem_wb_c->status != STAT_BUB);
+    report_state("F", 0, format_pc(c->pipes[IF_STAGE].next));
+    report_state("F", 1, format_pc(pc_c));
+    report_state("D", 0, format_if_id(c->pipes[ID_STAGE].next));
+    report_state("D", 1, format_if_id(if_id_c));
+    report_state("E", 0, format_id_ex(c->pipes[EX_STAGE].next));
+    report_state("E", 1, format_id_ex(id_ex_c));
+    report_state("M", 0, format_ex_mem(c->pipes[MEM_STAGE].next));
+    report_state("M", 1, format_ex_mem(ex_mem_c));
+    report_state("W", 0, format_mem_wb(c->pipes[WB_STAGE].next));
+    report_state("W", 1, format_mem_wb(mem_wb_c));
+    /* signal_sources(c); */
+    show_cc(c->cc);
+    show_stat(c->status);
+    show_cpi(c);
+}
+
+/* Show the memory written at addr by context c (its show_store hook) */
+static void gui_store(sim_ctx_ptr c, word_t addr)
+{
+    if (addr % 8 != 0) {
+	/* Just did a misaligned write.
+	   Need to display both words */
+	word_t align_addr = addr & ~0x3;
+	word_t val;
+	get_word_val(c->mem, align_addr, &val);
+	set_memory(align_addr, val);
+	align_addr+=8;
+	get_word_val(c->mem, align_addr, &val);
+	set_memory(align_addr, val);
+    } else {
+	set_memory(addr, c->mem_data);
+    }
+}
+
+/* Replace the context being displayed by a new one with memory m */
+static void gui_reset(mem_t m)
+{
+    if (gui_ctx)
+	sim_ctx_free(gui_ctx);
+    gui_ctx = sim_ctx_new(m, 0, &gui_opts);
+    gui_ctx->show_cycle = gui_report;
+    gui_ctx->show_store = gui_store;
+    minAddr = 0;
+    memCnt = 0;
+    signal_register_clear();
+    create_memory_display();
+    gui_report(gui_ctx);
+}
+
+
+/*
+ * Tcl_AppInit - Called by TCL to perform application-specific initialization.
+ */
+int Tcl_AppInit(Tcl_Interp *interp)
+{
+    /* Tell TCL about the name of the simulator so it can  */
+    /* use it as the title of the main window */
+    Tcl_SetVar(interp, "simname", simname, TCL_GLOBAL_ONLY);
+
+    if (Tcl_Init(interp) == TCL_ERROR)
+	return TCL_ERROR;
+    if (Tk_Init(interp) == TCL_ERROR)
+	return TCL_ERROR;
+    Tcl_StaticPackage(interp, "Tk", Tk_Init, Tk_SafeInit);
+
+    /* Call procedure to add new commands */
+    addAppCommands(interp);
+
+    /*
+     * Specify a user-specific startup file to invoke if the application
+     * is run interactively.  Typically the startup file is "~/.apprc"
+     * where "app" is the name of the application.  If this line is deleted
+     * then no user-specific startup file will be run under any conditions.
+     */
+    Tcl_SetVar(interp, "tcl_rcFileName", "~/.wishrc", TCL_GLOBAL_ONLY);
+    return TCL_OK;
+
+}
+
+/*
+ * gui_main - Run the GUI with the Tk arguments argc and argv.  Every
+ * context it creates has mem_size bytes of memory and the options opts,
+ * without logging or tracing.
+ */
+void gui_main(int argc, char **argv, word_t mem_size, sim_opts_ptr opts)
+{
+    gui_opts = *opts;
+    gui_opts.log = NULL;
+    gui_opts.trace = FALSE;
+    gui_mem_size = mem_size;
+    Tk_Main(argc, argv, Tcl_AppInit);
+}
+
+#endif /* HAS_GUI */
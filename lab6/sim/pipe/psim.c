@@ -1,30 +1,48 @@
 /**************************************************************************
  * psim.c - Pipelined Y86-64 simulator
- * 
+ *
  * Copyright (c) 2010, 2015. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
- **************************************************************************/ 
+ **************************************************************************/
+
+/*
+ * This is the command line front end of the simulator.  The pipeline
+ * itself is simulated by the core in sim.c, and the GUI is provided
+ * by psim-gui.c.
+ */
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdarg.h>
 #include <unistd.h>
 #include <string.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
 
 #include "isa.h"
 #include "pipeline.h"
 #include "stages.h"
 #include "sim.h"
+#include "trace.h"
+#include "driver.h"
+
+#ifdef HCL_COVERAGE
+/* Prints the counters of control logic generated by hcl2c -c */
+void hcl_cov_dump(FILE *out);
+
+static void dump_coverage()
+{
+    hcl_cov_dump(stderr);
+}
+#endif
 
 #define MAXBUF 1024
 #define DEFAULTNAME "Y86-64 Simulator: "
 
-#ifdef HAS_GUI
-#include <tk.h>
-#endif /* HAS_GUI */
-
 #define MAXARGS 128
-#define MAXBUF 1024
+#define MAX_BATCH 64   /* Maximum number of object files in batch mode */
+#define SWEEP_LEN 64    /* Longest ncopy block length for --sweep */
+#define SAMPLE_WARM 500 /* Default warm-up instructions per sample (-S) */
 #define TKARGS 3
 
 
@@ -40,25 +58,60 @@ extern  char simname[];
 int gui_mode = FALSE;    /* Run in GUI mode instead of TTY mode? (-g) */
 char *object_filename;   /* The input object file name. */
 FILE *object_file;       /* Input file handle */
-bool_t verbosity = 2;    /* Verbosity level [TTY only] (-v) */ 
+bool_t verbosity = 2;    /* Verbosity level [TTY only] (-v) */
 word_t instr_limit = 10000; /* Instruction limit [TTY only] (-l) */
 bool_t do_check = FALSE; /* Test with ISA simulator? [TTY only] (-t) */
-
-/************* 
- * End Globals 
+word_t mem_size = MEM_SIZE; /* Memory size in bytes (-m) */
+bool_t batch_mode = FALSE; /* Simulate several object files in turn? (-b) */
+bool_t do_profile = FALSE; /* Attribute lost cycles to their causes? (-p) */
+bool_t sweep_mode = FALSE; /* Run ncopy on all block lengths? (--sweep) */
+int sweep_workers = 0;     /* Worker threads for --sweep (-j) */
+char *bp_option = NULL;    /* Branch predictor(s) to evaluate (-B) */
+char *icache_option = NULL; /* Instruction cache geometry (-I) */
+char *dcache_option = NULL; /* Data cache geometry (-D) */
+char *sample_option = NULL; /* Sampling pattern (-S) */
+char *trace_filename = NULL; /* Binary cycle trace file (-T) */
+char *driver_option = NULL; /* Run ncopy under a built driver (-d) */
+word_t driver_n;           /* Its block length, */
+unsigned driver_seed;      /* data seed, */
+bool_t driver_random;      /* and whether the count is random */
+char *ckpt_option = NULL;  /* Cycle and file of checkpoint to write (-C) */
+char *resume_filename = NULL; /* Checkpoint to resume from (-R) */
+
+/* What every simulation context models, set up from -I, -D, -B and -p */
+static sim_opts_rec sim_opts;
+static bool_t bp_all = FALSE;      /* Compare all predictors? (-B all) */
+
+/* Checkpoint state, set up from -C */
+static char *ckpt_filename = NULL; /* Checkpoint to write, until written */
+static word_t ckpt_cycle = 0;      /* Cycle after which to write it */
+
+/*************
+ * End Globals
  *************/
 
 
 /***************************
- * Begin function prototypes 
+ * Begin function prototypes
  ***************************/
 
-word_t sim_run_pipe(word_t max_instr, word_t max_cycle, byte_t *statusp, cc_t *ccp);
 static void usage(char *name);           /* Print helpful usage message */
 static void run_tty_sim();               /* Run simulator in TTY mode */
+static void run_batch_sim(int nfiles, char **files); /* Run in batch mode */
+static void run_sweep_sim(char *fname, int nworkers); /* Run ncopy sweep */
+static bool_t select_bp(char *name);     /* Choose branch predictor model */
+static bool_t setup_caches();            /* Configure caches from -I/-D */
+static bool_t setup_sampling();          /* Parse the -S pattern */
+static void run_sample_sim(sim_ctx_ptr c); /* Run sampled simulation */
+static bool_t setup_checkpoint();        /* Parse the -C option */
+static void ckpt_write(sim_ctx_ptr c, mem_t mem0, mem_t reg0);
+					 /* Write checkpoint */
+static bool_t ckpt_resume(sim_ctx_ptr c, char *fname, mem_t *mem0p,
+			  mem_t *reg0p); /* Restore a checkpoint (-R) */
 
 #ifdef HAS_GUI
-void addAppCommands(Tcl_Interp *interp); /* Add application-dependent commands */
+/* Run the GUI (psim-gui.c) on contexts with mem_size bytes and opts */
+void gui_main(int argc, char **argv, word_t mem_size, sim_opts_ptr opts);
 #endif /* HAS_GUI */
 
 /*************************
@@ -73,7 +126,7 @@ void addAppCommands(Tcl_Interp *interp); /* Add application-dependent commands *
  * simulation.
  *******************************************************************/
 
-/* 
+/*
  * sim_main - main simulator routine. This function is called from the
  * main() routine in the HCL file.
  */
@@ -82,9 +135,18 @@ int sim_main(int argc, char **argv)
     int i;
     int c;
     char *myargv[MAXARGS];
-    
+    static struct option long_options[] = {
+	{"sweep", no_argument, NULL, 's'},
+	{NULL, 0, NULL, 0}
+    };
+
+#ifdef HCL_COVERAGE
+    atexit(dump_coverage);
+#endif
+
     /* Parse the command line arguments */
-    while ((c = getopt(argc, argv, "htgl:v:")) != -1) {
+    while ((c = getopt_long(argc, argv, "htgbpl:v:m:j:B:I:D:S:T:d:C:R:",
+			    long_options, NULL)) != -1) {
 	switch(c) {
 	case 'h':
 	    usage(argv[0]);
@@ -102,9 +164,56 @@ int sim_main(int argc, char **argv)
 	case 't':
 	    do_check = TRUE;
 	    break;
+	case 'm':
+	    mem_size = parse_mem_size(optarg);
+	    if (mem_size <= 0) {
+		printf("Invalid memory size '%s'\n", optarg);
+		usage(argv[0]);
+	    }
+	    break;
 	case 'g':
 	    gui_mode = TRUE;
 	    break;
+	case 'b':
+	    batch_mode = TRUE;
+	    break;
+	case 'p':
+	    do_profile = TRUE;
+	    break;
+	case 's':
+	    sweep_mode = TRUE;
+	    break;
+	case 'B':
+	    bp_option = optarg;
+	    break;
+	case 'I':
+	    icache_option = optarg;
+	    break;
+	case 'D':
+	    dcache_option = optarg;
+	    break;
+	case 'S':
+	    sample_option = optarg;
+	    break;
+	case 'T':
+	    trace_filename = optarg;
+	    break;
+	case 'd':
+	    driver_option = optarg;
+	    break;
+	case 'C':
+	    ckpt_option = optarg;
+	    break;
+	case 'R':
+	    resume_filename = optarg;
+	    break;
+	case 'j':
+	    sweep_workers = atoi(optarg);
+	    if (sweep_workers <= 0) {
+		printf("Invalid number of workers %d\n", sweep_workers);
+		usage(argv[0]);
+	    }
+	    break;
 	default:
 	    printf("Invalid option '%c'\n", c);
 	    usage(argv[0]);
@@ -112,6 +221,105 @@ int sim_main(int argc, char **argv)
 	}
     }
 
+    if (!setup_caches())
+	usage(argv[0]);
+    sim_opts.profile = do_profile;
+
+    /* A trace records a single program run in TTY mode */
+    if (trace_filename &&
+	(gui_mode || batch_mode || sweep_mode || sample_option)) {
+	printf("Options -g, -b, --sweep and -S cannot be used with -T\n");
+	usage(argv[0]);
+    }
+
+    /* The driver is built for a single program run in TTY mode */
+    if (driver_option &&
+	(gui_mode || batch_mode || sweep_mode || sample_option || bp_option)) {
+	printf("Options -g, -b, --sweep, -S and -B cannot be used with -d\n");
+	usage(argv[0]);
+    }
+    if (driver_option &&
+	!driver_parse(driver_option, &driver_n, &driver_seed, &driver_random)) {
+	printf("Invalid driver '%s'\n", driver_option);
+	usage(argv[0]);
+    }
+
+    /* Checkpoints are written and resumed by single runs in TTY mode */
+    if ((ckpt_option || resume_filename) &&
+	(gui_mode || batch_mode || sweep_mode || sample_option || bp_option)) {
+	printf("Options -g, -b, --sweep, -S and -B cannot be used with -C or -R\n");
+	usage(argv[0]);
+    }
+    if (ckpt_option && !setup_checkpoint()) {
+	printf("Invalid checkpoint '%s'\n", ckpt_option);
+	usage(argv[0]);
+    }
+    if (resume_filename) {
+	if (do_check || driver_option) {
+	    printf("Options -t and -d cannot be used with -R\n");
+	    usage(argv[0]);
+	}
+	if (optind < argc) {
+	    printf("A run resumed with -R takes no object file\n");
+	    usage(argv[0]);
+	}
+    }
+
+    /* Sampling applies to a single program run in TTY mode */
+    if (sample_option) {
+	if (gui_mode || batch_mode || sweep_mode || bp_option) {
+	    printf("Options -g, -b, --sweep and -B cannot be used with -S\n");
+	    usage(argv[0]);
+	}
+	if (!setup_sampling()) {
+	    printf("Invalid sampling pattern '%s'\n", sample_option);
+	    usage(argv[0]);
+	}
+    }
+
+    /* The sweep runs a single ncopy object file */
+    if (sweep_mode) {
+	if (gui_mode || do_check || batch_mode || do_profile || bp_option) {
+	    printf("Options -g, -t, -b, -p and -B cannot be used with --sweep\n");
+	    usage(argv[0]);
+	}
+	if (optind != argc - 1) {
+	    printf("--sweep requires one ncopy object file\n");
+	    usage(argv[0]);
+	}
+	if (sweep_workers == 0)
+	    sweep_workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (sweep_workers <= 0)
+	    sweep_workers = 1;
+	run_sweep_sim(argv[optind], sweep_workers);
+	exit(0);
+    }
+
+    /* In batch mode, every unflagged argument is an object file */
+    if (batch_mode) {
+	if (gui_mode || do_check || do_profile || bp_option) {
+	    printf("Options -g, -t, -p and -B cannot be used in batch mode\n");
+	    usage(argv[0]);
+	}
+	if (optind == argc || argc - optind > MAX_BATCH) {
+	    printf("Batch mode requires 1 to %d object files\n", MAX_BATCH);
+	    usage(argv[0]);
+	}
+	run_batch_sim(argc - optind, argv + optind);
+	exit(0);
+    }
+
+    /* The branch predictors are evaluated in TTY mode */
+    if (bp_option) {
+	if (gui_mode) {
+	    printf("Option -B cannot be used in GUI mode\n");
+	    usage(argv[0]);
+	}
+	if (!select_bp(bp_option)) {
+	    printf("Unknown branch predictor '%s'\n", bp_option);
+	    usage(argv[0]);
+	}
+    }
 
     /* Do we have too many arguments? */
     if (optind < argc - 1) {
@@ -144,7 +352,7 @@ int sim_main(int argc, char **argv)
 	exit(1);
 #endif /* HAS_GUI */
 
-	/* In GUI mode, we must specify the object file on command line */ 
+	/* In GUI mode, we must specify the object file on command line */
 	if (!object_file) {
 	    printf("Missing object file argument in GUI mode\n");
 	    usage(argv[0]);
@@ -164,7 +372,7 @@ int sim_main(int argc, char **argv)
 
 	/* Start the GUI simulator */
 #ifdef HAS_GUI
-	Tk_Main(TKARGS, myargv, Tcl_AppInit);
+	gui_main(TKARGS, myargv, mem_size, &sim_opts);
 #endif /* HAS_GUI */
 	exit(0);
     }
@@ -175,90 +383,115 @@ int sim_main(int argc, char **argv)
     exit(0);
 }
 
-/* 
+/*
  * run_tty_sim - Run the simulator in TTY mode
  */
-static void run_tty_sim() 
+static void run_tty_sim()
 {
-    word_t icount = 0;
-    byte_t run_status = STAT_AOK;
-    cc_t result_cc = 0;
     word_t byte_cnt = 0;
     mem_t mem0, reg0;
     state_ptr isa_state = NULL;
+    driver_t drv;
+    sim_ctx_ptr c;
 
 
     /* In TTY mode, the default object file comes from stdin */
-    if (!object_file) {
+    if (!object_file && !resume_filename) {
 	object_file = stdin;
     }
 
     if (verbosity >= 2)
-	sim_set_dumpfile(stdout);
-    sim_init();
+	sim_opts.log = stdout;
+    sim_opts.trace = trace_filename != NULL;
 
     /* Emit simulator name */
     if (verbosity >= 2)
 	printf("%s\n", simname);
 
-    byte_cnt = load_mem(mem, object_file, 1);
-    if (byte_cnt == 0) {
-	fprintf(stderr, "No lines of code found\n");
+    if (resume_filename) {
+	c = sim_ctx_new(init_mem(mem_size), 0, &sim_opts);
+	if (!ckpt_resume(c, resume_filename, &mem0, &reg0))
+	    exit(1);
+	if (verbosity >= 2)
+	    printf("Resuming from checkpoint %s at cycle %lld\n",
+		   resume_filename, c->ccount);
+    } else {
+	mem_t m = init_mem(mem_size);
+
+	if (driver_option)
+	    byte_cnt = driver_load(m, object_file);
+	else
+	    byte_cnt = load_mem(m, object_file, 1);
+	if (byte_cnt == 0) {
+	    fprintf(stderr, "No lines of code found\n");
+	    exit(1);
+	} else if (verbosity >= 2) {
+	    printf("%lld bytes of code read\n", byte_cnt);
+	}
+	fclose(object_file);
+	if (driver_option)
+	    driver_build(m, byte_cnt, driver_n, driver_seed, driver_random,
+			 &drv);
+	c = sim_ctx_new(m, driver_option ? drv.main : 0, &sim_opts);
+	if (sample_option) {
+	    run_sample_sim(c);
+	    return;
+	}
+	if (do_check) {
+	    isa_state = new_state(0);
+	    free_mem(isa_state->r);
+	    free_mem(isa_state->m);
+	    isa_state->m = copy_mem(c->mem);
+	    isa_state->r = copy_mem(c->reg);
+	    isa_state->cc = c->cc;
+	    if (driver_option)
+		isa_state->pc = drv.main;
+	    sim_ctx_lock(c, isa_state, verbosity);
+	}
+
+	mem0 = copy_mem(c->mem);
+	reg0 = copy_mem(c->reg);
+    }
+
+    if (trace_filename && !trace_open(trace_filename, TRACE_PIPE, simname)) {
+	fprintf(stderr, "Couldn't open trace file %s\n", trace_filename);
 	exit(1);
-    } else if (verbosity >= 2) {
-	printf("%lld bytes of code read\n", byte_cnt);
     }
-    fclose(object_file);
-    if (do_check) {
-	isa_state = new_state(0);
-	free_mem(isa_state->r);
-	free_mem(isa_state->m);
-	isa_state->m = copy_mem(mem);
-	isa_state->r = copy_mem(reg);
-	isa_state->cc = cc;
+    /* Stop at the checkpoint cycle, if the run gets that far */
+    if (ckpt_filename && ckpt_cycle < 5*instr_limit) {
+	sim_ctx_run(c, instr_limit, ckpt_cycle);
+	if (!c->done && c->icount < instr_limit && c->ccount == ckpt_cycle)
+	    ckpt_write(c, mem0, reg0);
     }
-
-    mem0 = copy_mem(mem);
-    reg0 = copy_mem(reg);
-    
-    icount = sim_run_pipe(instr_limit, 5*instr_limit, &run_status, &result_cc);
+    sim_ctx_run(c, instr_limit, 5*instr_limit);
+    if (ckpt_filename) {
+	printf("No checkpoint written: the run ended before cycle %lld\n",
+	       ckpt_cycle);
+	ckpt_filename = NULL;
+    }
+    if (trace_filename)
+	trace_close();
     if (verbosity > 0) {
-	printf("%lld instructions executed\n", icount);
-	printf("Status = %s\n", stat_name(run_status));
-	printf("Condition Codes: %s\n", cc_name(result_cc));
+	printf("%lld instructions executed\n", c->icount);
+	printf("Status = %s\n", stat_name(c->run_status));
+	printf("Condition Codes: %s\n", cc_name(c->cc));
 	printf("Changed Register State:\n");
-	diff_reg(reg0, reg, stdout);
+	diff_reg(reg0, c->reg, stdout);
 	printf("Changed Memory State:\n");
-	diff_mem(mem0, mem, stdout);
+	diff_mem(mem0, c->mem, stdout);
     }
+    if (driver_option)
+	printf("Driver check: %s\n",
+	       driver_result_names[driver_check(c->mem, c->reg, c->run_status,
+						&drv, byte_cnt, 0)]);
     if (do_check) {
-	byte_t e = STAT_AOK;
-	word_t step;
-	bool_t match = TRUE;
-
-	for (step = 0; step < instr_limit && e == STAT_AOK; step++) {
-	    e = step_state(isa_state, stdout);
-	}
+	bool_t match = sim_ctx_unlock(c);
 
-	if (diff_reg(isa_state->r, reg, NULL)) {
-	    match = FALSE;
-	    if (verbosity > 0) {
-		printf("ISA Register != Pipeline Register File\n");
-		diff_reg(isa_state->r, reg, stdout);
-	    }
-	}
-	if (diff_mem(isa_state->m, mem, NULL)) {
-	    match = FALSE;
-	    if (verbosity > 0) {
-		printf("ISA Memory != Pipeline Memory\n");
-		diff_mem(isa_state->m, mem, stdout);
-	    }
-	}
-	if (isa_state->cc != result_cc) {
+	if (match && isa_state->cc != c->cc) {
 	    match = FALSE;
 	    if (verbosity > 0) {
 		printf("ISA Cond. Codes (%s) != Pipeline Cond. Codes (%s)\n",
-		       cc_name(isa_state->cc), cc_name(result_cc));
+		       cc_name(isa_state->cc), cc_name(c->cc));
 	    }
 	}
 	if (match) {
@@ -270,10 +503,16 @@ static void run_tty_sim()
 
     /* Emit CPI statistics */
     {
-	double cpi = instructions > 0 ? (double) cycles/instructions : 1.0;
+	double cpi = c->instructions > 0 ?
+	    (double) c->cycles/c->instructions : 1.0;
 	printf("CPI: %lld cycles/%lld instructions = %.2f\n",
-	       cycles, instructions, cpi);
+	       c->cycles, c->instructions, cpi);
     }
+    sim_print_caches(c);
+    if (do_profile)
+	sim_print_profile(c);
+    if (bp_option)
+	sim_print_bp_compare(c, mem0, bp_all, instr_limit);
 
 }
 
@@ -282,1323 +521,521 @@ static void run_tty_sim()
  */
 static void usage(char *name)
 {
-    printf("Usage: %s [-htg] [-l m] [-v n] file.yo\n", name);
-    printf("file.yo arg required in GUI mode, optional in TTY mode (default stdin)\n");
+    printf("Usage: %s [-htgp] [-B bp] [-I c] [-D c] [-C n:f] [-T f] [-l m]"
+	   " [-v n] [-m s] file.yo\n", name);
+    printf("       %s -R f [-p] [-I c] [-D c] [-C n:f] [-T f] [-l m]"
+	   " [-v n] [-m s]\n", name);
+    printf("       %s -d n[:seed] [-tp] [-I c] [-D c] [-T f] [-l m]"
+	   " [-v n] [-m s] ncopy.yo\n", name);
+    printf("       %s -S ff:n[:w] [-tp] [-I c] [-D c] [-l m] [-v n]"
+	   " [-m s] file.yo\n", name);
+    printf("       %s -b [-I c] [-D c] [-l m] [-v n] [-m s]"
+	   " file.yo[:n] ...\n", name);
+    printf("       %s --sweep [-j n] [-I c] [-D c] [-l m] [-m s]"
+	   " ncopy.yo\n", name);
+    printf("file.yo arg required in GUI mode, optional in TTY mode"
+	   " (default stdin)\n");
     printf("   -h     Print this message\n");
-    printf("   -g     Run in GUI mode instead of TTY mode (default TTY)\n");  
-    printf("   -l m   Set instruction limit to m [TTY mode only] (default %lld)\n", instr_limit);
-    printf("   -v n   Set verbosity level to 0 <= n <= 2 [TTY mode only] (default %d)\n", verbosity);
-    printf("   -t     Test result against ISA simulator [TTY mode only]\n");
+    printf("   -g     Run in GUI mode instead of TTY mode (default TTY)\n");
+    printf("   -b     Batch mode: simulate up to %d files in one run,"
+	   " reporting CPI\n", MAX_BATCH);
+    printf("          for each and the average CPE of files tagged with"
+	   " n elements\n");
+    printf("   --sweep Run ncopy.yo (assembled by itself) on block lengths"
+	   " 0 to %d,\n", SWEEP_LEN);
+    printf("          reporting cycles, correctness, and average CPE\n");
+    printf("   -j n   Use n worker threads for --sweep"
+	   " (default: one per CPU)\n");
+    printf("   -C n:f Write a checkpoint of the whole simulator state"
+	   " to file f\n");
+    printf("          after cycle n [TTY mode only]\n");
+    printf("   -R f   Resume the run saved in checkpoint file f,"
+	   " instead of\n");
+    printf("          starting one from an object file [TTY mode only]\n");
+    printf("   -d n[:seed] Run ncopy.yo (assembled by itself) under a"
+	   " driver for n\n");
+    printf("          elements built in memory, and check the result."
+	   " With a seed,\n");
+    printf("          the words are positive at random"
+	   " (as gen-driver.pl -r) [TTY mode only]\n");
+    printf("   -l m   Set instruction limit to m [TTY mode only]"
+	   " (default %lld)\n", instr_limit);
+    printf("   -v n   Set verbosity level to 0 <= n <= 2 [TTY mode only]"
+	   " (default %d)\n", verbosity);
+    printf("   -t     Test each instruction against ISA simulator"
+	   " [TTY mode only]\n");
+    printf("   -p     Break down lost cycles by cause and by PC"
+	   " [TTY mode only]\n");
+    printf("   -B bp  Predict branches with model bp, or try them all"
+	   " if bp is 'all',\n");
+    printf("          and compare against pipe-std [TTY mode only]."
+	   " Models:\n");
+    sim_print_bp_models();
+    printf("   -I c   Model an L1 instruction cache c, given as"
+	   " size:assoc:block[:hit[:miss]]\n");
+    printf("          with size in bytes (optional K/M suffix),"
+	   " latencies in cycles\n");
+    printf("          (default hit %d, miss %d) and LRU replacement\n",
+	   CACHE_HIT, CACHE_MISS);
+    printf("   -D c   Model an L1 data cache c, given as for -I\n");
+    printf("   -S ff:n[:w] Sample: repeatedly skip ff instructions"
+	   " in the ISA simulator,\n");
+    printf("          then warm up the pipeline for w instructions"
+	   " (default %d) and\n", SAMPLE_WARM);
+    printf("          time the next n. Reports the estimated CPI"
+	   " [TTY mode only]\n");
+    printf("   -T f   Write a binary trace of every cycle to file f,"
+	   " to be read\n");
+    printf("          with ../misc/ytrace [TTY mode only]\n");
+    printf("   -m s   Set memory size to s bytes, with optional K/M/G"
+	   " suffix (default %d)\n", MEM_SIZE);
     exit(0);
 }
 
-
-/*********************************************************
- * Part 2: This part contains the core simulator routines.
- *********************************************************/
-
-
-/*****************
- *  Part 2 Globals
- *****************/
-
-/* Performance monitoring */
-/* How many cycles have been simulated? */
-word_t cycles = 0;
-/* How many instructions have passed through the WB stage? */
-word_t instructions = 0;
-
-/* Has simulator gotten past initial bubbles? */
-static int starting_up = 1;
-
-
-
-/* Both instruction and data memory */
-mem_t mem;
-word_t minAddr = 0;
-word_t memCnt = 0;
-
-/* Register file */
-mem_t reg;
-/* Condition code register */
-cc_t cc;
-/* Status code */
-stat_t status;
-
-
-/* Pending updates to state */
-word_t cc_in = DEFAULT_CC;
-word_t wb_destE = REG_NONE;
-word_t wb_valE = 0;
-word_t wb_destM = REG_NONE;
-word_t wb_valM = 0;
-word_t mem_addr = 0;
-word_t mem_data = 0;
-bool_t mem_write = FALSE;
-
-/* EX Operand sources */
-mux_source_t amux = MUX_NONE;
-mux_source_t bmux = MUX_NONE;
-
-/* Current and next states of all pipeline registers */
-pc_ptr pc_curr;
-if_id_ptr if_id_curr;
-id_ex_ptr id_ex_curr;
-ex_mem_ptr ex_mem_curr;
-mem_wb_ptr mem_wb_curr;
-
-pc_ptr pc_next;
-if_id_ptr if_id_next;
-id_ex_ptr id_ex_next;
-ex_mem_ptr ex_mem_next;
-mem_wb_ptr mem_wb_next;
-
-/* Intermediate values */
-word_t f_pc;
-byte_t imem_icode;
-byte_t imem_ifun;
-bool_t imem_error;
-bool_t instr_valid;
-word_t d_regvala;
-word_t d_regvalb;
-word_t e_vala;
-word_t e_valb;
-bool_t e_bcond;
-bool_t dmem_error;
-
-/* The pipeline state */
-pipe_ptr pc_state, if_id_state, id_ex_state, ex_mem_state, mem_wb_state;
-
-/* Simulator operating mode */
-sim_mode_t sim_mode = S_FORWARD;
-/* Log file */
-FILE *dumpfile = NULL;
-
-/*****************************************************************************
- * reporting code
- *****************************************************************************/
-
-#ifdef HAS_GUI
-/* used for formatting instructions */
-static char status_msg[128];
-
-static char *format_pc(pc_ptr state)
+static bool_t setup_caches()
 {
-    char pstring[17];
-    wstring(state->pc, 4, 64, pstring);
-    sprintf(status_msg, "%s %s", stat_name(state->status), pstring);
-    return status_msg;
-}
-
-static char *format_if_id(if_id_ptr state)
-{
-    char valcstring[17];
-    char valpstring[17];
-    wstring(state->valc, 4, 64, valcstring);
-    wstring(state->valp, 4, 64, valpstring);
-    sprintf(status_msg, "%s %s %s %s %s %s",
-	    stat_name(state->status),
-	    iname(HPACK(state->icode,state->ifun)),
-	    reg_name(state->ra),
-	    reg_name(state->rb),
-	    valcstring,
-	    valpstring);
-    return status_msg;
-}
-
-static char *format_id_ex(id_ex_ptr state)
-{
-    char valcstring[17];
-    char valastring[17];
-    char valbstring[17];
-    wstring(state->valc, 4, 64, valcstring);
-    wstring(state->vala, 4, 64, valastring);
-    wstring(state->valb, 4, 64, valbstring);
-    sprintf(status_msg, "%s %s %s %s %s %s %s %s %s",
-	    stat_name(state->status),
-	    iname(HPACK(state->icode, state->ifun)),
-	    valcstring,
-	    valastring,
-	    valbstring,
-	    reg_name(state->deste),
-	    reg_name(state->destm),
-	    reg_name(state->srca),
-	    reg_name(state->srcb));
-    return status_msg;
-}
-
-static char *format_ex_mem(ex_mem_ptr state)
-{
-    char valestring[17];
-    char valastring[17];
-    wstring(state->vale, 4, 64, valestring);
-    wstring(state->vala, 4, 64, valastring);
-    sprintf(status_msg, "%s %s %c %s %s %s %s",
-	    stat_name(state->status),
-	    iname(HPACK(state->icode, state->ifun)),
-	    state->takebranch ? 'Y' : 'N',
-	    valestring,
-	    valastring,
-	    reg_name(state->deste),
-	    reg_name(state->destm));
-
-    return status_msg;
-}
-
-static char *format_mem_wb(mem_wb_ptr state)
-{
-    char valestring[17];
-    char valmstring[17];
-    wstring(state->vale, 4, 64, valestring);
-    wstring(state->valm, 4, 64, valmstring);
-    sprintf(status_msg, "%s %s %s %s %s %s",
-	    stat_name(state->status),
-	    iname(HPACK(state->icode, state->ifun)),
-	    valestring,
-	    valmstring,
-	    reg_name(state->deste),
-	    reg_name(state->destm));
-
-    return status_msg;
-}
-#endif /* HAS_GUI */
-
-/* Report system state */
-static void sim_report() 
-{
-
-#ifdef HAS_GUI
-    if (gui_mode) {
-	report_pc(f_pc, pc_curr->status != STAT_BUB,
-		  if_id_curr->stage_pc, if_id_curr->status != STAT_BUB,
-		  id_ex_curr->stage_pc, id_ex_curr->status != STAT_BUB,
-		  ex_mem_curr->stage_pc, ex_mem_curr->status != STAT_BUB,
-		  mem_wb_curr->stage_pc, mem_wb_curr->status != STAT_BUB);
-	report_state("F", 0, format_pc(pc_next));
-	report_state("F", 1, format_pc(pc_curr));
-	report_state("D", 0, format_if_id(if_id_next));
-	report_state("D", 1, format_if_id(if_id_curr));
-	report_state("E", 0, format_id_ex(id_ex_next));
-	report_state("E", 1, format_id_ex(id_ex_curr));
-	report_state("M", 0, format_ex_mem(ex_mem_next));
-	report_state("M", 1, format_ex_mem(ex_mem_curr));
-	report_state("W", 0, format_mem_wb(mem_wb_next));
-	report_state("W", 1, format_mem_wb(mem_wb_curr));
-	/* signal_sources(); */
-	show_cc(cc);
-	show_stat(status);
-	show_cpi();
+    if (icache_option && !sim_parse_cache(icache_option, &sim_opts.icache)) {
+	printf("Invalid instruction cache '%s'\n", icache_option);
+	return FALSE;
     }
-#endif
-
+    if (dcache_option && !sim_parse_cache(dcache_option, &sim_opts.dcache)) {
+	printf("Invalid data cache '%s'\n", dcache_option);
+	return FALSE;
+    }
+    return TRUE;
 }
 
-/*****************************************************************************
- * pipeline control
- * These functions can be used to handle hazards
- *****************************************************************************/
-
-/* bubble stage (has effect at next update) */
-void sim_bubble_stage(stage_id_t stage) 
+/* With 'all', the run follows the pipe-std policy and every model is
+   compared after it */
+static bool_t select_bp(char *name)
 {
-    switch (stage)
-	{
-	case IF_STAGE : pc_state->op     = P_BUBBLE; break;
-	case ID_STAGE : if_id_state->op  = P_BUBBLE; break;
-	case EX_STAGE : id_ex_state->op  = P_BUBBLE; break;
-	case MEM_STAGE: ex_mem_state->op = P_BUBBLE; break;
-	case WB_STAGE : mem_wb_state->op = P_BUBBLE; break;
-	}
-}
-
-/* stall stage (has effect at next update) */
-void sim_stall_stage(stage_id_t stage) {
-    switch (stage)
-	{
-	case IF_STAGE : pc_state->op     = P_STALL; break;
-	case ID_STAGE : if_id_state->op  = P_STALL; break;
-	case EX_STAGE : id_ex_state->op  = P_STALL; break;
-	case MEM_STAGE: ex_mem_state->op = P_STALL; break;
-	case WB_STAGE : mem_wb_state->op = P_STALL; break;
-	}
+    if (strcmp(name, "all") == 0) {
+	bp_all = TRUE;
+	name = "std";
+    }
+    sim_opts.bp = sim_bp_model(name);
+    return sim_opts.bp != NULL;
 }
 
 
-static int initialized = 0;
+/*******************************************************************
+ * Part 2: Checkpoints and sampled simulation, run in TTY mode on a
+ * single simulation context.
+ *******************************************************************/
 
-void sim_init()
-{
-    /* Create memory and register files */
-    initialized = 1;
-    mem = init_mem(MEM_SIZE);
-    reg = init_reg();
-    
-    /* create 5 pipe registers */
-    pc_state     = new_pipe(sizeof(pc_ele), (void *) &bubble_pc);
-    if_id_state  = new_pipe(sizeof(if_id_ele), (void *) &bubble_if_id);
-    id_ex_state  = new_pipe(sizeof(id_ex_ele), (void *) &bubble_id_ex);
-    ex_mem_state = new_pipe(sizeof(ex_mem_ele), (void *) &bubble_ex_mem);
-    mem_wb_state = new_pipe(sizeof(mem_wb_ele), (void *) &bubble_mem_wb);
-  
-    /* connect them to the pipeline stages */
-    pc_next   = pc_state->next;
-    pc_curr   = pc_state->current;
-  
-    if_id_next = if_id_state->next;
-    if_id_curr = if_id_state->current;
-
-    id_ex_next = id_ex_state->next;
-    id_ex_curr = id_ex_state->current;
-
-    ex_mem_next = ex_mem_state->next;
-    ex_mem_curr = ex_mem_state->current;
-
-    mem_wb_next = mem_wb_state->next;
-    mem_wb_curr = mem_wb_state->current;
-
-    sim_reset();
-    clear_mem(mem);
-}
+/*
+ * Checkpoints (-C n:f, -R f).  The core saves and restores the whole
+ * state of a context (see sim_ctx_save), along with the memory and
+ * registers its run started with.
+ */
 
-void sim_reset()
+/* Parse the -C option n:f */
+static bool_t setup_checkpoint()
 {
-    if (!initialized)
-	sim_init();
-    clear_pipes();
-    clear_mem(reg);
-    minAddr = 0;
-    memCnt = 0;
-    starting_up = 1;
-    cycles = instructions = 0;
-    cc = DEFAULT_CC;
-    status = STAT_AOK;
-
-#ifdef HAS_GUI
-    if (gui_mode) {
-	signal_register_clear();
-	create_memory_display();
-    }
-#endif
+    char *end;
 
-    amux = bmux = MUX_NONE;
-    cc = cc_in = DEFAULT_CC;
-    wb_destE = REG_NONE;
-    wb_valE = 0;
-    wb_destM = REG_NONE;
-    wb_valM = 0;
-    mem_addr = 0;
-    mem_data = 0;
-    mem_write = FALSE;
-    sim_report();
+    ckpt_cycle = strtoll(ckpt_option, &end, 10);
+    if (end == ckpt_option || ckpt_cycle < 0 || *end != ':' || !end[1])
+	return FALSE;
+    ckpt_filename = end+1;
+    return TRUE;
 }
 
-/* Update state elements */
-/* May need to disable updating of memory & condition codes */
-static void update_state(bool_t update_mem, bool_t update_cc)
+/* Write the checkpoint requested by -C, once context c has run
+   ckpt_cycle cycles of the run that started from mem0 and reg0 */
+static void ckpt_write(sim_ctx_ptr c, mem_t mem0, mem_t reg0)
 {
-    /* Writeback(s):
-       If either register is REG_NONE, write will have no effect .
-       Order of two writes determines semantics of
-       popl %rsp.  According to ISA, %rsp will get popped value
-    */
-
-    if (wb_destE != REG_NONE) {
-	sim_log("\tWriteback: Wrote 0x%llx to register %s\n",
-		wb_valE, reg_name(wb_destE));
-	set_reg_val(reg, wb_destE, wb_valE);
-    }
-    if (wb_destM != REG_NONE) {
-	sim_log("\tWriteback: Wrote 0x%llx to register %s\n",
-		wb_valM, reg_name(wb_destM));
-	set_reg_val(reg, wb_destM, wb_valM);
-    }
+    FILE *f;
+    char *error;
 
-    /* Memory write */
-    if (mem_write && !update_mem) {
-	sim_log("\tDisabled write of 0x%llx to address 0x%llx\n", mem_data, mem_addr);
+    if ((f = fopen(ckpt_filename, "wb")) == NULL) {
+	fprintf(stderr, "Couldn't open checkpoint file %s\n", ckpt_filename);
+	exit(1);
     }
-    if (update_mem && mem_write) {
-	if (!set_word_val(mem, mem_addr, mem_data)) {
-	    sim_log("\tCouldn't write to address 0x%llx\n", mem_addr);
-	} else {
-	    sim_log("\tWrote 0x%llx to address 0x%llx\n", mem_data, mem_addr);
-
-#ifdef HAS_GUI
-	    if (gui_mode) {
-		if (mem_addr % 8 != 0) {
-		    /* Just did a misaligned write.
-		       Need to display both words */
-		    word_t align_addr = mem_addr & ~0x3;
-		    word_t val;
-		    get_word_val(mem, align_addr, &val);
-		    set_memory(align_addr, val);
-		    align_addr+=8;
-		    get_word_val(mem, align_addr, &val);
-		    set_memory(align_addr, val);
-		} else {
-		    set_memory(mem_addr, mem_data);
-		}
-	    }
-#endif
-
-	}
+    error = sim_ctx_save(c, f, mem0, reg0);
+    if (fclose(f) != 0 && !error)
+	error = "write error";
+    if (error) {
+	fprintf(stderr, "Couldn't write checkpoint file %s: %s\n",
+		ckpt_filename, error);
+	exit(1);
     }
-    if (update_cc)
-	cc = cc_in;
-}
-
-/* Text representation of status */
-void tty_report(word_t cyc) {
-  sim_log("\nCycle %lld. CC=%s, Stat=%s\n", cyc, cc_name(cc), stat_name(status));
-
-  sim_log("F: predPC = 0x%llx\n", pc_curr->pc);
-
-  sim_log("D: instr = %s, rA = %s, rB = %s, valC = 0x%llx, valP = 0x%llx, Stat = %s\n",
-	  iname(HPACK(if_id_curr->icode, if_id_curr->ifun)),
-	  reg_name(if_id_curr->ra), reg_name(if_id_curr->rb),
-	  if_id_curr->valc, if_id_curr->valp,
-	  stat_name(if_id_curr->status));
-
-  sim_log("E: instr = %s, valC = 0x%llx, valA = 0x%llx, valB = 0x%llx\n   srcA = %s, srcB = %s, dstE = %s, dstM = %s, Stat = %s\n",
-	  iname(HPACK(id_ex_curr->icode, id_ex_curr->ifun)),
-	  id_ex_curr->valc, id_ex_curr->vala, id_ex_curr->valb,
-	  reg_name(id_ex_curr->srca), reg_name(id_ex_curr->srcb),
-	  reg_name(id_ex_curr->deste), reg_name(id_ex_curr->destm),
-	  stat_name(id_ex_curr->status));
-
-  sim_log("M: instr = %s, Cnd = %d, valE = 0x%llx, valA = 0x%llx\n   dstE = %s, dstM = %s, Stat = %s\n",
-	  iname(HPACK(ex_mem_curr->icode, ex_mem_curr->ifun)),
-	  ex_mem_curr->takebranch,
-	  ex_mem_curr->vale, ex_mem_curr->vala,
-	  reg_name(ex_mem_curr->deste), reg_name(ex_mem_curr->destm),
-	  stat_name(ex_mem_curr->status));
-
-  sim_log("W: instr = %s, valE = 0x%llx, valM = 0x%llx, dstE = %s, dstM = %s, Stat = %s\n",
-	  iname(HPACK(mem_wb_curr->icode, mem_wb_curr->ifun)),
-	  mem_wb_curr->vale, mem_wb_curr->valm,
-	  reg_name(mem_wb_curr->deste), reg_name(mem_wb_curr->destm),
-	  stat_name(mem_wb_curr->status));
+    if (verbosity > 0)
+	printf("Checkpoint written to %s after cycle %lld\n",
+	       ckpt_filename, c->ccount);
+    ckpt_filename = NULL;
 }
 
-/* Run pipeline for one cycle */
-/* Return status of processor */
-/* Max_instr indicates maximum number of instructions that
-   want to complete during this simulation run.  */
-static byte_t sim_step_pipe(word_t max_instr, word_t ccount)
+/*
+ * Restore the checkpoint in file fname into context c, which has not
+ * been stepped yet, and return the initial memory and registers of
+ * the run in *mem0p and *reg0p
+ */
+static bool_t ckpt_resume(sim_ctx_ptr c, char *fname, mem_t *mem0p,
+			  mem_t *reg0p)
 {
-    byte_t wb_status = mem_wb_curr->status;
-    byte_t mem_status = mem_wb_next->status;
-    /* How many instructions are ahead of one in wb / ex? */
-    int ahead_mem = (wb_status != STAT_BUB);
-    int ahead_ex = ahead_mem + (mem_status != STAT_BUB);
-    bool_t update_mem = ahead_mem < max_instr;
-    bool_t update_cc = ahead_ex < max_instr;
-
-    /* Update program-visible state */
-    update_state(update_mem, update_cc);
-    /* Update pipe registers */
-    update_pipes();
-    tty_report(ccount);
-    if (pc_state->op == P_ERROR)
-	pc_curr->status = STAT_PIP;
-    if (if_id_state->op == P_ERROR)
-	if_id_curr->status = STAT_PIP;
-    if (id_ex_state->op == P_ERROR)
-	id_ex_curr->status = STAT_PIP;
-    if (ex_mem_state->op == P_ERROR)
-	ex_mem_curr->status = STAT_PIP;
-    if (mem_wb_state->op == P_ERROR)
-	mem_wb_curr->status = STAT_PIP;
-    
-    /* Need to do decode after execute & memory stages,
-       and memory stage before execute, in order to propagate
-       forwarding values properly */
-    do_if_stage();
-    do_mem_stage();
-    do_ex_stage();
-    do_id_wb_stages();
-
-    do_stall_check();
-#if 0
-    /* This doesn't seem necessary */
-    if (id_ex_curr->status != STAT_AOK
-	&& id_ex_curr->status != STAT_BUB) {
-	if_id_state->op = P_BUBBLE;
-	id_ex_state->op = P_BUBBLE;
-    }
-#endif
+    FILE *f;
+    char *error;
 
-    /* Performance monitoring */
-    if (mem_wb_curr->status != STAT_BUB && mem_wb_curr->icode != I_POP2) {
-	starting_up = 0;
-	instructions++;
-	cycles++;
-    } else {
-	if (!starting_up)
-	    cycles++;
+    if ((f = fopen(fname, "rb")) == NULL) {
+	fprintf(stderr, "Couldn't open checkpoint file %s\n", fname);
+	return FALSE;
     }
-    
-    sim_report();
-    return status;
-}
-
-/*
-  Run pipeline until one of following occurs:
-  - An error status is encountered in WB.
-  - max_instr instructions have completed through WB
-  - max_cycle cycles have been simulated
-
-  Return number of instructions executed.
-  if statusp nonnull, then will be set to status of final instruction
-  if ccp nonnull, then will be set to condition codes of final instruction
-*/
-word_t sim_run_pipe(word_t max_instr, word_t max_cycle, byte_t *statusp, cc_t *ccp)
-{
-    word_t icount = 0;
-    word_t ccount = 0;
-    byte_t run_status = STAT_AOK;
-    while (icount < max_instr && ccount < max_cycle) {
-        run_status = sim_step_pipe(max_instr-icount, ccount);
-	if (run_status != STAT_BUB)
-	    icount++;
-	if (run_status != STAT_AOK && run_status != STAT_BUB)
-	    break;
-	ccount++;
+    error = sim_ctx_restore(c, f, mem0p, reg0p);
+    fclose(f);
+    if (error) {
+	fprintf(stderr, "Couldn't resume from checkpoint file %s: %s\n",
+		fname, error);
+	return FALSE;
     }
-    if (statusp)
-	*statusp = run_status;
-    if (ccp)
-	*ccp = cc;
-    return icount;
-}
-
-/* If dumpfile set nonNULL, lots of status info printed out */
-void sim_set_dumpfile(FILE *df)
-{
-    dumpfile = df;
+    return TRUE;
 }
 
 /*
- * sim_log dumps a formatted string to the dumpfile, if it exists
- * accepts variable argument list
+ * Sampled simulation (-S ff:n:w).  The program runs on the ISA
+ * simulator, which skips ff instructions at a time.  After each skip,
+ * its state is copied into an empty pipeline, which runs w
+ * instructions to refill the pipeline and warm up the caches, and then
+ * n more whose cycles are counted as one sample (see sim_ctx_sample).
+ * The ISA simulator steps over the instructions the pipeline ran, and
+ * the pattern repeats until the program stops or instr_limit
+ * instructions have run.  The caches keep their contents from one
+ * sample to the next.  The CPI is estimated as the mean over the
+ * samples, with a 95% confidence interval from Student's t
+ * distribution.
  */
-void sim_log( const char *format, ... ) {
-    if (dumpfile) {
-	va_list arg;
-	va_start( arg, format );
-	vfprintf( dumpfile, format, arg );
-	va_end( arg );
-    }
-}
-
-
-/*************************************************************
- * Part 3: This part contains support for the GUI simulator
- *************************************************************/
-
-#ifdef HAS_GUI
-
-/**********************
- * Begin Part 3 globals	
- **********************/
-
-/* Hack for SunOS */
-// extern int matherr();
-// int *tclDummyMathPtr = (int *) matherr;
-
-static char tcl_msg[256];
-
-/* Keep track of the TCL Interpreter */
-static Tcl_Interp *sim_interp = NULL;
-
-static mem_t post_load_mem;
-
-/**********************
- * End Part 3 globals	
- **********************/
-
-
-/******************************************************************************
- *	function declarations
- ******************************************************************************/
-
-int simResetCmd(ClientData clientData, Tcl_Interp *interp,
-		int argc, char *argv[]);
-
-int simLoadCodeCmd(ClientData clientData, Tcl_Interp *interp,
-		   int argc, char *argv[]);
-
-int simLoadDataCmd(ClientData clientData, Tcl_Interp *interp,
-		   int argc, char *argv[]);
-
-int simRunCmd(ClientData clientData, Tcl_Interp *interp,
-	      int argc, char *argv[]);
-
-int simModeCmd(ClientData clientData, Tcl_Interp *interp,
-	       int argc, char *argv[]);
-
-void addAppCommands(Tcl_Interp *interp);
-
 
-/******************************************************************************
- *	tcl command definitions
- ******************************************************************************/
+static word_t sample_skip = 0;   /* Instructions skipped per sample */
+static word_t sample_detail = 0; /* Instructions timed per sample */
+static word_t sample_warm = SAMPLE_WARM; /* Warm-up instructions */
 
-/* Implement command versions of the simulation functions */
-int simResetCmd(ClientData clientData, Tcl_Interp *interp,
-		int argc, char *argv[])
+/* Parse the -S pattern ff:n[:w] */
+static bool_t setup_sampling()
 {
-    sim_interp = interp;
-    if (argc != 1) {
-	interp->result = "No arguments allowed";
-	return TCL_ERROR;
-    }
-    sim_reset();
-    if (post_load_mem) {
-	free_mem(mem);
-	mem = copy_mem(post_load_mem);
-    }
-    interp->result = stat_name(STAT_AOK);
-    return TCL_OK;
-}
-
-int simLoadCodeCmd(ClientData clientData, Tcl_Interp *interp,
-		   int argc, char *argv[])
-{
-    FILE *code_file;
-    word_t code_count;
-    sim_interp = interp;
-    if (argc != 2) {
-	interp->result = "One argument required";
-	return TCL_ERROR;
-    }
-    code_file = fopen(argv[1], "r");
-    if (!code_file) {
-	sprintf(tcl_msg, "Couldn't open code file '%s'", argv[1]);
-	interp->result = tcl_msg;
-	return TCL_ERROR;
-    }
-    sim_reset();
-    code_count = load_mem(mem, code_file, 0);
-    post_load_mem = copy_mem(mem);
-    sprintf(tcl_msg, "%lld", code_count);
-    interp->result = tcl_msg;
-    fclose(code_file);
-    return TCL_OK;
-}
-
-int simLoadDataCmd(ClientData clientData, Tcl_Interp *interp,
-		   int argc, char *argv[])
-{
-    FILE *data_file;
-    word_t word_count = 0;
-    interp->result = "Not implemented";
-    return TCL_ERROR;
-
+    char *end;
+    word_t v[3] = { 0, 0, SAMPLE_WARM };
+    char *p = sample_option;
+    int i;
 
-    sim_interp = interp;
-    if (argc != 2) {
-	interp->result = "One argument required";
-	return TCL_ERROR;
-    }
-    data_file = fopen(argv[1], "r");
-    if (!data_file) {
-	sprintf(tcl_msg, "Couldn't open data file '%s'", argv[1]);
-	interp->result = tcl_msg;
-	return TCL_ERROR;
+    for (i = 0; i < 3; i++) {
+	v[i] = strtoll(p, &end, 10);
+	if (end == p || v[i] < 0)
+	    return FALSE;
+	if (*end == '\0')
+	    break;
+	if (*end != ':' || i == 2)
+	    return FALSE;
+	p = end+1;
     }
-    sprintf(tcl_msg, "%lld", word_count);
-    interp->result = tcl_msg;
-    fclose(data_file);
-    return TCL_OK;
+    if (i == 0 || v[1] == 0)
+	return FALSE;
+    sample_skip = v[0];
+    sample_detail = v[1];
+    sample_warm = v[2];
+    return TRUE;
 }
 
+/* Two-sided 95% points of Student's t distribution, by degrees of freedom */
+static double t95[] = {
+    0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+    2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093,
+    2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045,
+    2.042
+};
 
-int simRunCmd(ClientData clientData, Tcl_Interp *interp,
-	      int argc, char *argv[])
+/* Sample the program loaded in context c */
+static void run_sample_sim(sim_ctx_ptr c)
 {
-    word_t cycle_limit = 1;
-    byte_t status;
-    cc_t cc;
-    sim_interp = interp;
-    if (argc > 2) {
-	interp->result = "At most one argument allowed";
-	return TCL_ERROR;
-    }
-    if (argc >= 2 &&
-	(sscanf(argv[1], "%lld", &cycle_limit) != 1 ||
-	 cycle_limit < 0)) {
-	sprintf(tcl_msg, "Cannot run for '%s' cycles!", argv[1]);
-	interp->result = tcl_msg;
-	return TCL_ERROR;
-    }
-    sim_run_pipe(cycle_limit + 5, cycle_limit, &status, &cc);
-    interp->result = stat_name(status);
-    return TCL_OK;
-}
+    state_ptr isa_state = new_state(0);
+    mem_t mem0 = copy_mem(c->mem);
+    mem_t reg0 = copy_mem(c->reg);
+    byte_t e = STAT_AOK;
+    word_t total = 0, timed = 0;
+    word_t nsamples = 0, mismatches = 0;
+    double sum = 0.0, sumsq = 0.0;
+
+    free_mem(isa_state->r);
+    free_mem(isa_state->m);
+    isa_state->m = copy_mem(c->mem);
+    isa_state->r = copy_mem(c->reg);
+    isa_state->cc = c->cc;
+
+    while (e == STAT_AOK && total < instr_limit) {
+	word_t step, n, icount, ncycles, ninstr;
+	byte_t run_status;
+
+	/* Skip ahead in the ISA simulator */
+	for (step = 0; step < sample_skip && total < instr_limit &&
+		 e == STAT_AOK; step++, total++)
+	    e = step_state_fast(isa_state, stdout);
+	if (e != STAT_AOK || total >= instr_limit)
+	    break;
 
-int simModeCmd(ClientData clientData, Tcl_Interp *interp,
-	       int argc, char *argv[])
-{
-    sim_interp = interp;
-    if (argc != 2) {
-	interp->result = "One argument required";
-	return TCL_ERROR;
-    }
-    interp->result = argv[1];
-    if (strcmp(argv[1], "wedged") == 0)
-	sim_mode = S_WEDGED;
-    else if (strcmp(argv[1], "stall") == 0)
-	sim_mode = S_STALL;
-    else if (strcmp(argv[1], "forward") == 0)
-	sim_mode = S_FORWARD;
-    else {
-	sprintf(tcl_msg, "Unknown mode '%s'", argv[1]);
-	interp->result = tcl_msg;
-	return TCL_ERROR;
+	/* Time a window in the pipeline */
+	n = instr_limit - total;
+	if (n > sample_warm + sample_detail)
+	    n = sample_warm + sample_detail;
+	if (c->opts.log)
+	    fprintf(c->opts.log, "\nSample at instruction %lld, PC = 0x%llx\n",
+		    total, isa_state->pc);
+	icount = sim_ctx_sample(c, isa_state, sample_warm,
+				n > sample_warm ? n - sample_warm : 0,
+				&ncycles, &ninstr, &run_status);
+	if (ninstr == sample_detail) {
+	    double cpi = (double) ncycles/ninstr;
+	    nsamples++;
+	    sum += cpi;
+	    sumsq += cpi*cpi;
+	}
+	timed += icount;
+
+	/* Then have the ISA simulator run the same instructions */
+	for (step = 0; step < icount && e == STAT_AOK; step++, total++)
+	    e = step_state_fast(isa_state, stdout);
+	if (do_check && (diff_reg(isa_state->r, c->reg, NULL) ||
+			 diff_mem(isa_state->m, c->mem, NULL) ||
+			 (e == STAT_AOK && isa_state->cc != c->cc)))
+	    mismatches++;
+	if (icount == 0)
+	    break;
     }
-    return TCL_OK;
-}
-
 
-/******************************************************************************
- *	registering the commands with tcl
- ******************************************************************************/
-
-void addAppCommands(Tcl_Interp *interp)
-{
-    sim_interp = interp;
-    Tcl_CreateCommand(interp, "simReset", (Tcl_CmdProc *) simResetCmd,
-		      (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
-    Tcl_CreateCommand(interp, "simCode", (Tcl_CmdProc *) simLoadCodeCmd,
-		      (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
-    Tcl_CreateCommand(interp, "simData", (Tcl_CmdProc *) simLoadDataCmd,
-		      (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
-    Tcl_CreateCommand(interp, "simRun", (Tcl_CmdProc *) simRunCmd,
-		      (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
-    Tcl_CreateCommand(interp, "setSimMode", (Tcl_CmdProc *) simModeCmd,
-		      (ClientData) NULL, (Tcl_CmdDeleteProc *) NULL);
-} 
-
-/******************************************************************************
- *	tcl functionality called from within C
- ******************************************************************************/
-
-/* Provide mechanism for simulator to update register display */
-void signal_register_update(reg_id_t r, word_t val) {
-    int code;
-    sprintf(tcl_msg, "setReg %d %lld 1", (int) r, (word_t) val);
-    code = Tcl_Eval(sim_interp, tcl_msg);
-    if (code != TCL_OK) {
-	fprintf(stderr, "Failed to signal register set\n");
-	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+    if (verbosity > 0) {
+	printf("%lld instructions executed\n", total);
+	printf("Status = %s\n", stat_name(e));
+	printf("Condition Codes: %s\n", cc_name(isa_state->cc));
+	printf("Changed Register State:\n");
+	diff_reg(reg0, isa_state->r, stdout);
+	printf("Changed Memory State:\n");
+	diff_mem(mem0, isa_state->m, stdout);
     }
-}
-
-/* Provide mechanism for simulator to generate memory display */
-void create_memory_display() {
-    int code;
-    sprintf(tcl_msg, "createMem %lld %lld", minAddr, memCnt);
-    code = Tcl_Eval(sim_interp, tcl_msg);
-    if (code != TCL_OK) {
-	fprintf(stderr, "Command '%s' failed\n", tcl_msg);
-	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
-    } else {
-	word_t i;
-	for (i = 0; i < memCnt && code == TCL_OK; i+=8) {
-	    word_t addr = minAddr+i;
-	    word_t val;
-	    if (!get_word_val(mem, addr, &val)) {
-		fprintf(stderr, "Out of bounds memory display\n");
-		return;
-	    }
-	    sprintf(tcl_msg, "setMem %lld %lld", addr, val);
-	    code = Tcl_Eval(sim_interp, tcl_msg);
-	}
-	if (code != TCL_OK) {
-	    fprintf(stderr, "Couldn't set memory value\n");
-	    fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
-	}
+    if (do_check) {
+	if (mismatches == 0)
+	    printf("ISA Check Succeeds\n");
+	else
+	    printf("ISA Check Fails in %lld samples\n", mismatches);
     }
-}
 
-/* Provide mechanism for simulator to update memory value */
-void set_memory(word_t addr, word_t val) {
-    int code;
-    word_t nminAddr = minAddr;
-    word_t nmemCnt = memCnt;
-
-    /* First see if we need to expand memory range */
-    if (memCnt == 0) {
-	nminAddr = addr;
-	nmemCnt = 8;
-    } else if (addr < minAddr) {
-	nminAddr = addr;
-	nmemCnt = minAddr + memCnt - addr;
-    } else if (addr >= minAddr+memCnt) {
-	nmemCnt = addr-minAddr+8;
-    }
-    /* Now make sure nminAddr & nmemCnt are multiples of 16 */
-    nmemCnt = ((nminAddr & 0xF) + nmemCnt + 0xF) & ~0xF;
-    nminAddr = nminAddr & ~0xF;
-
-    if (nminAddr != minAddr || nmemCnt != memCnt) {
-	minAddr = nminAddr;
-	memCnt = nmemCnt;
-	create_memory_display();
+    printf("Sampled %lld instructions in detail out of %lld (%.1f%%)\n",
+	   timed, total, total > 0 ? 100.0*timed/total : 0.0);
+    if (nsamples == 0) {
+	printf("CPI: no complete samples\n");
     } else {
-	sprintf(tcl_msg, "setMem %lld %lld", addr, val);
-	code = Tcl_Eval(sim_interp, tcl_msg);
-	if (code != TCL_OK) {
-	    fprintf(stderr, "Couldn't set memory value 0x%llx to 0x%llx\n",
-		    addr, val);
-	    fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+	double mean = sum/nsamples;
+	printf("CPI: %.2f (mean of %lld samples of %lld instructions)", mean,
+	       nsamples, sample_detail);
+	if (nsamples > 1) {
+	    double var = (sumsq - nsamples*mean*mean)/(nsamples-1);
+	    double t = nsamples-1 < sizeof(t95)/sizeof(t95[0]) ?
+		t95[nsamples-1] : 1.960;
+	    printf(" +/- %.2f at 95%% confidence",
+		   var > 0 ? t*sqrt(var/nsamples) : 0.0);
 	}
+	printf("\n");
     }
-}
-
-/* Provide mechanism for simulator to update condition code display */
-void show_cc(cc_t cc)
-{
-    int code;
-    sprintf(tcl_msg, "setCC %d %d %d",
-	    GET_ZF(cc), GET_SF(cc), GET_OF(cc));
-    code = Tcl_Eval(sim_interp, tcl_msg);
-    if (code != TCL_OK) {
-	fprintf(stderr, "Failed to display condition codes\n");
-	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
-    }
-}
-
-/* Provide mechanism for simulator to update status display */
-void show_stat(stat_t stat)
-{
-    int code;
-    sprintf(tcl_msg, "showStat %s", stat_name(stat));
-    code = Tcl_Eval(sim_interp, tcl_msg);
-    if (code != TCL_OK) {
-	fprintf(stderr, "Failed to display status\n");
-	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
-    }
+    sim_print_caches(c);
+    if (do_profile)
+	sim_print_profile(c);
 }
 
 
+/*******************************************************************
+ * Part 3: Batch simulation and the ncopy sweep, which run many
+ * simulation contexts.
+ *******************************************************************/
 
-/* Provide mechanism for simulator to update performance information */
-void show_cpi() {
-    int code;
-    double cpi = instructions > 0 ? (double) cycles/instructions : 1.0;
-    sprintf(tcl_msg, "showCPI %lld %lld %.2f",
-	    cycles, instructions, (double) cpi);
-    code = Tcl_Eval(sim_interp, tcl_msg);
-    if (code != TCL_OK) {
-	fprintf(stderr, "Failed to display CPI\n");
-	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
-    }
-}
-
-char *rname[] = {"none", "ea", "eb", "me", "wm", "we"};
-
-/* provide mechanism for simulator to specify source registers */
-void signal_sources() {
-    int code;
-    sprintf(tcl_msg, "showSources %s %s",
-	    rname[amux], rname[bmux]);
-    code = Tcl_Eval(sim_interp, tcl_msg);
-    if (code != TCL_OK) {
-	fprintf(stderr, "Failed to signal forwarding sources\n");
-	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
-    }
-}
-
-/* Provide mechanism for simulator to clear register display */
-void signal_register_clear() {
-    int code;
-    code = Tcl_Eval(sim_interp, "clearReg");
-    if (code != TCL_OK) {
-	fprintf(stderr, "Failed to signal register clear\n");
-	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
-    }
-}
+/*
+ * Batch simulation.  This only saves starting a psim process per
+ * object file: each file gets a simulation context of its own, and
+ * the files are run one after another.  Nothing is shared between
+ * them, since the control logic reads stage signals such as e_Cnd and
+ * m_stat that depend on each run's condition codes and memory.  Every
+ * context holds its own memory of mem_size bytes, so a batch is
+ * limited to MAX_BATCH files.
+ */
 
-/* Provide mechanism for simulator to report instructions as they are 
-   read in
-*/
-
-void report_line(word_t line_no, word_t addr, char *hex, char *text) {
-    int code;
-    sprintf(tcl_msg, "addCodeLine %lld %lld {%s} {%s}", line_no, addr, hex, text);
-    code = Tcl_Eval(sim_interp, tcl_msg);
-    if (code != TCL_OK) {
-	fprintf(stderr, "Failed to report code line 0x%llx\n", addr);
-	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
-    }
-}
+typedef struct {
+    char *name;           /* Object file name */
+    word_t elements;      /* Elements processed (from file:n), or 0 */
+    sim_ctx_ptr ctx;
+} batch_rec, *batch_ptr;
 
+static batch_rec batch[MAX_BATCH];
 
-/* Provide mechanism for simulator to report which instructions are in
-   which stages */
-void report_pc(unsigned fpc, unsigned char fpcv,
-	       unsigned dpc, unsigned char dpcv,
-	       unsigned epc, unsigned char epcv,
-	       unsigned mpc, unsigned char mpcv,
-	       unsigned wpc, unsigned char wpcv)
+/* Set up b to run the object file named by arg (file.yo[:n]) */
+static void batch_init(batch_ptr b, char *arg)
 {
-    int status;
-    char addr[10];
-    char code[12];
-    Tcl_DString cmd;
-    Tcl_DStringInit(&cmd);
-    Tcl_DStringAppend(&cmd, "simLabel ", -1);
-    Tcl_DStringStartSublist(&cmd);
-    if (fpcv) {
-	sprintf(addr, "%u", fpc);
-	Tcl_DStringAppendElement(&cmd, addr);
-    }
-    if (dpcv) {
-	sprintf(addr, "%u", dpc);
-	Tcl_DStringAppendElement(&cmd, addr);
+    char *colon = strrchr(arg, ':');
+    mem_t m;
+    FILE *f;
+
+    b->name = arg;
+    b->elements = 0;
+    if (colon && colon[1] && strspn(colon+1, "0123456789") == strlen(colon+1)) {
+	*colon = '\0';
+	b->elements = atoll(colon+1);
     }
-    if (epcv) {
-	sprintf(addr, "%u", epc);
-	Tcl_DStringAppendElement(&cmd, addr);
-    }
-    if (mpcv) {
-	sprintf(addr, "%u", mpc);
-	Tcl_DStringAppendElement(&cmd, addr);
-    }
-    if (wpcv) {
-	sprintf(addr, "%u", wpc);
-	Tcl_DStringAppendElement(&cmd, addr);
-    }
-    Tcl_DStringEndSublist(&cmd);
-    Tcl_DStringStartSublist(&cmd);
-    sprintf(code, "%s %s %s %s %s",
-	    fpcv ? "F" : "",
-	    dpcv ? "D" : "",
-	    epcv ? "E" : "",
-	    mpcv ? "M" : "",
-	    wpcv ? "W" : "");
-    Tcl_DStringAppend(&cmd, code, -1);
-    Tcl_DStringEndSublist(&cmd);
-    /* Debug 
-       fprintf(stderr, "Code '%s'\n", Tcl_DStringValue(&cmd));
-    */
-    status = Tcl_Eval(sim_interp, Tcl_DStringValue(&cmd));
-    if (status != TCL_OK) {
-	fprintf(stderr, "Failed to report pipe code '%s'\n", code);
-	fprintf(stderr, "Error Message was '%s'\n", sim_interp->result);
+    if ((f = fopen(b->name, "r")) == NULL) {
+	fprintf(stderr, "Couldn't open object file %s\n", b->name);
+	exit(1);
     }
-}
-
-/* Report single line of pipeline state */
-void report_state(char *id, word_t current, char *txt)
-{
-    int status;
-    sprintf(tcl_msg, "updateStage %s %lld {%s}", id, current,txt);
-    status = Tcl_Eval(sim_interp, tcl_msg);
-    if (status != TCL_OK) {
-	fprintf(stderr, "Failed to report pipe status\n");
-	fprintf(stderr, "\tStage %s.%s, status '%s'\n",
-		id, current ? "current" : "next", txt);
-	fprintf(stderr, "\tError Message was '%s'\n", sim_interp->result);
+    m = init_mem(mem_size);
+    if (load_mem(m, f, 1) == 0) {
+	fprintf(stderr, "No lines of code found in %s\n", b->name);
+	exit(1);
     }
+    fclose(f);
+    b->ctx = sim_ctx_new(m, 0, &sim_opts);
 }
 
-
 /*
- * Tcl_AppInit - Called by TCL to perform application-specific initialization.
+ * run_batch_sim - Simulate nfiles object files, then
+ * report the CPI of each and the average CPE over the files tagged
+ * with an element count.
  */
-int Tcl_AppInit(Tcl_Interp *interp)
-{
-    /* Tell TCL about the name of the simulator so it can  */
-    /* use it as the title of the main window */
-    Tcl_SetVar(interp, "simname", simname, TCL_GLOBAL_ONLY);
-
-    if (Tcl_Init(interp) == TCL_ERROR)
-	return TCL_ERROR;
-    if (Tk_Init(interp) == TCL_ERROR)
-	return TCL_ERROR;
-    Tcl_StaticPackage(interp, "Tk", Tk_Init, Tk_SafeInit);
-
-    /* Call procedure to add new commands */
-    addAppCommands(interp);
-
-    /*
-     * Specify a user-specific startup file to invoke if the application
-     * is run interactively.  Typically the startup file is "~/.apprc"
-     * where "app" is the name of the application.  If this line is deleted
-     * then no user-specific startup file will be run under any conditions.
-     */
-    Tcl_SetVar(interp, "tcl_rcFileName", "~/.wishrc", TCL_GLOBAL_ONLY);
-    return TCL_OK;
-
-}
-
-#endif /* HAS_GUI */
-
-
-/**************************************************************
- * Part 4: Code for implementing pipelined processor simulators
- *************************************************************/
-
-/******************************************************************************
- *	defines
- ******************************************************************************/
-
-#define MAX_STAGE 10
-
-/******************************************************************************
- *	static variables
- ******************************************************************************/
-
-static pipe_ptr pipes[MAX_STAGE];
-static int pipe_count = 0;
-
-/******************************************************************************
- *	function definitions
- ******************************************************************************/
-
-/* Create new pipe with count bytes of state */
-/* bubble_val indicates state corresponding to pipeline bubble */
-pipe_ptr new_pipe(int count, void *bubble_val)
+static void run_batch_sim(int nfiles, char **files)
 {
-  pipe_ptr result = (pipe_ptr) malloc(sizeof(pipe_ele));
-  result->current = malloc(count);
-  result->next = malloc(count);
-  memcpy(result->current, bubble_val, count);
-  memcpy(result->next, bubble_val, count);
-  result->count = count;
-  result->op = P_LOAD;
-  result->bubble_val = bubble_val;
-  pipes[pipe_count++] = result; 
-  return result;
-}
-
-/* Update all pipes */
-void update_pipes()
-{
-  int s;
-  for (s = 0; s < pipe_count; s++) {
-    pipe_ptr p = pipes[s];
-    switch (p->op)
-      {
-      case P_BUBBLE:
-      	/* insert a bubble into the next stage */
-      	memcpy(p->current, p->bubble_val, p->count);
-      	break;
-      
-      case P_LOAD:
-      	/* copy calculated state from previous stage */
-      	memcpy(p->current, p->next, p->count);
-      	break;
-      case P_ERROR:
-	  /* Like a bubble, but insert error condition */
-      	memcpy(p->current, p->bubble_val, p->count);
-      	break;
-      case P_STALL:
-      default:
-      	/* do nothing: next stage gets same instr again */
-      	;
-      }
-    if (p->op != P_ERROR)
-	p->op = P_LOAD;
-  }
-}
-
-/* Set all pipes to bubble values */
-void clear_pipes()
-{
-  int s;
-  for (s = 0; s < pipe_count; s++) {
-    pipe_ptr p = pipes[s];
-    memcpy(p->current, p->bubble_val, p->count);
-    memcpy(p->next, p->bubble_val, p->count);
-    p->op = P_LOAD;
-  }
-}
-
-/******************** Utility Code *************************/
-
-/* Representations of digits */
-static char digits[16] =
-   {'0', '1', '2', '3', '4', '5', '6', '7',
-    '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
-
-/* Print hex/oct/binary format with leading zeros */
-/* bpd denotes bits per digit  Should be in range 1-4,
-   pbw denotes bits per word.*/
-void wprint(uword_t x, int bpd, int bpw, FILE *fp)
-{
-  int digit;
-  uword_t mask = ((uword_t) 1 << bpd) - 1;
-  for (digit = (bpw-1)/bpd; digit >= 0; digit--) {
-    uword_t val = (x >> (digit * bpd)) & mask;
-    putc(digits[val], fp);
-  }
-}
-
-/* Create string in hex/oct/binary format with leading zeros */
-/* bpd denotes bits per digit  Should be in range 1-4,
-   pbw denotes bits per word.*/
-void wstring(uword_t x, int bpd, int bpw, char *str)
-{
-  int digit;
-  uword_t mask = ((uword_t) 1 << bpd) - 1;
-  for (digit = (bpw-1)/bpd; digit >= 0; digit--) {
-    uword_t val = (x >> (digit * bpd)) & mask;
-    *str++ = digits[val];
-  }
-  *str = '\0';
-}
-
-
-/********************************
- * Part 5: Stage implementations
- *********************************/
-
-/*************** Bubbled version of stages *************/
-
-pc_ele bubble_pc = {0,STAT_AOK};
-if_id_ele bubble_if_id = { I_NOP, 0, REG_NONE,REG_NONE,
-			   0, 0, STAT_BUB, 0};
-id_ex_ele bubble_id_ex = { I_NOP, 0, 0, 0, 0,
-			   REG_NONE, REG_NONE, REG_NONE, REG_NONE,
-			   STAT_BUB, 0};
-
-ex_mem_ele bubble_ex_mem = { I_NOP, 0, FALSE, 0, 0,
-			     REG_NONE, REG_NONE, STAT_BUB, 0};
-
-mem_wb_ele bubble_mem_wb = { I_NOP, 0, 0, 0, REG_NONE, REG_NONE,
-			     STAT_BUB, 0};
-
-/*************** Stage Implementations *****************/
-
-word_t gen_f_pc();
-word_t gen_need_regids();
-word_t gen_need_valC();
-word_t gen_instr_valid();
-word_t gen_f_predPC();
-word_t gen_f_icode();
-word_t gen_f_ifun();
-word_t gen_f_stat();
-word_t gen_instr_valid();
-
-void do_if_stage()
-{
-    byte_t instr = HPACK(I_NOP, F_NONE);
-    byte_t regids = HPACK(REG_NONE, REG_NONE);
-    word_t valc = 0;
-    word_t valp = f_pc = gen_f_pc();
-
-    /* Ready to fetch instruction.  Speculatively fetch register byte
-       and immediate word
-    */
-    imem_error = !get_byte_val(mem, valp, &instr);
-    imem_icode = HI4(instr);
-    imem_ifun = LO4(instr);
-    if (!imem_error) {
-      byte_t junk;
-      /* Make sure can read maximum length instruction */
-      imem_error = !get_byte_val(mem, valp+5, &junk);
-    }
-    if_id_next->icode = gen_f_icode();
-    if_id_next->ifun  = gen_f_ifun();
-    if (!imem_error) {
-	sim_log("\tFetch: f_pc = 0x%llx, imem_instr = %s, f_instr = %s\n",
-		f_pc, iname(instr),
-		iname(HPACK(if_id_next->icode, if_id_next->ifun)));
+    int i, ncpe = 0;
+    double tcpe = 0.0;
+    mem_t reg0;
+
+    reg0 = init_reg();
+    for (i = 0; i < nfiles; i++) {
+	batch_init(&batch[i], files[i]);
+	sim_ctx_run(batch[i].ctx, instr_limit, 5*instr_limit);
     }
 
-    instr_valid = gen_instr_valid();
-    if (!instr_valid) 
-      sim_log("\tFetch: Instruction code 0x%llx invalid\n", instr);
-    if_id_next->status = gen_f_stat();
-
-    valp++;
-    if (gen_need_regids()) {
-	get_byte_val(mem, valp, &regids);
-	valp ++;
-    }
-    if_id_next->ra = HI4(regids);
-    if_id_next->rb = LO4(regids);
-    if (gen_need_valC()) {
-	get_word_val(mem, valp, &valc);
-	valp+= 8;
+    for (i = 0; i < nfiles; i++) {
+	batch_ptr b = &batch[i];
+	sim_ctx_ptr c = b->ctx;
+	double cpi = c->instructions > 0 ?
+	    (double) c->cycles/c->instructions : 1.0;
+	printf("%s: Status = %s, CPI: %lld cycles/%lld instructions = %.2f",
+	       b->name, stat_name(c->run_status),
+	       c->cycles, c->instructions, cpi);
+	if (b->elements > 0) {
+	    double cpe = (double) c->cycles/b->elements;
+	    printf(", CPE = %.2f", cpe);
+	    tcpe += cpe;
+	    ncpe++;
+	}
+	printf("\n");
+	sim_print_caches(c);
+	if (verbosity > 0) {
+	    printf("Condition Codes: %s\n", cc_name(c->cc));
+	    printf("Changed Register State:\n");
+	    diff_reg(reg0, c->reg, stdout);
+	}
     }
-    if_id_next->valp = valp;
-    if_id_next->valc = valc;
-
-    pc_next->pc = gen_f_predPC();
+    if (ncpe > 0)
+	printf("Average CPE\t%.2f\n", tcpe/ncpe);
+}
 
-    pc_next->status = (if_id_next->status == STAT_AOK) ? STAT_AOK : STAT_BUB;
+/*
+ * ncopy sweep.  The ncopy object file is loaded once, at the
+ * addresses yas assigned it, so ncopy itself must start at address 0.
+ * For each block length, misc/driver.c builds the driver directly in
+ * a copy of that memory.  Its data are not gen-driver.pl's, which come
+ * from Perl's unseeded rand: exactly n/2 of the words are positive,
+ * chosen with rand_r seeded with 1+n, so every sweep of a given ncopy
+ * sees the same blocks.  Each length gets its own simulation context,
+ * and a pool of worker threads takes the lengths one at a time.  The
+ * correctness checks of gen-driver.pl -c are done by driver_check after
+ * the run instead of by checking code in the driver.
+ */
 
-    if_id_next->stage_pc = f_pc;
-}
+/* Result of one block length */
+typedef struct {
+    word_t len;
+    word_t cycles;
+    word_t instructions;
+    driver_result_t result;
+} sweep_rec;
 
-word_t gen_d_srcA();
-word_t gen_d_srcB();
-word_t gen_d_dstE();
-word_t gen_d_dstM();
-word_t gen_d_valA();
-word_t gen_d_valB();
-word_t gen_w_dstE();
-word_t gen_w_valE();
-word_t gen_w_dstM();
-word_t gen_w_valM();
-word_t gen_Stat();
-
-/* Implements both ID and WB */
-void do_id_wb_stages()
-{
-    /* Set up write backs.  Don't occur until end of cycle */
-    wb_destE = gen_w_dstE();
-    wb_valE = gen_w_valE();
-    wb_destM = gen_w_dstM();
-    wb_valM = gen_w_valM();
-
-    /* Update processor status */
-    status = gen_Stat();
-
-    id_ex_next->srca = gen_d_srcA();
-    id_ex_next->srcb = gen_d_srcB();
-    id_ex_next->deste = gen_d_dstE();
-    id_ex_next->destm = gen_d_dstM();
-
-    /* Read the registers */
-    d_regvala = get_reg_val(reg, id_ex_next->srca);
-    d_regvalb = get_reg_val(reg, id_ex_next->srcb);
-
-    /* Do forwarding and valA selection */
-    id_ex_next->vala = gen_d_valA();
-    id_ex_next->valb = gen_d_valB();
-
-    id_ex_next->icode = if_id_curr->icode;
-    id_ex_next->ifun = if_id_curr->ifun;
-    id_ex_next->valc = if_id_curr->valc;
-    id_ex_next->stage_pc = if_id_curr->stage_pc;
-    id_ex_next->status = if_id_curr->status;
-}
+static word_t sweep_code_len;  /* Bytes of ncopy code */
+static mem_t sweep_code;       /* Memory holding just ncopy */
 
-word_t gen_alufun();
-word_t gen_set_cc();
-word_t gen_Bch();
-word_t gen_aluA();
-word_t gen_aluB();
-word_t gen_e_valA();
-word_t gen_e_dstE();
+/* Results of the sweep, and the next block length to be taken */
+static sweep_rec sweep_results[SWEEP_LEN+1];
+static int sweep_next = 0;
 
-void do_ex_stage()
+/*
+ * sweep_worker - Thread that takes block lengths one at a time and
+ * simulates each in a context of its own
+ */
+static void *sweep_worker(void *arg)
 {
-    alu_t alufun = gen_alufun();
-    bool_t setcc = gen_set_cc();
-    word_t alua, alub;
-
-    alua = gen_aluA();
-    alub = gen_aluB();
-
-    e_bcond = 	cond_holds(cc, id_ex_curr->ifun);
-    
-    ex_mem_next->takebranch = e_bcond;
-
-    if (id_ex_curr->icode == I_JMP)
-      sim_log("\tExecute: instr = %s, cc = %s, branch %staken\n",
-	      iname(HPACK(id_ex_curr->icode, id_ex_curr->ifun)),
-	      cc_name(cc),
-	      ex_mem_next->takebranch ? "" : "not ");
-    
-    /* Perform the ALU operation */
-    word_t aluout = compute_alu(alufun, alua, alub);
-    ex_mem_next->vale = aluout;
-    sim_log("\tExecute: ALU: %c 0x%llx 0x%llx --> 0x%llx\n",
-	    op_name(alufun), alua, alub, aluout);
-
-    if (setcc) {
-	cc_in = compute_cc(alufun, alua, alub);
-	sim_log("\tExecute: New cc = %s\n", cc_name(cc_in));
+    int n;
+
+    while ((n = __sync_fetch_and_add(&sweep_next, 1)) <= SWEEP_LEN) {
+	sweep_rec *r = &sweep_results[n];
+	sim_ctx_ptr c;
+	mem_t m = copy_mem(sweep_code);
+	driver_t d;
+
+	driver_build(m, sweep_code_len, n, 1 + n, FALSE, &d);
+	c = sim_ctx_new(m, d.main, &sim_opts);
+	sim_ctx_run(c, instr_limit, 5*instr_limit);
+	r->len = n;
+	r->cycles = c->cycles;
+	r->instructions = c->instructions;
+	r->result = driver_check(c->mem, c->reg, c->run_status, &d,
+				 sweep_code_len, DRIVER_BYTE_LIMIT);
+	sim_ctx_free(c);
     }
-
-    ex_mem_next->icode = id_ex_curr->icode;
-    ex_mem_next->ifun = id_ex_curr->ifun;
-    ex_mem_next->vala = gen_e_valA();
-    ex_mem_next->deste = gen_e_dstE();
-    ex_mem_next->destm = id_ex_curr->destm;
-    ex_mem_next->srca = id_ex_curr->srca;
-    ex_mem_next->status = id_ex_curr->status;
-    ex_mem_next->stage_pc = id_ex_curr->stage_pc;
+    return NULL;
 }
 
-/* Functions defined using HCL */
-word_t gen_mem_addr();
-word_t gen_mem_read();
-word_t gen_mem_write();
-word_t gen_m_stat();
-
-void do_mem_stage()
+/*
+ * run_sweep_sim - Run the ncopy in object file fname on every block
+ * length from 0 to SWEEP_LEN, using nworkers threads, and report
+ * the cycles and correctness of each length and the average CPE
+ */
+static void run_sweep_sim(char *fname, int nworkers)
 {
-    bool_t read = gen_mem_read();
-
-    word_t valm = 0;
-
-    mem_addr = gen_mem_addr();
-    mem_data = ex_mem_curr->vala;
-    mem_write = gen_mem_write();
-    dmem_error = FALSE;
-
-    if (read) {
-	dmem_error = dmem_error || !get_word_val(mem, mem_addr, &valm);
-	if (!dmem_error)
-	  sim_log("\tMemory: Read 0x%llx from 0x%llx\n",
-		  valm, mem_addr);
+    sweep_rec *results = sweep_results;
+    pthread_t workers[SWEEP_LEN+1];
+    int w, i, goodcnt = 0;
+    double tcpe = 0.0;
+    FILE *f;
+
+    if ((f = fopen(fname, "r")) == NULL) {
+	fprintf(stderr, "Couldn't open object file %s\n", fname);
+	exit(1);
     }
-    if (mem_write) {
-	word_t sink;
-	/* Do a read of address just to check validity */
-	dmem_error = dmem_error || !get_word_val(mem, mem_addr, &sink);
-	if (dmem_error)
-	  sim_log("\tMemory: Invalid address 0x%llx\n",
-		  mem_addr);
+    sweep_code = init_mem(mem_size);
+    sweep_code_len = driver_load(sweep_code, f);
+    fclose(f);
+    if (sweep_code_len == 0) {
+	fprintf(stderr, "No lines of code found in %s\n", fname);
+	exit(1);
     }
-    mem_wb_next->icode = ex_mem_curr->icode;
-    mem_wb_next->ifun = ex_mem_curr->ifun;
-    mem_wb_next->vale = ex_mem_curr->vale;
-    mem_wb_next->valm = valm;
-    mem_wb_next->deste = ex_mem_curr->deste;
-    mem_wb_next->destm = ex_mem_curr->destm;
-    mem_wb_next->status = gen_m_stat();
-    mem_wb_next->stage_pc = ex_mem_curr->stage_pc;
-}
-
-/* Set stalling conditions for different stages */
 
-word_t gen_F_stall(), gen_F_bubble();
-word_t gen_D_stall(), gen_D_bubble();
-word_t gen_E_stall(), gen_E_bubble();
-word_t gen_M_stall(), gen_M_bubble();
-word_t gen_W_stall(), gen_W_bubble();
-
-p_stat_t pipe_cntl(char *name, word_t stall, word_t bubble)
-{
-    if (stall) {
-	if (bubble) {
-	    sim_log("%s: Conflicting control signals for pipe register\n",
-		    name);
-	    return P_ERROR;
-	} else 
-	    return P_STALL;
-    } else {
-	return bubble ? P_BUBBLE : P_LOAD;
+    if (nworkers > SWEEP_LEN+1)
+	nworkers = SWEEP_LEN+1;
+    for (w = 0; w < nworkers; w++) {
+	if (pthread_create(&workers[w], NULL, sweep_worker, NULL) != 0) {
+	    fprintf(stderr, "Couldn't start sweep worker\n");
+	    exit(1);
+	}
     }
+    for (w = 0; w < nworkers; w++)
+	pthread_join(workers[w], NULL);
+
+    printf("\t%s\n", fname);
+    for (i = 0; i <= SWEEP_LEN; i++) {
+	sweep_rec *r = &results[i];
+	if (r->result == DRV_OK)
+	    goodcnt++;
+	if (i > 0) {
+	    double cpe = (double) r->cycles/i;
+	    tcpe += cpe;
+	    printf("%d\t%lld\t%.2f\t%s\n", i, r->cycles, cpe,
+		   driver_result_names[r->result]);
+	} else
+	    printf("%d\t%lld\t\t%s\n", i, r->cycles,
+		   driver_result_names[r->result]);
+    }
+    printf("%d/%d pass correctness test\n", goodcnt, SWEEP_LEN+1);
+    printf("Average CPE\t%.2f\n", tcpe/SWEEP_LEN);
 }
-
-void do_stall_check()
-{
-    pc_state->op = pipe_cntl("PC", gen_F_stall(), gen_F_bubble());
-    if_id_state->op = pipe_cntl("ID", gen_D_stall(), gen_D_bubble());
-    id_ex_state->op = pipe_cntl("EX", gen_E_stall(), gen_E_bubble());
-    ex_mem_state->op = pipe_cntl("MEM", gen_M_stall(), gen_M_bubble());
-    mem_wb_state->op = pipe_cntl("WB", gen_W_stall(), gen_W_bubble());
-}
-
-
-
@@ -0,0 +1,796 @@
+/**************************************************************************
+ * psim2.c - Dual-issue pipelined Y86-64 simulator
+ *
+ * A two-wide, in-order version of PIPE with the control logic of
+ * pipe-full.hcl (iaddq, load forwarding into the store data of pushq
+ * and rmmovq, branches predicted taken, fetch stalled while a ret is
+ * in flight).  Each pipeline register holds two slots, slot 0 being
+ * the older instruction.  The stages are written directly in C rather
+ * than generated from HCL, since the pairing and forwarding logic
+ * depends on both slots at once.  Run with -w 1, psim2 takes exactly
+ * the cycles of psim built with VERSION=full.
+ *
+ * Issue rules for the second slot: it issues together with slot 0
+ * only when
+ *   - it reads no register that slot 0 writes,
+ *   - at most one of the two accesses memory (there is one data port),
+ *   - it does not have to wait on a load in execute.
+ * A conditional jump or conditional move in slot 1 sees the condition
+ * codes set by slot 0, forwarded within the execute stage.  Fetch
+ * delivers up to two sequential instructions per cycle, and stops
+ * after a jump, call, ret, halt or faulting instruction.
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "isa.h"
+
+#define WIDTH 2
+
+/* psim2 never runs in GUI mode */
+int gui_mode = 0;
+
+/***************
+ * Begin Globals
+ ***************/
+
+/* Parameters modified by the command line */
+int width = WIDTH;          /* Instructions fetched and issued per cycle (-w) */
+int verbosity = 2;          /* Verbosity level (-v) */
+word_t instr_limit = 10000; /* Instruction limit (-l) */
+bool_t do_check = FALSE;    /* Test with ISA simulator? (-t) */
+word_t mem_size = MEM_SIZE; /* Memory size in bytes (-m) */
+
+/* One instruction in a pipeline register */
+typedef struct {
+    stat_t stat;        /* STAT_BUB for an empty slot */
+    byte_t icode;
+    byte_t ifun;
+    byte_t ra;
+    byte_t rb;
+    word_t valc;
+    word_t valp;
+    word_t pc;
+    /* Filled in by decode */
+    byte_t srca, srcb;
+    byte_t deste, destm;
+    word_t vala, valb;
+    /* Filled in by execute */
+    bool_t cnd;
+    word_t vale;
+    bool_t setcc;       /* Set the condition codes, which were oldcc */
+    cc_t oldcc;
+    /* Filled in by memory */
+    word_t valm;
+} slot_t;
+
+/* Program-visible state */
+static mem_t mem;
+static mem_t reg;
+static cc_t cc = DEFAULT_CC;
+
+/* Pipeline registers: predicted PC, then two slots per stage */
+static word_t f_predpc = 0;
+static slot_t D[WIDTH], E[WIDTH], M[WIDTH], W[WIDTH];
+
+/* Set when a mispredicted jump leaves execute: fetch at redirect_pc */
+static bool_t redirect = FALSE;
+static word_t redirect_pc = 0;
+
+/* Performance counters */
+static word_t cycles = 0;
+static word_t instructions = 0;
+static int starting_up = 1;
+static word_t issue_cycles = 0;     /* Cycles that issued any instruction */
+static word_t dual_cycles = 0;      /* Cycles that issued two instructions */
+/* Why slot 1 did not issue along with slot 0 */
+typedef enum { NP_EMPTY, NP_DEPEND, NP_MEMORY, NP_LOAD_USE, NUM_NP } nopair_t;
+static char *nopair_names[NUM_NP] =
+    { "no instruction", "register dependence", "two memory accesses",
+      "load/use" };
+static word_t nopair[NUM_NP];
+
+/*************
+ * End Globals
+ *************/
+
+static slot_t bubble = { STAT_BUB, I_NOP, F_NONE, REG_NONE, REG_NONE, 0, 0, 0,
+			 REG_NONE, REG_NONE, REG_NONE, REG_NONE };
+
+static bool_t is_mem_op(byte_t icode)
+{
+    return icode == I_RMMOVQ || icode == I_MRMOVQ || icode == I_PUSHQ ||
+	icode == I_POPQ || icode == I_CALL || icode == I_RET;
+}
+
+static bool_t is_error(stat_t s)
+{
+    return s == STAT_ADR || s == STAT_INS || s == STAT_HLT;
+}
+
+static void trace(const char *format, ...)
+    __attribute__((format(printf, 1, 2)));
+
+static void trace(const char *format, ...)
+{
+    if (verbosity >= 2) {
+	va_list arg;
+	va_start(arg, format);
+	vprintf(format, arg);
+	va_end(arg);
+    }
+}
+
+/*********************************
+ * Stages, as combinational logic
+ *********************************/
+
+/*
+ * Decode register fields, as d_srcA, d_srcB, d_dstE and d_dstM in
+ * pipe-full.hcl
+ */
+static void decode_regs(slot_t *s)
+{
+    switch (s->icode) {
+    case I_RRMOVQ: case I_RMMOVQ: case I_ALU: case I_PUSHQ:
+	s->srca = s->ra; break;
+    case I_POPQ: case I_RET:
+	s->srca = REG_RSP; break;
+    default:
+	s->srca = REG_NONE; break;
+    }
+    switch (s->icode) {
+    case I_ALU: case I_RMMOVQ: case I_MRMOVQ: case I_IADDQ:
+	s->srcb = s->rb; break;
+    case I_PUSHQ: case I_POPQ: case I_CALL: case I_RET:
+	s->srcb = REG_RSP; break;
+    default:
+	s->srcb = REG_NONE; break;
+    }
+    switch (s->icode) {
+    case I_RRMOVQ: case I_IRMOVQ: case I_ALU: case I_IADDQ:
+	s->deste = s->rb; break;
+    case I_PUSHQ: case I_POPQ: case I_CALL: case I_RET:
+	s->deste = REG_RSP; break;
+    default:
+	s->deste = REG_NONE; break;
+    }
+    s->destm = (s->icode == I_MRMOVQ || s->icode == I_POPQ) ?
+	s->ra : REG_NONE;
+}
+
+/* Must slot s wait for a load now in execute? */
+static bool_t load_use(slot_t *s)
+{
+    int i;
+    for (i = 0; i < width; i++) {
+	slot_t *e = &E[i];
+	if (e->stat != STAT_BUB &&
+	    (e->icode == I_MRMOVQ || e->icode == I_POPQ) &&
+	    (e->destm == s->srcb ||
+	     (e->destm == s->srca &&
+	      s->icode != I_PUSHQ && s->icode != I_RMMOVQ)))
+	    return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Value of register r as seen by decode, forwarded from the youngest
+ * producer in execute (ex holds the slots just executed) or memory.
+ * Write-back has already updated the register file.
+ */
+static word_t forward(byte_t r, slot_t *ex, slot_t *mem_out)
+{
+    int i;
+    if (r == REG_NONE)
+	return 0;
+    for (i = width-1; i >= 0; i--)
+	if (ex[i].stat != STAT_BUB && ex[i].deste == r)
+	    return ex[i].vale;
+    for (i = width-1; i >= 0; i--) {
+	if (mem_out[i].stat == STAT_BUB)
+	    continue;
+	if (mem_out[i].destm == r)
+	    return mem_out[i].valm;
+	if (mem_out[i].deste == r)
+	    return mem_out[i].vale;
+    }
+    return get_reg_val(reg, r);
+}
+
+/*
+ * Instructions past the instruction limit must not change the
+ * program-visible state.  room is how many more may complete.
+ */
+static word_t room = 0;
+
+/* Write-back.  Return the status of the processor */
+static stat_t do_wb_stage(word_t *completed)
+{
+    int i;
+    *completed = 0;
+    for (i = 0; i < width; i++) {
+	slot_t *w = &W[i];
+	if (w->stat == STAT_BUB || *completed >= room)
+	    continue;
+	(*completed)++;
+	if (w->stat != STAT_AOK)
+	    return w->stat;
+	if (w->deste != REG_NONE) {
+	    trace("\tWriteback: Wrote 0x%llx to register %s\n",
+		  w->vale, reg_name(w->deste));
+	    set_reg_val(reg, w->deste, w->vale);
+	}
+	if (w->destm != REG_NONE) {
+	    trace("\tWriteback: Wrote 0x%llx to register %s\n",
+		  w->valm, reg_name(w->destm));
+	    set_reg_val(reg, w->destm, w->valm);
+	}
+    }
+    return STAT_AOK;
+}
+
+/*
+ * Memory.  Fills out[] with the slots bound for W.  A write is held in
+ * waddr and wdata until the end of the cycle.  When an instruction
+ * faults here, a younger one that executed alongside it may already
+ * have set the condition codes, so those are rolled back.
+ */
+static bool_t do_mem_stage(slot_t *out, bool_t w_error,
+			   word_t *waddr, word_t *wdata)
+{
+    bool_t write = FALSE;
+    bool_t older_error = FALSE;
+    bool_t rolled_back = FALSE;
+    word_t ahead = 0;
+    int i;
+
+    for (i = 0; i < width; i++)
+	ahead += W[i].stat != STAT_BUB;
+
+    for (i = 0; i < width; i++) {
+	slot_t *m = &M[i];
+	word_t addr = 0;
+	bool_t read = FALSE, wr = FALSE, err = FALSE;
+
+	out[i] = *m;
+	if (m->stat == STAT_BUB)
+	    continue;
+	if (older_error) {
+	    if (m->setcc && !rolled_back) {
+		cc = m->oldcc;
+		rolled_back = TRUE;
+	    }
+	    out[i] = bubble;
+	    continue;
+	}
+	switch (m->icode) {
+	case I_RMMOVQ: case I_PUSHQ: case I_CALL:
+	    addr = m->vale; wr = TRUE; break;
+	case I_MRMOVQ:
+	    addr = m->vale; read = TRUE; break;
+	case I_POPQ: case I_RET:
+	    addr = m->vala; read = TRUE; break;
+	default:
+	    break;
+	}
+	out[i].valm = 0;
+	if (read) {
+	    err = !get_word_val(mem, addr, &out[i].valm);
+	    if (!err)
+		trace("\tMemory: Read 0x%llx from 0x%llx\n", out[i].valm, addr);
+	}
+	if (wr) {
+	    word_t sink;
+	    err = !get_word_val(mem, addr, &sink);
+	    if (!err && !w_error && ahead < room) {
+		write = TRUE;
+		*waddr = addr;
+		*wdata = m->vala;
+	    }
+	}
+	if (err) {
+	    trace("\tMemory: Invalid address 0x%llx\n", addr);
+	    out[i].stat = STAT_ADR;
+	}
+	older_error = is_error(out[i].stat);
+	ahead++;
+    }
+    return write;
+}
+
+/*
+ * Execute.  Fills out[] with the slots bound for M and sets *new_cc.
+ * Returns TRUE if a jump was mispredicted, squashing what follows it.
+ */
+static bool_t do_ex_stage(slot_t *out, slot_t *mem_out, bool_t w_error,
+			  cc_t *new_cc)
+{
+    bool_t cc_ok = !w_error;
+    bool_t squash = FALSE;
+    cc_t ecc = cc;
+    word_t ahead = 0;
+    int i;
+
+    for (i = 0; i < width; i++) {
+	if (is_error(mem_out[i].stat))
+	    cc_ok = FALSE;
+	ahead += (W[i].stat != STAT_BUB) + (M[i].stat != STAT_BUB);
+    }
+
+    for (i = 0; i < width; i++) {
+	slot_t *e = &E[i];
+	word_t alua, alub;
+	alu_t alufun = A_ADD;
+
+	out[i] = *e;
+	if (e->stat == STAT_BUB)
+	    continue;
+	if (squash) {
+	    out[i] = bubble;
+	    continue;
+	}
+	switch (e->icode) {
+	case I_RRMOVQ: case I_ALU:
+	    alua = e->vala; break;
+	case I_IRMOVQ: case I_RMMOVQ: case I_MRMOVQ: case I_IADDQ:
+	    alua = e->valc; break;
+	case I_CALL: case I_PUSHQ:
+	    alua = -8; break;
+	case I_RET: case I_POPQ:
+	    alua = 8; break;
+	default:
+	    alua = 0; break;
+	}
+	switch (e->icode) {
+	case I_RMMOVQ: case I_MRMOVQ: case I_ALU: case I_CALL:
+	case I_PUSHQ: case I_RET: case I_POPQ: case I_IADDQ:
+	    alub = e->valb; break;
+	default:
+	    alub = 0; break;
+	}
+	if (e->icode == I_ALU)
+	    alufun = e->ifun;
+
+	/* Conditions see the codes set by an older slot this cycle */
+	out[i].cnd = cond_holds(ecc, e->ifun);
+	out[i].vale = compute_alu(alufun, alua, alub);
+	trace("\tExecute: ALU: %c 0x%llx 0x%llx --> 0x%llx\n",
+	      op_name(alufun), alua, alub, out[i].vale);
+	if ((e->icode == I_ALU || e->icode == I_IADDQ) && cc_ok &&
+	    e->stat == STAT_AOK && ahead < room) {
+	    out[i].setcc = TRUE;
+	    out[i].oldcc = ecc;
+	    ecc = compute_cc(alufun, alua, alub);
+	    trace("\tExecute: New cc = %s\n", cc_name(ecc));
+	}
+	if (e->icode == I_RRMOVQ && !out[i].cnd)
+	    out[i].deste = REG_NONE;
+
+	/* Load forwarding into the data of a store, unless a younger
+	   instruction in memory writes the register too */
+	if ((e->icode == I_PUSHQ || e->icode == I_RMMOVQ) &&
+	    e->srca != REG_NONE) {
+	    int j;
+	    for (j = width-1; j >= 0; j--) {
+		if (mem_out[j].stat == STAT_BUB)
+		    continue;
+		if (mem_out[j].destm == e->srca)
+		    out[i].vala = mem_out[j].valm;
+		if (mem_out[j].destm == e->srca || mem_out[j].deste == e->srca)
+		    break;
+	    }
+	}
+
+	if (e->icode == I_JMP) {
+	    trace("\tExecute: instr = %s, cc = %s, branch %staken\n",
+		  iname(HPACK(e->icode, e->ifun)), cc_name(ecc),
+		  out[i].cnd ? "" : "not ");
+	    if (!out[i].cnd) {
+		squash = TRUE;
+		redirect_pc = e->vala;
+	    }
+	}
+	/* Once a fault reaches here, younger slots may not set the codes */
+	if (is_error(e->stat))
+	    cc_ok = FALSE;
+	ahead++;
+    }
+    *new_cc = ecc;
+    return squash;
+}
+
+/*
+ * Decode and issue up to width instructions from D into out[], reading
+ * operands with forwarding.  Return the number issued.
+ */
+static int do_id_stage(slot_t *out, slot_t *ex_out, slot_t *mem_out)
+{
+    int n = 0;
+    int i;
+
+    for (i = 0; i < width; i++)
+	out[i] = bubble;
+    for (i = 0; i < width; i++) {
+	slot_t s = D[i];
+	nopair_t why = NUM_NP;
+
+	if (s.stat == STAT_BUB) {
+	    why = NP_EMPTY;
+	} else {
+	    decode_regs(&s);
+	    if (load_use(&s)) {
+		why = NP_LOAD_USE;
+	    } else if (i > 0) {
+		slot_t *o = &out[0];
+		if ((s.srca != REG_NONE &&
+		     (s.srca == o->deste || s.srca == o->destm)) ||
+		    (s.srcb != REG_NONE &&
+		     (s.srcb == o->deste || s.srcb == o->destm)))
+		    why = NP_DEPEND;
+		else if (is_mem_op(s.icode) && is_mem_op(o->icode))
+		    why = NP_MEMORY;
+	    }
+	}
+	if (why != NUM_NP) {
+	    if (i > 0)
+		nopair[why]++;
+	    break;
+	}
+	if (s.icode == I_CALL || s.icode == I_JMP)
+	    s.vala = s.valp;
+	else
+	    s.vala = forward(s.srca, ex_out, mem_out);
+	s.valb = forward(s.srcb, ex_out, mem_out);
+	out[n++] = s;
+    }
+    return n;
+}
+
+/* Fetch one instruction at pc into s.  Return the predicted next PC */
+static word_t fetch_one(word_t pc, slot_t *s)
+{
+    byte_t instr = HPACK(I_NOP, F_NONE);
+    byte_t regids = HPACK(REG_NONE, REG_NONE);
+    word_t valp = pc;
+    bool_t imem_error, valid;
+    byte_t junk;
+
+    *s = bubble;
+    s->pc = pc;
+    imem_error = !get_byte_val(mem, valp, &instr) ||
+	!get_byte_val(mem, valp+5, &junk);
+    s->icode = imem_error ? I_NOP : HI4(instr);
+    s->ifun = imem_error ? F_NONE : LO4(instr);
+    valid = s->icode <= I_IADDQ;
+    if (!imem_error)
+	trace("\tFetch: f_pc = 0x%llx, imem_instr = %s\n", pc, iname(instr));
+    s->stat = imem_error ? STAT_ADR : !valid ? STAT_INS :
+	s->icode == I_HALT ? STAT_HLT : STAT_AOK;
+    valp++;
+    switch (s->icode) {
+    case I_RRMOVQ: case I_ALU: case I_PUSHQ: case I_POPQ:
+    case I_IRMOVQ: case I_RMMOVQ: case I_MRMOVQ: case I_IADDQ:
+	get_byte_val(mem, valp, &regids);
+	valp++;
+	break;
+    default:
+	break;
+    }
+    s->ra = HI4(regids);
+    s->rb = LO4(regids);
+    switch (s->icode) {
+    case I_IRMOVQ: case I_RMMOVQ: case I_MRMOVQ: case I_JMP:
+    case I_CALL: case I_IADDQ:
+	get_word_val(mem, valp, &s->valc);
+	valp += 8;
+	break;
+    default:
+	break;
+    }
+    s->valp = valp;
+    return (s->icode == I_JMP || s->icode == I_CALL) ? s->valc : valp;
+}
+
+/* Does fetch stop after this instruction? */
+static bool_t ends_group(slot_t *s)
+{
+    return s->stat != STAT_AOK || s->icode == I_JMP || s->icode == I_CALL ||
+	s->icode == I_RET;
+}
+
+static bool_t holds_ret(slot_t *stage)
+{
+    int i;
+    for (i = 0; i < width; i++)
+	if (stage[i].stat != STAT_BUB && stage[i].icode == I_RET)
+	    return TRUE;
+    return FALSE;
+}
+
+/*****************
+ * Cycle control
+ *****************/
+
+static char *slot_name(slot_t *s)
+{
+    return s->stat == STAT_BUB ? "----" : iname(HPACK(s->icode, s->ifun));
+}
+
+static void trace_stage(char *name, slot_t *stage)
+{
+    int i;
+    trace("%s:", name);
+    for (i = 0; i < width; i++)
+	if (stage[i].stat == STAT_BUB)
+	    trace("  [----]");
+	else
+	    trace("  [%s @0x%llx, %s]", slot_name(&stage[i]), stage[i].pc,
+		  stat_name(stage[i].stat));
+    trace("\n");
+}
+
+/* Simulate one cycle.  Return the status of the processor */
+static stat_t step_pipe(word_t ccount)
+{
+    slot_t m_out[WIDTH], e_out[WIDTH], d_out[WIDTH], d_next[WIDTH];
+    word_t completed, waddr = 0, wdata = 0;
+    bool_t w_error, write, squash;
+    cc_t new_cc;
+    stat_t status;
+    word_t pc;
+    int i, issued, left, nfetch;
+    bool_t ret_wait;
+
+    trace("\nCycle %lld. CC=%s\n", ccount, cc_name(cc));
+    trace("F: predPC = 0x%llx\n", f_predpc);
+    trace_stage("D", D);
+    trace_stage("E", E);
+    trace_stage("M", M);
+    trace_stage("W", W);
+
+    /* Fetch address: a mispredicted jump, then a completing ret */
+    pc = f_predpc;
+    if (redirect)
+	pc = redirect_pc;
+    else
+	for (i = 0; i < width; i++)
+	    if (W[i].stat == STAT_AOK && W[i].icode == I_RET)
+		pc = W[i].valm;
+    redirect = FALSE;
+
+    room = instr_limit - instructions;
+    status = do_wb_stage(&completed);
+    w_error = status != STAT_AOK;
+    write = do_mem_stage(m_out, w_error, &waddr, &wdata);
+    squash = do_ex_stage(e_out, m_out, w_error, &new_cc);
+    issued = squash ? 0 : do_id_stage(d_out, e_out, m_out);
+    if (squash) {
+	for (i = 0; i < width; i++)
+	    d_out[i] = bubble;
+	redirect = TRUE;
+    }
+    if (issued > 0)
+	issue_cycles++;
+    if (issued == width && width > 1)
+	dual_cycles++;
+
+    /* Instructions left in decode move up; fetch fills in behind */
+    left = 0;
+    for (i = 0; i < width; i++)
+	d_next[i] = bubble;
+    if (!squash)
+	for (i = issued; i < width; i++)
+	    if (D[i].stat != STAT_BUB)
+		d_next[left++] = D[i];
+    ret_wait = holds_ret(D) || holds_ret(E) || holds_ret(M);
+    nfetch = 0;
+    if (!squash && !ret_wait) {
+	word_t next_pc = pc;
+	for (i = left; i < width; i++) {
+	    next_pc = fetch_one(pc, &d_next[i]);
+	    nfetch++;
+	    if (ends_group(&d_next[i]))
+		break;
+	    pc = next_pc;
+	}
+	pc = next_pc;
+    }
+    if (nfetch > 0 || redirect)
+	f_predpc = redirect ? redirect_pc : pc;
+    else if (!ret_wait && left == width)
+	f_predpc = pc;
+
+    /* Clock the state elements and pipeline registers */
+    if (write) {
+	set_word_val(mem, waddr, wdata);
+	trace("\tWrote 0x%llx to address 0x%llx\n", wdata, waddr);
+    }
+    cc = new_cc;
+    for (i = 0; i < width; i++) {
+	bool_t m_error = FALSE;
+	int j;
+	for (j = 0; j < width; j++)
+	    m_error = m_error || is_error(m_out[j].stat);
+	W[i] = m_out[i];
+	/* Faulting instructions in M or W keep younger ones out of M */
+	M[i] = (m_error || w_error) ? bubble : e_out[i];
+	E[i] = d_out[i];
+	D[i] = d_next[i];
+    }
+
+    /* Performance monitoring, as in psim */
+    if (completed > 0) {
+	starting_up = 0;
+	instructions += completed;
+	cycles++;
+    } else if (!starting_up)
+	cycles++;
+    return status;
+}
+
+/*
+ * Run until an error status reaches write-back, instr_limit
+ * instructions complete, or 5*instr_limit cycles pass
+ */
+static stat_t run_pipe()
+{
+    word_t ccount = 0;
+    stat_t status = STAT_AOK;
+    int i;
+
+    for (i = 0; i < WIDTH; i++)
+	D[i] = E[i] = M[i] = W[i] = bubble;
+    while (instructions < instr_limit && ccount < 5*instr_limit) {
+	status = step_pipe(ccount++);
+	if (status != STAT_AOK)
+	    break;
+    }
+    return status;
+}
+
+static void usage(char *name)
+{
+    printf("Usage: %s [-ht] [-w n] [-l m] [-v n] [-m s] file.yo\n", name);
+    printf("   -h     Print this message\n");
+    printf("   -w n   Fetch and issue up to n instructions per cycle, 1 <= n <= %d (default %d)\n",
+	   WIDTH, WIDTH);
+    printf("   -l m   Set instruction limit to m (default %lld)\n", instr_limit);
+    printf("   -v n   Set verbosity level to 0 <= n <= 2 (default %d)\n", verbosity);
+    printf("   -t     Test result against ISA simulator\n");
+    printf("   -m s   Set memory size to s bytes, with optional K/M/G suffix (default %d)\n", MEM_SIZE);
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *object_file;
+    mem_t mem0, reg0;
+    state_ptr isa_state = NULL;
+    stat_t run_status;
+    int c, i;
+
+    while ((c = getopt(argc, argv, "htw:l:v:m:")) != -1) {
+	switch(c) {
+	case 'h':
+	    usage(argv[0]);
+	    break;
+	case 'w':
+	    width = atoi(optarg);
+	    if (width < 1 || width > WIDTH) {
+		printf("Invalid width %d\n", width);
+		usage(argv[0]);
+	    }
+	    break;
+	case 'l':
+	    instr_limit = atoll(optarg);
+	    break;
+	case 'v':
+	    verbosity = atoi(optarg);
+	    if (verbosity < 0 || verbosity > 2) {
+		printf("Invalid verbosity %d\n", verbosity);
+		usage(argv[0]);
+	    }
+	    break;
+	case 't':
+	    do_check = TRUE;
+	    break;
+	case 'm':
+	    mem_size = parse_mem_size(optarg);
+	    if (mem_size <= 0) {
+		printf("Invalid memory size '%s'\n", optarg);
+		usage(argv[0]);
+	    }
+	    break;
+	default:
+	    printf("Invalid option '%c'\n", c);
+	    usage(argv[0]);
+	    break;
+	}
+    }
+    if (optind < argc - 1)
+	usage(argv[0]);
+    object_file = stdin;
+    if (optind < argc && (object_file = fopen(argv[optind], "r")) == NULL) {
+	fprintf(stderr, "Couldn't open object file %s\n", argv[optind]);
+	exit(1);
+    }
+
+    mem = init_mem(mem_size);
+    reg = init_reg();
+    if (verbosity >= 2)
+	printf("Y86-64 Processor: dual-issue, width %d\n", width);
+    if (load_mem(mem, object_file, 1) == 0) {
+	fprintf(stderr, "No lines of code found\n");
+	exit(1);
+    }
+    fclose(object_file);
+    if (do_check) {
+	isa_state = new_state(0);
+	free_mem(isa_state->r);
+	free_mem(isa_state->m);
+	isa_state->m = copy_mem(mem);
+	isa_state->r = copy_mem(reg);
+	isa_state->cc = cc;
+    }
+    mem0 = copy_mem(mem);
+    reg0 = copy_mem(reg);
+
+    run_status = run_pipe();
+    if (verbosity > 0) {
+	printf("%lld instructions executed\n", instructions);
+	printf("Status = %s\n", stat_name(run_status));
+	printf("Condition Codes: %s\n", cc_name(cc));
+	printf("Changed Register State:\n");
+	diff_reg(reg0, reg, stdout);
+	printf("Changed Memory State:\n");
+	diff_mem(mem0, mem, stdout);
+    }
+    if (do_check) {
+	stat_t e = STAT_AOK;
+	word_t step;
+	bool_t match = TRUE;
+
+	for (step = 0; step < instr_limit && e == STAT_AOK; step++)
+	    e = step_state(isa_state, stdout);
+	if (diff_reg(isa_state->r, reg, NULL)) {
+	    match = FALSE;
+	    if (verbosity > 0) {
+		printf("ISA Register != Pipeline Register File\n");
+		diff_reg(isa_state->r, reg, stdout);
+	    }
+	}
+	if (diff_mem(isa_state->m, mem, NULL)) {
+	    match = FALSE;
+	    if (verbosity > 0) {
+		printf("ISA Memory != Pipeline Memory\n");
+		diff_mem(isa_state->m, mem, stdout);
+	    }
+	}
+	if (isa_state->cc != cc) {
+	    match = FALSE;
+	    if (verbosity > 0)
+		printf("ISA Cond. Codes (%s) != Pipeline Cond. Codes (%s)\n",
+		       cc_name(isa_state->cc), cc_name(cc));
+	}
+	printf(match ? "ISA Check Succeeds\n" : "ISA Check Fails\n");
+    }
+
+    printf("CPI: %lld cycles/%lld instructions = %.2f\n", cycles, instructions,
+	   instructions > 0 ? (double) cycles/instructions : 1.0);
+    printf("IPC: %.2f, dual issue in %lld of %lld issuing cycles = %.1f%%\n",
+	   cycles > 0 ? (double) instructions/cycles : 0.0,
+	   dual_cycles, issue_cycles,
+	   issue_cycles > 0 ? 100.0*dual_cycles/issue_cycles : 0.0);
+    if (width > 1) {
+	printf("Second slot held back by:\n");
+	for (i = 0; i < NUM_NP; i++)
+	    printf("  %-20s %8lld\n", nopair_names[i], nopair[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,1947 @@
+/**************************************************************************
+ * sim.c - Core of the pipelined Y86-64 simulator
+ *
+ * Copyright (c) 2010, 2015. Bryant and D. O'Hallaron, All rights reserved.
+ * May not be used, modified, or copied without permission.
+ **************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "isa.h"
+#include "pipeline.h"
+#include "stages.h"
+#include "sim.h"
+#include "trace.h"
+
+#ifdef HCL_INLINE
+/* Control logic generated by hcl2c -i, compiled into this unit so
+   that the gen_ functions can be inlined into the pipeline stages */
+#include HCL_INLINE
+#endif
+
+#define MAXBUF 1024
+
+/* Simulator name defined and initialized by the compiled HCL file */
+/* according to the -n argument supplied to hcl2c */
+extern  char simname[];
+
+/* The context being simulated by this thread (see sim.h) */
+SIM_TLS sim_ctx_ptr sim_cur = NULL;
+
+
+/**************************************************************
+ * Part 1: Code for implementing pipelined processor simulators
+ *************************************************************/
+
+/* Set up pipe p with count bytes of state */
+/* bubble_val indicates state corresponding to pipeline bubble */
+void init_pipe(pipe_ptr p, int count, void *bubble_val)
+{
+  p->current = malloc(count);
+  p->next = malloc(count);
+  memcpy(p->current, bubble_val, count);
+  memcpy(p->next, bubble_val, count);
+  p->count = count;
+  p->op = P_LOAD;
+  p->bubble_val = bubble_val;
+}
+
+/* Free the state of pipe p */
+void free_pipe(pipe_ptr p)
+{
+  free(p->current);
+  free(p->next);
+}
+
+/* Update the n pipes in array pipes */
+void update_pipes(pipe_ptr pipes, int n)
+{
+  int s;
+  for (s = 0; s < n; s++) {
+    pipe_ptr p = &pipes[s];
+    switch (p->op)
+      {
+      case P_BUBBLE:
+      	/* insert a bubble into the next stage */
+      	memcpy(p->current, p->bubble_val, p->count);
+      	break;
+
+      case P_LOAD:
+      	/* calculated state from previous stage becomes current.
+	   Every stage rewrites all of its next state each cycle,
+	   so the old current slot can be reused for it */
+      	{
+	  void *t = p->current;
+	  p->current = p->next;
+	  p->next = t;
+	}
+      	break;
+      case P_ERROR:
+	  /* Like a bubble, but insert error condition */
+      	memcpy(p->current, p->bubble_val, p->count);
+      	break;
+      case P_STALL:
+      default:
+      	/* do nothing: next stage gets same instr again */
+      	;
+      }
+    if (p->op != P_ERROR)
+	p->op = P_LOAD;
+  }
+}
+
+/* Set the n pipes in array pipes to bubble values */
+void clear_pipes(pipe_ptr pipes, int n)
+{
+  int s;
+  for (s = 0; s < n; s++) {
+    pipe_ptr p = &pipes[s];
+    memcpy(p->current, p->bubble_val, p->count);
+    memcpy(p->next, p->bubble_val, p->count);
+    p->op = P_LOAD;
+  }
+}
+
+/******************** Utility Code *************************/
+
+/* Representations of digits */
+static char digits[16] =
+   {'0', '1', '2', '3', '4', '5', '6', '7',
+    '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'};
+
+/* Print hex/oct/binary format with leading zeros */
+/* bpd denotes bits per digit  Should be in range 1-4,
+   pbw denotes bits per word.*/
+void wprint(uword_t x, int bpd, int bpw, FILE *fp)
+{
+  int digit;
+  uword_t mask = ((uword_t) 1 << bpd) - 1;
+  for (digit = (bpw-1)/bpd; digit >= 0; digit--) {
+    uword_t val = (x >> (digit * bpd)) & mask;
+    putc(digits[val], fp);
+  }
+}
+
+/* Create string in hex/oct/binary format with leading zeros */
+/* bpd denotes bits per digit  Should be in range 1-4,
+   pbw denotes bits per word.*/
+void wstring(uword_t x, int bpd, int bpw, char *str)
+{
+  int digit;
+  uword_t mask = ((uword_t) 1 << bpd) - 1;
+  for (digit = (bpw-1)/bpd; digit >= 0; digit--) {
+    uword_t val = (x >> (digit * bpd)) & mask;
+    *str++ = digits[val];
+  }
+  *str = '\0';
+}
+
+/*
+ * sim_log dumps a formatted string to the log of the context being
+ * simulated, if it has one.  accepts variable argument list
+ */
+void sim_log( const char *format, ... ) {
+    if (sim_cur && sim_cur->opts.log) {
+	va_list arg;
+	va_start( arg, format );
+	vfprintf( sim_cur->opts.log, format, arg );
+	va_end( arg );
+    }
+}
+
+
+/*********************************************************************
+ * Part 2: Models beyond the pipeline itself: caches, branch
+ * predictors, the lost cycle profile, and the lockstep ISA check
+ *********************************************************************/
+
+/*
+ * L1 caches (-I, -D).  Each cache is set-associative with LRU
+ * replacement and allocates on both reads and writes.  A hit takes
+ * hit_cycles and a miss miss_cycles; the first cycle is the one the
+ * pipeline already allows for the stage.  For each extra cycle the
+ * access is held in place with the ordinary pipe register controls:
+ * an instruction fetch stalls F and bubbles D, and a data access in
+ * the memory stage stalls F, D, E and M and bubbles W.
+ */
+typedef struct cache_rec {
+    cache_cfg_rec cfg;
+    int sets;
+    int block_bits;
+    word_t *tags;       /* Block number held by each way, -1 if invalid */
+    word_t *used;       /* Time of last use of each way */
+    word_t clock;
+    word_t accesses;
+    word_t misses;
+    /* Access in progress */
+    bool_t busy;
+    word_t busy_addr;
+    int wait;           /* Extra cycles still to go */
+} cache_rec, *cache_ptr;
+
+/* Is x a power of two? */
+static bool_t is_pow2(word_t x)
+{
+    return x > 0 && (x & (x-1)) == 0;
+}
+
+bool_t sim_parse_cache(char *spec, cache_cfg_rec *cfg)
+{
+    char buf[MAXBUF];
+    char *field[5];
+    int n = 0;
+    char *s;
+
+    strncpy(buf, spec, MAXBUF-1);
+    buf[MAXBUF-1] = '\0';
+    for (s = strtok(buf, ":"); s && n < 5; s = strtok(NULL, ":"))
+	field[n++] = s;
+    if (n < 3 || s)
+	return FALSE;
+    cfg->size = parse_mem_size(field[0]);
+    cfg->assoc = atoi(field[1]);
+    cfg->block = atoi(field[2]);
+    cfg->hit_cycles = n > 3 ? atoi(field[3]) : CACHE_HIT;
+    cfg->miss_cycles = n > 4 ? atoi(field[4]) : CACHE_MISS;
+    return cfg->assoc > 0 && is_pow2(cfg->block) &&
+	cfg->size >= (word_t) cfg->assoc * cfg->block &&
+	is_pow2(cfg->size / ((word_t) cfg->assoc * cfg->block)) &&
+	cfg->size % ((word_t) cfg->assoc * cfg->block) == 0 &&
+	cfg->hit_cycles > 0 && cfg->miss_cycles >= cfg->hit_cycles;
+}
+
+/* Empty the cache and clear its statistics */
+static void reset_cache(cache_ptr c)
+{
+    int i;
+    for (i = 0; i < c->sets * c->cfg.assoc; i++) {
+	c->tags[i] = -1;
+	c->used[i] = 0;
+    }
+    c->clock = 0;
+    c->accesses = c->misses = 0;
+    c->busy = FALSE;
+    c->wait = 0;
+}
+
+static cache_ptr new_cache(cache_cfg_rec *cfg)
+{
+    cache_ptr c = calloc(1, sizeof(cache_rec));
+    c->cfg = *cfg;
+    c->sets = cfg->size / ((word_t) cfg->assoc * cfg->block);
+    for (c->block_bits = 0; (1 << c->block_bits) < cfg->block; c->block_bits++)
+	;
+    c->tags = calloc(c->sets * cfg->assoc, sizeof(word_t));
+    c->used = calloc(c->sets * cfg->assoc, sizeof(word_t));
+    reset_cache(c);
+    return c;
+}
+
+static void free_cache(cache_ptr c)
+{
+    if (!c)
+	return;
+    free(c->tags);
+    free(c->used);
+    free(c);
+}
+
+/* Look up one block, filling it on a miss.  Return the latency */
+static int cache_lookup(cache_ptr c, word_t block)
+{
+    int set = block & (c->sets - 1);
+    word_t *tags = &c->tags[set * c->cfg.assoc];
+    word_t *used = &c->used[set * c->cfg.assoc];
+    int w, victim = 0;
+
+    c->accesses++;
+    c->clock++;
+    for (w = 0; w < c->cfg.assoc; w++) {
+	if (tags[w] == block) {
+	    used[w] = c->clock;
+	    return c->cfg.hit_cycles;
+	}
+	if (used[w] < used[victim])
+	    victim = w;
+    }
+    c->misses++;
+    tags[victim] = block;
+    used[victim] = c->clock;
+    return c->cfg.miss_cycles;
+}
+
+/*
+ * cache_wait - Access len bytes at addr, unless that access is already
+ * in progress.  Return TRUE if it needs another cycle.  An access that
+ * spans two blocks looks both up and takes the longer latency.
+ */
+static bool_t cache_wait(cache_ptr c, word_t addr, word_t len)
+{
+    if (!c->busy || c->busy_addr != addr) {
+	uword_t first = (uword_t) addr >> c->block_bits;
+	uword_t last = (uword_t) (addr + len - 1) >> c->block_bits;
+	int lat = cache_lookup(c, first);
+	if (last != first) {
+	    int lat2 = cache_lookup(c, last);
+	    if (lat2 > lat)
+		lat = lat2;
+	}
+	c->busy = TRUE;
+	c->busy_addr = addr;
+	c->wait = lat - 1;
+    }
+    if (c->wait > 0) {
+	c->wait--;
+	return TRUE;
+    }
+    c->busy = FALSE;
+    return FALSE;
+}
+
+/*
+ * Override the control logic while a cache access is in progress.
+ * Rather than stalling F, which would lose a fetch address selected
+ * from M or W, F is loaded with the address being fetched.
+ */
+static void cache_stall_check(sim_ctx_ptr s)
+{
+    pipe_ptr pipes = s->pipes;
+
+    s->icache_stalled = s->dcache_stalled = FALSE;
+    if (s->dcache && (s->mem_read || s->mem_write) && !dmem_error &&
+	pipes[WB_STAGE].op == P_LOAD && cache_wait(s->dcache, s->mem_addr, 8)) {
+	pc_next->pc = s->f_pc;
+	pipes[IF_STAGE].op = P_LOAD;
+	pipes[ID_STAGE].op = P_STALL;
+	pipes[EX_STAGE].op = P_STALL;
+	pipes[MEM_STAGE].op = P_STALL;
+	pipes[WB_STAGE].op = P_BUBBLE;
+	/* Hold off the state updates until the access completes */
+	s->mem_write = FALSE;
+	s->cc_in = s->cc;
+	s->dcache_stalled = TRUE;
+	/* The fetch will be retried */
+	return;
+    }
+    if (s->icache && pipes[ID_STAGE].op == P_LOAD && !imem_error &&
+	cache_wait(s->icache, s->f_pc, if_id_next->valp - s->f_pc)) {
+	pc_next->pc = s->f_pc;
+	pipes[IF_STAGE].op = P_LOAD;
+	pipes[ID_STAGE].op = P_BUBBLE;
+	s->icache_stalled = TRUE;
+    }
+}
+
+static void print_cache_stats(char *name, cache_ptr c)
+{
+    printf("%s: %lld accesses, %lld misses, hit rate %.2f%%\n", name,
+	   c->accesses, c->misses,
+	   c->accesses ? 100.0 * (c->accesses - c->misses) / c->accesses : 0.0);
+}
+
+void sim_print_caches(sim_ctx_ptr c)
+{
+    if (c->icache)
+	print_cache_stats("I-cache", c->icache);
+    if (c->dcache)
+	print_cache_stats("D-cache", c->dcache);
+}
+
+/*
+ * Branch prediction (-B).  Fetch asks the context's model where a
+ * conditional jump or a ret will go and passes the answer to the HCL
+ * as bp_target.  Only pipe-pred.hcl follows it; the other variants
+ * keep their fixed policies, so they serve to check the model's
+ * accuracy without changing the timing.  Returns are predicted by a
+ * return-address stack that is pushed when a call enters decode and
+ * popped when a ret does.  A conditional jump is scored, and the
+ * model trained, as it leaves execute; a ret is scored when it reads
+ * its return address in the memory stage.
+ */
+#define BP_TABLE 1024  /* Counters in the bimodal and gshare tables */
+#define BP_HIST 10     /* Bits of global history used by gshare */
+#define BTB_SIZE 16    /* Entries in the branch target buffer */
+#define RAS_SIZE 16    /* Depth of the return-address stack */
+
+/* Prediction accuracy of a run */
+typedef struct {
+    word_t jumps;
+    word_t jump_hits;
+    word_t rets;
+    word_t ret_hits;
+} bp_stats_rec;
+
+typedef struct {
+    word_t pc;
+    word_t target;
+    byte_t counter;
+} btb_ele;
+
+/*
+ * The return-address stack is updated speculatively, so each entry to
+ * decode logs what it may change.  Instructions squashed out of D and
+ * E are the most recent entries, and are undone from the log.
+ */
+#define RAS_LOG 4
+typedef struct {
+    int top;
+    int depth;
+    word_t above;   /* Slot a call would overwrite */
+} ras_log_ele;
+
+/* The predictor of one context: its model, tables and statistics */
+typedef struct bp_rec {
+    bp_model_ptr model;
+    bp_stats_rec stats;
+    byte_t counters[BP_TABLE];
+    word_t history;
+    btb_ele btb[BTB_SIZE];
+    word_t ras[RAS_SIZE];
+    int ras_top, ras_depth;
+    ras_log_ele ras_log[RAS_LOG];
+    int ras_log_next;
+} bp_rec, *bp_ptr;
+
+typedef struct bp_model_rec {
+    char *name;
+    char *descr;
+    bool_t use_ras;     /* Predict returns with the return-address stack? */
+    /* Predict the PC following the conditional jump at pc */
+    word_t (*predict)(bp_ptr b, word_t pc, word_t valc, word_t valp);
+    /* Learn the outcome of the conditional jump at pc */
+    void (*update)(bp_ptr b, word_t pc, word_t valc, bool_t taken);
+} bp_model_rec;
+
+/* Step a two-bit saturating counter toward the outcome */
+static byte_t bp_train(byte_t counter, bool_t taken)
+{
+    if (taken)
+	return counter < 3 ? counter+1 : 3;
+    return counter > 0 ? counter-1 : 0;
+}
+
+static word_t predict_taken(bp_ptr b, word_t pc, word_t valc, word_t valp)
+{
+    return valc;
+}
+
+static word_t predict_not_taken(bp_ptr b, word_t pc, word_t valc, word_t valp)
+{
+    return valp;
+}
+
+static word_t predict_btfnt(bp_ptr b, word_t pc, word_t valc, word_t valp)
+{
+    return valc <= pc ? valc : valp;
+}
+
+static void update_none(bp_ptr b, word_t pc, word_t valc, bool_t taken)
+{
+}
+
+static word_t predict_bimodal(bp_ptr b, word_t pc, word_t valc, word_t valp)
+{
+    return b->counters[pc % BP_TABLE] >= 2 ? valc : valp;
+}
+
+static void update_bimodal(bp_ptr b, word_t pc, word_t valc, bool_t taken)
+{
+    b->counters[pc % BP_TABLE] = bp_train(b->counters[pc % BP_TABLE], taken);
+}
+
+static int gshare_index(bp_ptr b, word_t pc)
+{
+    return (pc ^ b->history) % BP_TABLE;
+}
+
+static word_t predict_gshare(bp_ptr b, word_t pc, word_t valc, word_t valp)
+{
+    return b->counters[gshare_index(b, pc)] >= 2 ? valc : valp;
+}
+
+static void update_gshare(bp_ptr b, word_t pc, word_t valc, bool_t taken)
+{
+    int i = gshare_index(b, pc);
+    b->counters[i] = bp_train(b->counters[i], taken);
+    b->history = ((b->history << 1) | taken) & ((1 << BP_HIST) - 1);
+}
+
+/* A jump that misses in the BTB falls through */
+static word_t predict_btb(bp_ptr b, word_t pc, word_t valc, word_t valp)
+{
+    btb_ele *e = &b->btb[pc % BTB_SIZE];
+    return e->pc == pc && e->counter >= 2 ? e->target : valp;
+}
+
+/* Only taken jumps are allocated an entry */
+static void update_btb(bp_ptr b, word_t pc, word_t valc, bool_t taken)
+{
+    btb_ele *e = &b->btb[pc % BTB_SIZE];
+    if (e->pc == pc)
+	e->counter = bp_train(e->counter, taken);
+    else if (taken) {
+	e->pc = pc;
+	e->target = valc;
+	e->counter = 2;
+    }
+}
+
+/* The first model is the policy of pipe-std, the baseline for -B */
+static bp_model_rec bp_models[] = {
+    {"std", "taken, returns not predicted (pipe-std)", FALSE,
+     predict_taken, update_none},
+    {"taken", "always taken", TRUE, predict_taken, update_none},
+    {"nt", "never taken", TRUE, predict_not_taken, update_none},
+    {"btfnt", "backward taken, forward not taken", TRUE,
+     predict_btfnt, update_none},
+    {"bimodal", "1024 two-bit counters indexed by PC", TRUE,
+     predict_bimodal, update_bimodal},
+    {"gshare", "1024 two-bit counters indexed by PC xor 10-bit history", TRUE,
+     predict_gshare, update_gshare},
+    {"btb", "16-entry branch target buffer with two-bit counters", TRUE,
+     predict_btb, update_btb},
+};
+#define NUM_BP_MODELS (sizeof(bp_models)/sizeof(bp_models[0]))
+
+void sim_print_bp_models()
+{
+    int i;
+    for (i = 0; i < NUM_BP_MODELS; i++)
+	printf("            %-8s %s\n", bp_models[i].name, bp_models[i].descr);
+    printf("          All but std predict returns with a %d-entry stack\n",
+	   RAS_SIZE);
+}
+
+bp_model_ptr sim_bp_model(char *name)
+{
+    int i;
+    for (i = 0; i < NUM_BP_MODELS; i++)
+	if (strcmp(name, bp_models[i].name) == 0)
+	    return &bp_models[i];
+    return NULL;
+}
+
+/* Create a predictor with model m and no history, as at the start of a run */
+static bp_ptr new_bp(bp_model_ptr m)
+{
+    bp_ptr b = calloc(1, sizeof(bp_rec));
+    int i;
+    b->model = m;
+    memset(b->counters, 2, sizeof(b->counters));
+    for (i = 0; i < BTB_SIZE; i++)
+	b->btb[i].pc = -1;
+    return b;
+}
+
+static void ras_undo(bp_ptr b)
+{
+    ras_log_ele *e;
+    b->ras_log_next = (b->ras_log_next + RAS_LOG - 1) % RAS_LOG;
+    e = &b->ras_log[b->ras_log_next];
+    b->ras_top = e->top;
+    b->ras_depth = e->depth;
+    b->ras[(b->ras_top + 1) % RAS_SIZE] = e->above;
+}
+
+/* Choose bp_target for the instruction being fetched */
+static word_t bp_predict(bp_ptr b, word_t pc, byte_t icode, byte_t ifun,
+			 word_t valc, word_t valp)
+{
+    if (icode == I_JMP)
+	return ifun == C_YES ? valc : b->model->predict(b, pc, valc, valp);
+    if (icode == I_RET && b->model->use_ras && b->ras_depth > 0)
+	return b->ras[b->ras_top];
+    return valp;
+}
+
+/* Score, train and update the return-address stack after each cycle */
+static void bp_cycle(sim_ctx_ptr s)
+{
+    bp_ptr b = s->bp;
+    pipe_ptr pipes = s->pipes;
+
+    if (id_ex_curr->icode == I_JMP && id_ex_curr->ifun != C_YES &&
+	pipes[MEM_STAGE].op == P_LOAD) {
+	bool_t taken = ex_mem_next->takebranch;
+	word_t actual = taken ? id_ex_curr->valc : id_ex_curr->vala;
+	b->stats.jumps++;
+	b->stats.jump_hits += id_ex_curr->predpc == actual;
+	b->model->update(b, id_ex_curr->stage_pc, id_ex_curr->valc, taken);
+    }
+    if (ex_mem_curr->icode == I_RET && mem_wb_next->status == STAT_AOK &&
+	pipes[WB_STAGE].op == P_LOAD) {
+	b->stats.rets++;
+	b->stats.ret_hits += ex_mem_curr->predpc == mem_wb_next->valm;
+    }
+    if (!b->model->use_ras)
+	return;
+    /* Squashed instructions, youngest first: D and E bubbled, or E
+       and M bubbled */
+    if (pipes[ID_STAGE].op == P_BUBBLE && pipes[EX_STAGE].op == P_BUBBLE &&
+	if_id_curr->status != STAT_BUB)
+	ras_undo(b);
+    if (pipes[EX_STAGE].op == P_BUBBLE && pipes[MEM_STAGE].op == P_BUBBLE &&
+	id_ex_curr->status != STAT_BUB)
+	ras_undo(b);
+    if (pipes[ID_STAGE].op == P_LOAD) {
+	ras_log_ele *e = &b->ras_log[b->ras_log_next];
+	e->top = b->ras_top;
+	e->depth = b->ras_depth;
+	e->above = b->ras[(b->ras_top + 1) % RAS_SIZE];
+	b->ras_log_next = (b->ras_log_next + 1) % RAS_LOG;
+	if (if_id_next->icode == I_CALL) {
+	    /* A full stack drops its oldest entry */
+	    b->ras_top = (b->ras_top + 1) % RAS_SIZE;
+	    b->ras[b->ras_top] = if_id_next->valp;
+	    if (b->ras_depth < RAS_SIZE)
+		b->ras_depth++;
+	} else if (if_id_next->icode == I_RET && b->ras_depth > 0) {
+	    b->ras_top = (b->ras_top + RAS_SIZE - 1) % RAS_SIZE;
+	    b->ras_depth--;
+	}
+    }
+}
+
+static void print_bp_row(char *name, bp_stats_rec *st, word_t ncycles,
+			 word_t base_cycles)
+{
+    printf("  %-8s %8lld %8lld %6.1f%% %8lld %8lld %6.1f%% %10lld %8lld\n",
+	   name, st->jumps, st->jump_hits,
+	   st->jumps ? 100.0 * st->jump_hits / st->jumps : 0.0,
+	   st->rets, st->ret_hits,
+	   st->rets ? 100.0 * st->ret_hits / st->rets : 0.0,
+	   ncycles, base_cycles - ncycles);
+}
+
+void sim_print_bp_compare(sim_ctx_ptr c, mem_t mem0, bool_t all,
+			  word_t max_instr)
+{
+    bp_stats_rec st[NUM_BP_MODELS];
+    word_t ncycles[NUM_BP_MODELS];
+    int i, first = c->bp->model - bp_models;
+    /* The reruns are neither logged, traced nor profiled */
+    sim_opts_rec opts = c->opts;
+
+    opts.log = NULL;
+    opts.trace = FALSE;
+    opts.profile = FALSE;
+    st[first] = c->bp->stats;
+    ncycles[first] = c->cycles;
+    for (i = 0; i < NUM_BP_MODELS; i++) {
+	sim_ctx_ptr r;
+	if (i == first || (!all && i != 0))
+	    continue;
+	opts.bp = &bp_models[i];
+	r = sim_ctx_new(copy_mem(mem0), 0, &opts);
+	sim_ctx_run(r, max_instr, 5*max_instr);
+	st[i] = r->bp->stats;
+	ncycles[i] = r->cycles;
+	sim_ctx_free(r);
+    }
+    sim_cur = c;
+
+    printf("Branch prediction:\n");
+    printf("  %-8s %8s %8s %7s %8s %8s %7s %10s %8s\n", "Model",
+	   "Jumps", "Correct", "", "Rets", "Correct", "", "Cycles", "Saved");
+    for (i = 0; i < NUM_BP_MODELS; i++)
+	if (all || i == 0 || i == first)
+	    print_bp_row(bp_models[i].name, &st[i], ncycles[i], ncycles[0]);
+}
+
+/*
+ * Bubble attribution.  Just before the pipe registers are updated,
+ * each bubble about to be injected is classified by the standard PIPE
+ * hazard conditions, evaluated on the state the control logic saw:
+ *   load/use:   E holds mrmovq/popq whose dstM is d_srcA or d_srcB
+ *               (bubble into E)
+ *   mispredict: E holds a conditional jump (bubbles into D and E)
+ *   ret:        D, E or M holds a ret (bubble into D; with
+ *               pipe-pred.hcl, into D, E and M when M holds a ret)
+ *   I-cache:    a fetch is waiting on the instruction cache (bubble
+ *               into D)
+ *   D-cache:    M is waiting on the data cache (bubble into W)
+ * Anything else, such as an exception, counts as "other".  The cause
+ * rides along with the bubble, and the cycle it costs is charged when
+ * it reaches W, if the context keeps a profile (-p).
+ */
+static char *cause_names[NUM_CAUSES] =
+    { "None", "Load/use", "Mispredict", "Return", "I-cache", "D-cache",
+      "Other" };
+
+/* Lost cycles of one blamed PC */
+typedef struct {
+    word_t pc;
+    word_t cycles[NUM_CAUSES];
+    word_t total;
+} pc_cost_rec, *pc_cost_ptr;
+
+/* Lost cycles per cause, and per PC in an open-addressed hash table */
+typedef struct prof_rec {
+    word_t cause_cycles[NUM_CAUSES];
+    pc_cost_ptr pc_costs;
+    int pc_cost_size;
+    int pc_cost_count;
+} prof_rec, *prof_ptr;
+
+static pc_cost_ptr find_pc_cost(prof_ptr p, word_t pc)
+{
+    int i;
+    if (2*(p->pc_cost_count+1) > p->pc_cost_size) {
+	pc_cost_ptr old = p->pc_costs;
+	int old_size = p->pc_cost_size;
+	p->pc_cost_size = old_size ? 2*old_size : 256;
+	p->pc_costs = calloc(p->pc_cost_size, sizeof(pc_cost_rec));
+	for (i = 0; i < p->pc_cost_size; i++)
+	    p->pc_costs[i].pc = -1;
+	p->pc_cost_count = 0;
+	for (i = 0; i < old_size; i++)
+	    if (old[i].pc != -1) {
+		*find_pc_cost(p, old[i].pc) = old[i];
+	    }
+	free(old);
+    }
+    i = (int) ((uword_t) pc * 0x9E3779B97F4A7C15ULL >> 40) & (p->pc_cost_size-1);
+    while (p->pc_costs[i].pc != pc) {
+	if (p->pc_costs[i].pc == -1) {
+	    p->pc_costs[i].pc = pc;
+	    p->pc_cost_count++;
+	    break;
+	}
+	i = (i+1) & (p->pc_cost_size-1);
+    }
+    return &p->pc_costs[i];
+}
+
+/* Charge the bubble in W of context s to its cause */
+static void prof_charge(sim_ctx_ptr s)
+{
+    byte_t cause = mem_wb_curr->cause;
+    pc_cost_ptr pcc;
+    if (cause == CAUSE_NONE)
+	cause = CAUSE_OTHER;
+    s->prof->cause_cycles[cause]++;
+    pcc = find_pc_cost(s->prof, mem_wb_curr->cause_pc);
+    pcc->cycles[cause]++;
+    pcc->total++;
+}
+
+/* Order PCs by decreasing lost cycles */
+static int compare_pc_cost(const void *a, const void *b)
+{
+    const pc_cost_rec *pa = a, *pb = b;
+    if (pa->total != pb->total)
+	return pa->total < pb->total ? 1 : -1;
+    return pa->pc < pb->pc ? -1 : pa->pc > pb->pc;
+}
+
+/*
+ * sim_print_profile - Print the CPI stack (the share of CPI due to each
+ * bubble cause) and the lost cycles charged to each PC
+ */
+void sim_print_profile(sim_ctx_ptr s)
+{
+    prof_ptr p = s->prof;
+    double ni = s->instructions > 0 ? (double) s->instructions : 1.0;
+    pc_cost_ptr costs;
+    int c, i, n = 0;
+
+    if (!p)
+	return;
+    printf("CPI breakdown:\n");
+    printf("  %-11s %8lld  %.2f\n", "Base", s->instructions,
+	   s->instructions > 0 ? 1.0 : 0.0);
+    for (c = CAUSE_LOAD_USE; c < NUM_CAUSES; c++)
+	printf("  %-11s %8lld  %.2f\n", cause_names[c], p->cause_cycles[c],
+	       p->cause_cycles[c]/ni);
+
+    costs = malloc((p->pc_cost_count+1) * sizeof(pc_cost_rec));
+    for (i = 0; i < p->pc_cost_size; i++)
+	if (p->pc_costs[i].pc != -1)
+	    costs[n++] = p->pc_costs[i];
+    qsort(costs, n, sizeof(pc_cost_rec), compare_pc_cost);
+    printf("Lost cycles by PC:\n");
+    printf("  %-6s %8s", "PC", "Total");
+    for (c = CAUSE_LOAD_USE; c < NUM_CAUSES; c++)
+	printf(" %10s", cause_names[c]);
+    printf("\n");
+    for (i = 0; i < n; i++) {
+	printf("  0x%04llx %8lld", costs[i].pc, costs[i].total);
+	for (c = CAUSE_LOAD_USE; c < NUM_CAUSES; c++)
+	    printf(" %10lld", costs[i].cycles[c]);
+	printf("\n");
+    }
+    free(costs);
+}
+
+/* Classify a bubble about to be injected into stage */
+static byte_t bubble_cause(sim_ctx_ptr s, stage_id_t stage, word_t *blame_pc)
+{
+    byte_t e_icode = id_ex_curr->icode;
+    if (stage == ID_STAGE && s->icache_stalled) {
+	*blame_pc = s->f_pc;
+	return CAUSE_ICACHE;
+    }
+    if (stage == WB_STAGE && s->dcache_stalled) {
+	*blame_pc = ex_mem_curr->stage_pc;
+	return CAUSE_DCACHE;
+    }
+    if (stage == EX_STAGE && (e_icode == I_MRMOVQ || e_icode == I_POPQ) &&
+	(id_ex_curr->destm == id_ex_next->srca ||
+	 id_ex_curr->destm == id_ex_next->srcb)) {
+	*blame_pc = id_ex_curr->stage_pc;
+	return CAUSE_LOAD_USE;
+    }
+    /* A ret mispredicted by pipe-pred.hcl squashes D, E and M */
+    if (stage <= MEM_STAGE && ex_mem_curr->icode == I_RET &&
+	mem_wb_next->status == STAT_AOK) {
+	*blame_pc = ex_mem_curr->stage_pc;
+	return CAUSE_RET;
+    }
+    if ((stage == ID_STAGE || stage == EX_STAGE) &&
+	e_icode == I_JMP && id_ex_curr->ifun != C_YES) {
+	*blame_pc = id_ex_curr->stage_pc;
+	return CAUSE_MISPREDICT;
+    }
+    if (stage == ID_STAGE) {
+	if (if_id_curr->icode == I_RET) {
+	    *blame_pc = if_id_curr->stage_pc;
+	    return CAUSE_RET;
+	}
+	if (e_icode == I_RET) {
+	    *blame_pc = id_ex_curr->stage_pc;
+	    return CAUSE_RET;
+	}
+    }
+    *blame_pc = mem_wb_curr->stage_pc;
+    return CAUSE_OTHER;
+}
+
+/* Tag the bubbles that update_pipes just injected with their causes */
+static void tag_bubbles(p_stat_t *ops, byte_t *causes, word_t *pcs)
+{
+    if (ops[ID_STAGE] == P_BUBBLE) {
+	if_id_curr->cause = causes[ID_STAGE];
+	if_id_curr->cause_pc = pcs[ID_STAGE];
+    }
+    if (ops[EX_STAGE] == P_BUBBLE) {
+	id_ex_curr->cause = causes[EX_STAGE];
+	id_ex_curr->cause_pc = pcs[EX_STAGE];
+    }
+    if (ops[MEM_STAGE] == P_BUBBLE) {
+	ex_mem_curr->cause = causes[MEM_STAGE];
+	ex_mem_curr->cause_pc = pcs[MEM_STAGE];
+    }
+    if (ops[WB_STAGE] == P_BUBBLE) {
+	mem_wb_curr->cause = causes[WB_STAGE];
+	mem_wb_curr->cause_pc = pcs[WB_STAGE];
+    }
+}
+
+/*
+ * Lockstep checking (-t).  Each time an instruction reaches write-back,
+ * the ISA simulator executes the instruction at the same PC.  Since
+ * the pipeline only writes the registers at the next update, the check
+ * is made when the next instruction reaches write-back, or at the end
+ * of the run.  Only the registers that either simulator wrote and the
+ * word that the instruction stored are compared, and the run stops at
+ * the first divergence.
+ */
+typedef struct {
+    bool_t valid;   /* Instruction waiting to be checked */
+    word_t cycle;   /* Cycle at which it reached write-back */
+    word_t pc;
+    byte_t icode;
+    byte_t ifun;
+    byte_t status;
+    bool_t store;   /* Did it write memory? */
+    word_t addr;
+    word_t data;
+} lock_instr_t;
+
+typedef struct lock_rec {
+    state_ptr isa;       /* ISA state at the same point of the program */
+    int verbosity;       /* What to print (see sim_ctx_lock) */
+    bool_t failed;       /* Found a divergence */
+    word_t regs;         /* Registers written since the last check */
+    bool_t store;        /* Memory write made by this update */
+    word_t store_addr, store_data;
+    lock_instr_t pending;
+} lock_rec, *lock_ptr;
+
+/* Pipeline value of register r, including writes still in write-back */
+static word_t lock_reg_val(sim_ctx_ptr s, reg_id_t r, bool_t in_wb)
+{
+    if (in_wb && s->wb_destM == r)
+	return s->wb_valM;
+    if (in_wb && s->wb_destE == r)
+	return s->wb_valE;
+    return get_reg_val(s->reg, r);
+}
+
+/* Report a divergence for instruction li */
+static void lock_fail(lock_ptr l, lock_instr_t *li)
+{
+    if (!l->failed && l->verbosity >= 0)
+	printf("Divergence at cycle %lld, PC 0x%llx (%s)\n",
+	       li->cycle, li->pc, iname(HPACK(li->icode, li->ifun)));
+    l->failed = TRUE;
+}
+
+/*
+ * Check the pending instruction against the ISA simulator.  If in_wb
+ * is set, its register writes are still in write-back.
+ */
+static void lock_check(sim_ctx_ptr c, bool_t in_wb)
+{
+    lock_ptr l = c->lock;
+    lock_instr_t *li = &l->pending;
+    state_ptr s = l->isa;
+    bool_t detail = l->verbosity > 0;
+    byte_t instr = 0;
+    byte_t regids = HPACK(REG_NONE, REG_NONE);
+    word_t valc = 0;
+    word_t regs = l->regs;
+    bool_t isa_store = FALSE;
+    word_t addr = 0;
+    word_t val = 0;
+    byte_t e;
+    int i;
+
+    if (!li->valid)
+	return;
+    li->valid = FALSE;
+    /* An instruction that stops the pipeline never writes back */
+    if (li->status != STAT_AOK)
+	in_wb = FALSE;
+    l->regs = 0;
+    if (s->pc != li->pc) {
+	lock_fail(l, li);
+	if (detail)
+	    printf("ISA PC 0x%llx != Pipeline PC 0x%llx\n", s->pc, li->pc);
+	return;
+    }
+
+    /* Find what the ISA simulator will write */
+    get_byte_val(s->m, s->pc, &instr);
+    get_byte_val(s->m, s->pc+1, &regids);
+    get_word_val(s->m, s->pc+2, &valc);
+    switch (HI4(instr)) {
+    case I_RRMOVQ:
+    case I_IRMOVQ:
+    case I_ALU:
+    case I_IADDQ:
+	regs |= 1 << LO4(regids);
+	break;
+    case I_MRMOVQ:
+	regs |= 1 << HI4(regids);
+	break;
+    case I_POPQ:
+	regs |= 1 << HI4(regids) | 1 << REG_RSP;
+	break;
+    case I_RET:
+	regs |= 1 << REG_RSP;
+	break;
+    case I_PUSHQ:
+    case I_CALL:
+	regs |= 1 << REG_RSP;
+	isa_store = TRUE;
+	addr = get_reg_val(s->r, REG_RSP) - 8;
+	break;
+    case I_RMMOVQ:
+	isa_store = TRUE;
+	addr = get_reg_val(s->r, LO4(regids)) + valc;
+	break;
+    default:
+	break;
+    }
+    if (in_wb)
+	regs |= 1 << c->wb_destE | 1 << c->wb_destM;
+
+    e = step_state_fast(s, l->verbosity < 0 ? NULL : stdout);
+    if (e != li->status) {
+	lock_fail(l, li);
+	if (detail)
+	    printf("ISA Status %s != Pipeline Status %s\n",
+		   stat_name(e), stat_name(li->status));
+    }
+    for (i = 0; i < REG_NONE; i++) {
+	word_t isa_val = get_reg_val(s->r, i);
+	word_t pipe_val = lock_reg_val(c, i, in_wb);
+	if ((regs >> i & 1) && isa_val != pipe_val) {
+	    lock_fail(l, li);
+	    if (detail)
+		printf("ISA %s = 0x%llx != Pipeline %s = 0x%llx\n",
+		       reg_name(i), isa_val, reg_name(i), pipe_val);
+	}
+    }
+    isa_store = isa_store && e == STAT_AOK;
+    if (isa_store)
+	get_word_val(s->m, addr, &val);
+    if (isa_store != li->store ||
+	(isa_store && (addr != li->addr || val != li->data))) {
+	lock_fail(l, li);
+	if (detail) {
+	    if (isa_store)
+		printf("ISA wrote 0x%llx to 0x%llx", val, addr);
+	    else
+		printf("ISA wrote no memory");
+	    if (li->store)
+		printf(", Pipeline wrote 0x%llx to 0x%llx\n",
+		       li->data, li->addr);
+	    else
+		printf(", Pipeline wrote no memory\n");
+	}
+    }
+}
+
+/* An instruction has reached write-back in the current cycle of c */
+static void lock_retire(sim_ctx_ptr c)
+{
+    lock_ptr l = c->lock;
+
+    lock_check(c, FALSE);
+    if (l->failed)
+	return;
+    l->pending.valid = TRUE;
+    l->pending.cycle = c->ccount;
+    l->pending.pc = mem_wb_curr->stage_pc;
+    l->pending.icode = mem_wb_curr->icode;
+    l->pending.ifun = mem_wb_curr->ifun;
+    l->pending.status = mem_wb_curr->status;
+    l->pending.store = l->store;
+    l->pending.addr = l->store_addr;
+    l->pending.data = l->store_data;
+}
+
+void sim_ctx_lock(sim_ctx_ptr c, state_ptr isa, int verbosity)
+{
+    lock_ptr l = calloc(1, sizeof(lock_rec));
+    l->isa = isa;
+    l->verbosity = verbosity;
+    c->lock = l;
+}
+
+bool_t sim_ctx_unlock(sim_ctx_ptr c)
+{
+    lock_ptr l = c->lock;
+    bool_t match;
+
+    sim_cur = c;
+    /* The last instruction's register writes are still in write-back */
+    if (!l->failed)
+	lock_check(c, TRUE);
+    match = !l->failed;
+    free(l);
+    c->lock = NULL;
+    return match;
+}
+
+
+/********************************
+ * Part 3: Stage implementations
+ *********************************/
+
+/*************** Bubbled version of stages *************/
+
+pc_ele bubble_pc = {0,STAT_AOK};
+if_id_ele bubble_if_id = { I_NOP, 0, REG_NONE,REG_NONE,
+				  0, 0, STAT_BUB, 0};
+id_ex_ele bubble_id_ex = { I_NOP, 0, 0, 0, 0,
+				  REG_NONE, REG_NONE, REG_NONE, REG_NONE,
+				  STAT_BUB, 0};
+
+ex_mem_ele bubble_ex_mem = { I_NOP, 0, FALSE, 0, 0,
+				    REG_NONE, REG_NONE, STAT_BUB, 0};
+
+mem_wb_ele bubble_mem_wb = { I_NOP, 0, 0, 0, REG_NONE, REG_NONE,
+				    STAT_BUB, 0};
+
+/*************** Stage Implementations *****************/
+
+/*
+ * Each stage computes the next state of the pipe register after it
+ * in context s, which is also sim_cur, the context in which the
+ * control logic evaluates its signals.
+ */
+
+word_t gen_f_pc();
+word_t gen_need_regids();
+word_t gen_need_valC();
+word_t gen_instr_valid();
+word_t gen_f_predPC();
+word_t gen_f_icode();
+word_t gen_f_ifun();
+word_t gen_f_stat();
+word_t gen_instr_valid();
+
+static void do_if_stage(sim_ctx_ptr s)
+{
+    byte_t instr = HPACK(I_NOP, F_NONE);
+    byte_t regids = HPACK(REG_NONE, REG_NONE);
+    word_t valc = 0;
+    word_t valp = s->f_pc = gen_f_pc();
+
+    /* Ready to fetch instruction.  Speculatively fetch register byte
+       and immediate word
+    */
+    imem_error = !get_byte_val(s->mem, valp, &instr);
+    imem_icode = HI4(instr);
+    imem_ifun = LO4(instr);
+    if (!imem_error) {
+      byte_t junk;
+      /* Make sure can read maximum length instruction */
+      imem_error = !get_byte_val(s->mem, valp+5, &junk);
+    }
+    if_id_next->icode = gen_f_icode();
+    if_id_next->ifun  = gen_f_ifun();
+    if (!imem_error) {
+	sim_log("\tFetch: f_pc = 0x%llx, imem_instr = %s, f_instr = %s\n",
+		s->f_pc, iname(instr),
+		iname(HPACK(if_id_next->icode, if_id_next->ifun)));
+    }
+
+    instr_valid = gen_instr_valid();
+    if (!instr_valid)
+      sim_log("\tFetch: Instruction code 0x%llx invalid\n", instr);
+    if_id_next->status = gen_f_stat();
+
+    valp++;
+    if (gen_need_regids()) {
+	get_byte_val(s->mem, valp, &regids);
+	valp ++;
+    }
+    if_id_next->ra = HI4(regids);
+    if_id_next->rb = LO4(regids);
+    if (gen_need_valC()) {
+	get_word_val(s->mem, valp, &valc);
+	valp+= 8;
+    }
+    if_id_next->valp = valp;
+    if_id_next->valc = valc;
+
+    bp_target = s->bp ? bp_predict(s->bp, s->f_pc, if_id_next->icode,
+				   if_id_next->ifun, valc, valp) : valc;
+    pc_next->pc = gen_f_predPC();
+
+    pc_next->status = (if_id_next->status == STAT_AOK) ? STAT_AOK : STAT_BUB;
+
+    if_id_next->stage_pc = s->f_pc;
+    if_id_next->cause = CAUSE_NONE;
+    if_id_next->cause_pc = 0;
+    if_id_next->predpc = bp_target;
+}
+
+word_t gen_d_srcA();
+word_t gen_d_srcB();
+word_t gen_d_dstE();
+word_t gen_d_dstM();
+word_t gen_d_valA();
+word_t gen_d_valB();
+word_t gen_w_dstE();
+word_t gen_w_valE();
+word_t gen_w_dstM();
+word_t gen_w_valM();
+word_t gen_Stat();
+
+/* Implements both ID and WB */
+static void do_id_wb_stages(sim_ctx_ptr s)
+{
+    /* Set up write backs.  Don't occur until end of cycle */
+    s->wb_destE = gen_w_dstE();
+    s->wb_valE = gen_w_valE();
+    s->wb_destM = gen_w_dstM();
+    s->wb_valM = gen_w_valM();
+
+    /* Update processor status */
+    s->status = gen_Stat();
+
+    id_ex_next->srca = gen_d_srcA();
+    id_ex_next->srcb = gen_d_srcB();
+    id_ex_next->deste = gen_d_dstE();
+    id_ex_next->destm = gen_d_dstM();
+
+    /* Read the registers */
+    d_regvala = get_reg_val(s->reg, id_ex_next->srca);
+    d_regvalb = get_reg_val(s->reg, id_ex_next->srcb);
+
+    /* Do forwarding and valA selection */
+    id_ex_next->vala = gen_d_valA();
+    id_ex_next->valb = gen_d_valB();
+
+    id_ex_next->icode = if_id_curr->icode;
+    id_ex_next->ifun = if_id_curr->ifun;
+    id_ex_next->valc = if_id_curr->valc;
+    id_ex_next->stage_pc = if_id_curr->stage_pc;
+    id_ex_next->cause = if_id_curr->cause;
+    id_ex_next->cause_pc = if_id_curr->cause_pc;
+    id_ex_next->predpc = if_id_curr->predpc;
+    id_ex_next->status = if_id_curr->status;
+}
+
+word_t gen_alufun();
+word_t gen_set_cc();
+word_t gen_Bch();
+word_t gen_aluA();
+word_t gen_aluB();
+word_t gen_e_valA();
+word_t gen_e_dstE();
+
+static void do_ex_stage(sim_ctx_ptr s)
+{
+    alu_t alufun = gen_alufun();
+    bool_t setcc = gen_set_cc();
+    word_t alua, alub;
+
+    alua = gen_aluA();
+    alub = gen_aluB();
+
+    s->e_bcond = cond_holds(s->cc, id_ex_curr->ifun);
+
+    ex_mem_next->takebranch = s->e_bcond;
+
+    if (id_ex_curr->icode == I_JMP)
+      sim_log("\tExecute: instr = %s, cc = %s, branch %staken\n",
+	      iname(HPACK(id_ex_curr->icode, id_ex_curr->ifun)),
+	      cc_name(s->cc),
+	      ex_mem_next->takebranch ? "" : "not ");
+
+    /* Perform the ALU operation */
+    word_t aluout = compute_alu(alufun, alua, alub);
+    ex_mem_next->vale = aluout;
+    sim_log("\tExecute: ALU: %c 0x%llx 0x%llx --> 0x%llx\n",
+	    op_name(alufun), alua, alub, aluout);
+
+    if (setcc) {
+	s->cc_in = compute_cc(alufun, alua, alub);
+	sim_log("\tExecute: New cc = %s\n", cc_name(s->cc_in));
+    }
+
+    ex_mem_next->icode = id_ex_curr->icode;
+    ex_mem_next->ifun = id_ex_curr->ifun;
+    ex_mem_next->vala = gen_e_valA();
+    ex_mem_next->deste = gen_e_dstE();
+    ex_mem_next->destm = id_ex_curr->destm;
+    ex_mem_next->srca = id_ex_curr->srca;
+    ex_mem_next->status = id_ex_curr->status;
+    ex_mem_next->stage_pc = id_ex_curr->stage_pc;
+    ex_mem_next->cause = id_ex_curr->cause;
+    ex_mem_next->cause_pc = id_ex_curr->cause_pc;
+    ex_mem_next->predpc = id_ex_curr->predpc;
+}
+
+/* Functions defined using HCL */
+word_t gen_mem_addr();
+word_t gen_mem_read();
+word_t gen_mem_write();
+word_t gen_m_stat();
+
+static void do_mem_stage(sim_ctx_ptr s)
+{
+    s->mem_read = gen_mem_read();
+
+    word_t valm = 0;
+
+    s->mem_addr = gen_mem_addr();
+    s->mem_data = ex_mem_curr->vala;
+    s->mem_write = gen_mem_write();
+    dmem_error = FALSE;
+
+    if (s->mem_read) {
+	dmem_error = dmem_error || !get_word_val(s->mem, s->mem_addr, &valm);
+	if (!dmem_error)
+	  sim_log("\tMemory: Read 0x%llx from 0x%llx\n",
+		  valm, s->mem_addr);
+    }
+    if (s->mem_write) {
+	word_t sink;
+	/* Do a read of address just to check validity */
+	dmem_error = dmem_error || !get_word_val(s->mem, s->mem_addr, &sink);
+	if (dmem_error)
+	  sim_log("\tMemory: Invalid address 0x%llx\n",
+		  s->mem_addr);
+    }
+    mem_wb_next->icode = ex_mem_curr->icode;
+    mem_wb_next->ifun = ex_mem_curr->ifun;
+    mem_wb_next->vale = ex_mem_curr->vale;
+    mem_wb_next->valm = valm;
+    mem_wb_next->deste = ex_mem_curr->deste;
+    mem_wb_next->destm = ex_mem_curr->destm;
+    mem_wb_next->status = gen_m_stat();
+    mem_wb_next->stage_pc = ex_mem_curr->stage_pc;
+    mem_wb_next->cause = ex_mem_curr->cause;
+    mem_wb_next->cause_pc = ex_mem_curr->cause_pc;
+    mem_wb_next->predpc = ex_mem_curr->predpc;
+}
+
+/* Set stalling conditions for different stages */
+
+word_t gen_F_stall(), gen_F_bubble();
+word_t gen_D_stall(), gen_D_bubble();
+word_t gen_E_stall(), gen_E_bubble();
+word_t gen_M_stall(), gen_M_bubble();
+word_t gen_W_stall(), gen_W_bubble();
+
+/* Generated by hcl2c from the F_stall ... W_bubble signals, with the
+   terms they share evaluated once, when the HCL file defines all ten.
+   An included file says so with HCL_PIPE_CONTROL.  Otherwise the
+   declaration is weak, so that a file without it still links. */
+#ifndef HCL_PIPE_CONTROL
+void gen_pipe_control(word_t *stall, word_t *bubble) __attribute__((weak));
+#endif
+
+static p_stat_t pipe_cntl(char *name, word_t stall, word_t bubble)
+{
+    if (stall) {
+	if (bubble) {
+	    sim_log("%s: Conflicting control signals for pipe register\n",
+		    name);
+	    return P_ERROR;
+	} else
+	    return P_STALL;
+    } else {
+	return bubble ? P_BUBBLE : P_LOAD;
+    }
+}
+
+static void do_stall_check(sim_ctx_ptr s)
+{
+    word_t stall[5], bubble[5];
+
+#ifndef HCL_PIPE_CONTROL
+    if (!gen_pipe_control) {
+	stall[0] = gen_F_stall(); bubble[0] = gen_F_bubble();
+	stall[1] = gen_D_stall(); bubble[1] = gen_D_bubble();
+	stall[2] = gen_E_stall(); bubble[2] = gen_E_bubble();
+	stall[3] = gen_M_stall(); bubble[3] = gen_M_bubble();
+	stall[4] = gen_W_stall(); bubble[4] = gen_W_bubble();
+    } else
+#endif
+    gen_pipe_control(stall, bubble);
+    s->pipes[IF_STAGE].op = pipe_cntl("PC", stall[0], bubble[0]);
+    s->pipes[ID_STAGE].op = pipe_cntl("ID", stall[1], bubble[1]);
+    s->pipes[EX_STAGE].op = pipe_cntl("EX", stall[2], bubble[2]);
+    s->pipes[MEM_STAGE].op = pipe_cntl("MEM", stall[3], bubble[3]);
+    s->pipes[WB_STAGE].op = pipe_cntl("WB", stall[4], bubble[4]);
+}
+
+
+/*****************************************************
+ * Part 4: Stepping the pipeline of a simulation context
+ *****************************************************/
+
+/* Update state elements */
+/* May need to disable updating of memory & condition codes */
+static void update_state(sim_ctx_ptr s, bool_t update_mem, bool_t update_cc)
+{
+    lock_ptr l = s->lock;
+
+    /* Writeback(s):
+       If either register is REG_NONE, write will have no effect .
+       Order of two writes determines semantics of
+       popl %rsp.  According to ISA, %rsp will get popped value
+    */
+
+    if (s->wb_destE != REG_NONE) {
+	sim_log("\tWriteback: Wrote 0x%llx to register %s\n",
+		s->wb_valE, reg_name(s->wb_destE));
+	set_reg_val(s->reg, s->wb_destE, s->wb_valE);
+	if (l)
+	    l->regs |= 1 << s->wb_destE;
+    }
+    if (s->wb_destM != REG_NONE) {
+	sim_log("\tWriteback: Wrote 0x%llx to register %s\n",
+		s->wb_valM, reg_name(s->wb_destM));
+	set_reg_val(s->reg, s->wb_destM, s->wb_valM);
+	if (l)
+	    l->regs |= 1 << s->wb_destM;
+    }
+    if (l)
+	l->store = FALSE;
+
+    /* Memory write */
+    if (s->mem_write && !update_mem) {
+	sim_log("\tDisabled write of 0x%llx to address 0x%llx\n",
+		s->mem_data, s->mem_addr);
+    }
+    if (update_mem && s->mem_write) {
+	if (!set_word_val(s->mem, s->mem_addr, s->mem_data)) {
+	    sim_log("\tCouldn't write to address 0x%llx\n", s->mem_addr);
+	} else {
+	    sim_log("\tWrote 0x%llx to address 0x%llx\n",
+		    s->mem_data, s->mem_addr);
+	    if (l) {
+		l->store = TRUE;
+		l->store_addr = s->mem_addr;
+		l->store_data = s->mem_data;
+	    }
+	    if (s->show_store)
+		s->show_store(s, s->mem_addr);
+	}
+    }
+    if (update_cc)
+	s->cc = s->cc_in;
+}
+
+/* Text representation of status */
+static void tty_report(sim_ctx_ptr s) {
+  sim_log("\nCycle %lld. CC=%s, Stat=%s\n", s->ccount, cc_name(s->cc),
+	  stat_name(s->status));
+
+  sim_log("F: predPC = 0x%llx\n", pc_curr->pc);
+
+  sim_log("D: instr = %s, rA = %s, rB = %s, valC = 0x%llx, valP = 0x%llx, Stat = %s\n",
+	  iname(HPACK(if_id_curr->icode, if_id_curr->ifun)),
+	  reg_name(if_id_curr->ra), reg_name(if_id_curr->rb),
+	  if_id_curr->valc, if_id_curr->valp,
+	  stat_name(if_id_curr->status));
+
+  sim_log("E: instr = %s, valC = 0x%llx, valA = 0x%llx, valB = 0x%llx\n   srcA = %s, srcB = %s, dstE = %s, dstM = %s, Stat = %s\n",
+	  iname(HPACK(id_ex_curr->icode, id_ex_curr->ifun)),
+	  id_ex_curr->valc, id_ex_curr->vala, id_ex_curr->valb,
+	  reg_name(id_ex_curr->srca), reg_name(id_ex_curr->srcb),
+	  reg_name(id_ex_curr->deste), reg_name(id_ex_curr->destm),
+	  stat_name(id_ex_curr->status));
+
+  sim_log("M: instr = %s, Cnd = %d, valE = 0x%llx, valA = 0x%llx\n   dstE = %s, dstM = %s, Stat = %s\n",
+	  iname(HPACK(ex_mem_curr->icode, ex_mem_curr->ifun)),
+	  ex_mem_curr->takebranch,
+	  ex_mem_curr->vale, ex_mem_curr->vala,
+	  reg_name(ex_mem_curr->deste), reg_name(ex_mem_curr->destm),
+	  stat_name(ex_mem_curr->status));
+
+  sim_log("W: instr = %s, valE = 0x%llx, valM = 0x%llx, dstE = %s, dstM = %s, Stat = %s\n",
+	  iname(HPACK(mem_wb_curr->icode, mem_wb_curr->ifun)),
+	  mem_wb_curr->vale, mem_wb_curr->valm,
+	  reg_name(mem_wb_curr->deste), reg_name(mem_wb_curr->destm),
+	  stat_name(mem_wb_curr->status));
+}
+
+/*
+ * Append the record for the current cycle of s to the trace (-T).  The
+ * pipe registers hold the state shown by tty_report, and the signals
+ * and pipe register controls are those that pipe_cycle just computed.
+ */
+static void trace_cycle(sim_ctx_ptr s)
+{
+    pipe_ptr pipes = s->pipes;
+    trace_rec_t rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.cycle = s->ccount;
+    rec.pc[TRACE_F] = s->f_pc;
+    rec.instr[TRACE_F] = HPACK(if_id_next->icode, if_id_next->ifun);
+    rec.stat[TRACE_F] = if_id_next->status;
+    rec.op[TRACE_F] = pipes[IF_STAGE].op;
+    rec.pc[TRACE_D] = if_id_curr->stage_pc;
+    rec.instr[TRACE_D] = HPACK(if_id_curr->icode, if_id_curr->ifun);
+    rec.stat[TRACE_D] = if_id_curr->status;
+    rec.op[TRACE_D] = pipes[ID_STAGE].op;
+    rec.pc[TRACE_E] = id_ex_curr->stage_pc;
+    rec.instr[TRACE_E] = HPACK(id_ex_curr->icode, id_ex_curr->ifun);
+    rec.stat[TRACE_E] = id_ex_curr->status;
+    rec.op[TRACE_E] = pipes[EX_STAGE].op;
+    rec.pc[TRACE_M] = ex_mem_curr->stage_pc;
+    rec.instr[TRACE_M] = HPACK(ex_mem_curr->icode, ex_mem_curr->ifun);
+    rec.stat[TRACE_M] = ex_mem_curr->status;
+    rec.op[TRACE_M] = pipes[MEM_STAGE].op;
+    rec.pc[TRACE_W] = mem_wb_curr->stage_pc;
+    rec.instr[TRACE_W] = HPACK(mem_wb_curr->icode, mem_wb_curr->ifun);
+    rec.stat[TRACE_W] = mem_wb_curr->status;
+    rec.op[TRACE_W] = pipes[WB_STAGE].op;
+    rec.vala = id_ex_next->vala;
+    rec.valb = id_ex_next->valb;
+    rec.vale = ex_mem_next->vale;
+    rec.valm = mem_wb_next->valm;
+    rec.cc = s->cc;
+    rec.status = s->status;
+    trace_write(&rec);
+}
+
+/* Compute the combinational logic of all stages for one cycle */
+static void pipe_cycle(sim_ctx_ptr s)
+{
+    /* Need to do decode after execute & memory stages,
+       and memory stage before execute, in order to propagate
+       forwarding values properly */
+    do_if_stage(s);
+    do_mem_stage(s);
+    do_ex_stage(s);
+    do_id_wb_stages(s);
+
+    do_stall_check(s);
+    if (s->icache || s->dcache)
+	cache_stall_check(s);
+    if (s->bp)
+	bp_cycle(s);
+}
+
+/* Run the pipeline of context s, which is sim_cur, for one cycle */
+/* Return status of processor */
+/* Max_instr indicates maximum number of instructions that
+   want to complete during this simulation run.  */
+static byte_t sim_step_pipe(sim_ctx_ptr s, word_t max_instr)
+{
+    pipe_ptr pipes = s->pipes;
+    byte_t wb_status = mem_wb_curr->status;
+    byte_t mem_status = mem_wb_next->status;
+    /* How many instructions are ahead of one in wb / ex? */
+    int ahead_mem = (wb_status != STAT_BUB);
+    int ahead_ex = ahead_mem + (mem_status != STAT_BUB);
+    bool_t update_mem = ahead_mem < max_instr;
+    bool_t update_cc = ahead_ex < max_instr;
+
+    p_stat_t ops[NUM_PIPES];
+    byte_t causes[NUM_PIPES];
+    word_t cause_pcs[NUM_PIPES];
+    bool_t bubbling;
+    int p;
+
+    /* Classify the bubbles that this update will inject */
+    bubbling = FALSE;
+    for (p = 0; p < NUM_PIPES; p++) {
+	ops[p] = pipes[p].op;
+	if (p != IF_STAGE && ops[p] == P_BUBBLE) {
+	    causes[p] = bubble_cause(s, p, &cause_pcs[p]);
+	    bubbling = TRUE;
+	}
+    }
+
+    /* Update program-visible state */
+    update_state(s, update_mem, update_cc);
+    /* Update pipe registers */
+    update_pipes(pipes, NUM_PIPES);
+    if (bubbling)
+	tag_bubbles(ops, causes, cause_pcs);
+    tty_report(s);
+    if (ops[IF_STAGE] == P_ERROR)
+	pc_curr->status = STAT_PIP;
+    if (ops[ID_STAGE] == P_ERROR)
+	if_id_curr->status = STAT_PIP;
+    if (ops[EX_STAGE] == P_ERROR)
+	id_ex_curr->status = STAT_PIP;
+    if (ops[MEM_STAGE] == P_ERROR)
+	ex_mem_curr->status = STAT_PIP;
+    if (ops[WB_STAGE] == P_ERROR)
+	mem_wb_curr->status = STAT_PIP;
+
+    pipe_cycle(s);
+    if (s->opts.trace)
+	trace_cycle(s);
+
+    /* Performance monitoring */
+    if (mem_wb_curr->status != STAT_BUB && mem_wb_curr->icode != I_POP2) {
+	s->starting_up = 0;
+	s->instructions++;
+	s->cycles++;
+	if (s->lock)
+	    lock_retire(s);
+    } else {
+	if (!s->starting_up) {
+	    s->cycles++;
+	    if (s->prof && mem_wb_curr->status == STAT_BUB)
+		prof_charge(s);
+	}
+    }
+
+    if (s->show_cycle)
+	s->show_cycle(s);
+    return s->status;
+}
+
+
+/*************************************
+ * Part 5: Simulation contexts (see sim.h)
+ *************************************/
+
+sim_ctx_ptr sim_ctx_new(mem_t m, word_t pc, sim_opts_ptr opts)
+{
+    sim_ctx_ptr c = calloc(1, sizeof(sim_ctx_rec));
+
+    if (opts)
+	c->opts = *opts;
+    c->mem = m;
+    c->reg = init_reg();
+    c->cc = c->cc_in = DEFAULT_CC;
+    c->status = STAT_AOK;
+    c->wb_destE = c->wb_destM = REG_NONE;
+    c->amux = c->bmux = MUX_NONE;
+    c->starting_up = 1;
+    init_pipe(&c->pipes[IF_STAGE], sizeof(pc_ele), &bubble_pc);
+    init_pipe(&c->pipes[ID_STAGE], sizeof(if_id_ele), &bubble_if_id);
+    init_pipe(&c->pipes[EX_STAGE], sizeof(id_ex_ele), &bubble_id_ex);
+    init_pipe(&c->pipes[MEM_STAGE], sizeof(ex_mem_ele), &bubble_ex_mem);
+    init_pipe(&c->pipes[WB_STAGE], sizeof(mem_wb_ele), &bubble_mem_wb);
+    /* The first update loads the PC from the next state */
+    ((pc_ptr) c->pipes[IF_STAGE].current)->pc = pc;
+    ((pc_ptr) c->pipes[IF_STAGE].next)->pc = pc;
+    c->run_status = STAT_AOK;
+    /* Each context starts with empty caches and predictor of its own */
+    if (c->opts.icache.size)
+	c->icache = new_cache(&c->opts.icache);
+    if (c->opts.dcache.size)
+	c->dcache = new_cache(&c->opts.dcache);
+    if (c->opts.bp)
+	c->bp = new_bp(c->opts.bp);
+    if (c->opts.profile)
+	c->prof = calloc(1, sizeof(prof_rec));
+    return c;
+}
+
+void sim_ctx_free(sim_ctx_ptr c)
+{
+    int p;
+    free_mem(c->mem);
+    free_mem(c->reg);
+    for (p = 0; p < NUM_PIPES; p++)
+	free_pipe(&c->pipes[p]);
+    free_cache(c->icache);
+    free_cache(c->dcache);
+    free(c->bp);
+    if (c->prof)
+	free(c->prof->pc_costs);
+    free(c->prof);
+    free(c->lock);
+    if (sim_cur == c)
+	sim_cur = NULL;
+    free(c);
+}
+
+/* Simulate one cycle of context c, which is sim_cur and not done */
+static bool_t ctx_cycle(sim_ctx_ptr c, word_t max_instr, word_t max_cycle)
+{
+    if (c->icount >= max_instr || c->ccount >= max_cycle)
+	return FALSE;
+    c->run_status = sim_step_pipe(c, max_instr - c->icount);
+    if (c->run_status != STAT_BUB)
+	c->icount++;
+    if ((c->run_status != STAT_AOK && c->run_status != STAT_BUB) ||
+	(c->lock && c->lock->failed)) {
+	c->done = TRUE;
+	return FALSE;
+    }
+    c->ccount++;
+    return TRUE;
+}
+
+bool_t sim_ctx_step(sim_ctx_ptr c, word_t max_instr, word_t max_cycle)
+{
+    if (c->done)
+	return FALSE;
+    sim_cur = c;
+    return ctx_cycle(c, max_instr, max_cycle);
+}
+
+byte_t sim_ctx_run(sim_ctx_ptr c, word_t max_instr, word_t max_cycle)
+{
+    if (!c->done) {
+	sim_cur = c;
+	while (ctx_cycle(c, max_instr, max_cycle))
+	    ;
+    }
+    return c->run_status;
+}
+
+bool_t sim_ctx_check(sim_ctx_ptr c, word_t max_instr, word_t max_cycle)
+{
+    state_ptr isa = new_state(0);
+    bool_t match;
+
+    free_mem(isa->r);
+    free_mem(isa->m);
+    isa->m = copy_mem(c->mem);
+    isa->r = copy_mem(c->reg);
+    isa->cc = c->cc;
+    isa->pc = ((pc_ptr) c->pipes[IF_STAGE].next)->pc;
+    sim_ctx_lock(c, isa, -1);
+    sim_ctx_run(c, max_instr, max_cycle);
+    match = sim_ctx_unlock(c) && isa->cc == c->cc;
+    free_state(isa);
+    return match;
+}
+
+/*
+ * Sampled simulation (-S).  The pipeline of the context is emptied and
+ * started from the state of the ISA simulator.  Unlike sim_ctx_run,
+ * this counts the instructions reaching write-back, so that the state
+ * left behind is that of the ISA simulator after the same number of
+ * steps.  The caches and the profile carry over from one sample to
+ * the next.
+ */
+word_t sim_ctx_sample(sim_ctx_ptr c, state_ptr s, word_t warm, word_t detail,
+		      word_t *ncycles, word_t *ninstr, byte_t *statusp)
+{
+    word_t max_instr = warm + detail;
+    word_t start = c->instructions;
+    word_t icount = 0;
+    word_t cycles0 = c->cycles, instructions0 = c->instructions;
+    byte_t run_status = STAT_AOK;
+
+    sim_cur = c;
+    clear_pipes(c->pipes, NUM_PIPES);
+    free_mem(c->mem);
+    c->mem = copy_mem(s->m);
+    free_mem(c->reg);
+    c->reg = copy_mem(s->r);
+    c->cc = c->cc_in = s->cc;
+    /* The first cycle loads the pipe registers from their next side */
+    pc_curr->pc = pc_next->pc = s->pc;
+    c->status = STAT_AOK;
+    c->wb_destE = c->wb_destM = REG_NONE;
+    c->mem_write = FALSE;
+    c->starting_up = 1;
+
+    for (c->ccount = 0; icount < max_instr && c->ccount < 5*max_instr;
+	 c->ccount++) {
+	/* sim_step_pipe counts the instruction in W among those still
+	   to complete, but it has been counted here already */
+	word_t in_wb = mem_wb_curr->status != STAT_BUB;
+	run_status = sim_step_pipe(c, max_instr-icount+in_wb);
+	if (c->instructions - start > icount) {
+	    icount = c->instructions - start;
+	    if (icount == warm) {
+		cycles0 = c->cycles;
+		instructions0 = c->instructions;
+	    }
+	}
+	if (run_status != STAT_AOK && run_status != STAT_BUB)
+	    break;
+    }
+    /* The last instruction to complete has yet to write its registers */
+    update_state(c, FALSE, FALSE);
+    *ncycles = icount > warm ? c->cycles - cycles0 : 0;
+    *ninstr = icount > warm ? c->instructions - instructions0 : 0;
+    *statusp = c->run_status = run_status;
+    return icount;
+}
+
+/*
+ * Checkpoints (-C n:f, -R f).  A checkpoint holds everything that the
+ * rest of a run depends on: the instruction and cycle counts, the
+ * program-visible state and the updates pending for it, the current
+ * and next contents and the control of every pipe register, the
+ * signals that -p reads from the previous cycle, the caches, and the
+ * profile counters.  It also holds the memory and registers the run
+ * started with, so that a resumed run reports the same changes as an
+ * uninterrupted one.  The file is in the byte order of the machine
+ * that wrote it, and only a psim built from the same HCL file and run
+ * with the same -p, -I and -D options can resume it.
+ */
+
+#define CKPT_MAGIC "PSIMCKPT"
+
+/* A checkpoint being written or read */
+typedef struct {
+    FILE *file;
+    bool_t writing;
+    char *error;    /* What went wrong, or NULL */
+} ckpt_rec, *ckpt_ptr;
+
+/* Write or read n bytes at p, depending on the direction of the transfer */
+static void ckpt_io(ckpt_ptr ck, void *p, size_t n)
+{
+    if (ck->error)
+	return;
+    if (ck->writing ? fwrite(p, 1, n, ck->file) != n
+	: fread(p, 1, n, ck->file) != n)
+	ck->error = ck->writing ? "write error" : "file is truncated";
+}
+
+#define CKPT_IO(ck, v) ckpt_io(ck, &(v), sizeof(v))
+
+/* Transfer memory *mp, replacing it when reading */
+static void ckpt_mem(ckpt_ptr ck, mem_t *mp)
+{
+    word_t len = 0, size = 0;
+    char *buf = NULL;
+    size_t bsize = 0;
+    FILE *img;
+
+    if (ck->writing) {
+	/* The image goes through a buffer, since load_mem reads to EOF */
+	img = open_memstream(&buf, &bsize);
+	save_mem(*mp, img);
+	fclose(img);
+	len = (*mp)->len;
+	size = bsize;
+	CKPT_IO(ck, len);
+	CKPT_IO(ck, size);
+	ckpt_io(ck, buf, bsize);
+	free(buf);
+	return;
+    }
+    CKPT_IO(ck, len);
+    CKPT_IO(ck, size);
+    if (ck->error)
+	return;
+    if (len <= 0 || size < IMG_MAGIC_LEN) {
+	ck->error = "bad memory image";
+	return;
+    }
+    buf = malloc(size);
+    ckpt_io(ck, buf, size);
+    if (!ck->error) {
+	mem_t m = init_mem(len);
+	if ((img = fmemopen(buf, size, "r")) == NULL) {
+	    ck->error = "bad memory image";
+	    free_mem(m);
+	} else {
+	    load_mem(m, img, 1);
+	    fclose(img);
+	    if (*mp)
+		free_mem(*mp);
+	    *mp = m;
+	}
+    }
+    free(buf);
+}
+
+/* Transfer cache c, which must have the geometry that it was saved with */
+static void ckpt_cache(ckpt_ptr ck, cache_ptr c)
+{
+    bool_t present = c != NULL;
+    cache_cfg_rec cfg;
+    size_t ways;
+
+    CKPT_IO(ck, present);
+    if (present != (c != NULL)) {
+	if (!ck->error)
+	    ck->error = "written with different -I or -D options";
+	return;
+    }
+    if (!c)
+	return;
+    cfg = c->cfg;
+    CKPT_IO(ck, cfg);
+    if (!ck->error && memcmp(&cfg, &c->cfg, sizeof(cfg)) != 0) {
+	ck->error = "written with different -I or -D options";
+	return;
+    }
+    ways = (size_t) c->sets * c->cfg.assoc;
+    ckpt_io(ck, c->tags, ways * sizeof(word_t));
+    ckpt_io(ck, c->used, ways * sizeof(word_t));
+    CKPT_IO(ck, c->clock);
+    CKPT_IO(ck, c->accesses);
+    CKPT_IO(ck, c->misses);
+    CKPT_IO(ck, c->busy);
+    CKPT_IO(ck, c->busy_addr);
+    CKPT_IO(ck, c->wait);
+}
+
+/* Transfer the profile counters of context s, which are all zero
+   without a profile */
+static void ckpt_profile(ckpt_ptr ck, sim_ctx_ptr s)
+{
+    prof_rec none;
+    prof_ptr p = s->prof ? s->prof : &none;
+    bool_t profiled = s->prof != NULL;
+    word_t n, i;
+    pc_cost_rec rec;
+
+    memset(&none, 0, sizeof(none));
+    n = p->pc_cost_count;
+    CKPT_IO(ck, profiled);
+    if (!ck->error && profiled != (s->prof != NULL)) {
+	ck->error = "written with a different -p option";
+	return;
+    }
+    ckpt_io(ck, p->cause_cycles, sizeof(p->cause_cycles));
+    CKPT_IO(ck, n);
+    if (ck->writing) {
+	for (i = 0; i < p->pc_cost_size; i++)
+	    if (p->pc_costs[i].pc != -1)
+		CKPT_IO(ck, p->pc_costs[i]);
+	return;
+    }
+    for (i = 0; i < n && !ck->error; i++) {
+	CKPT_IO(ck, rec);
+	if (!ck->error)
+	    *find_pc_cost(p, rec.pc) = rec;
+    }
+}
+
+/*
+ * Transfer the whole state of context s, with the initial memory and
+ * registers of its run in *mem0p and *reg0p
+ */
+static void ckpt_state(ckpt_ptr ck, sim_ctx_ptr s, mem_t *mem0p, mem_t *reg0p)
+{
+    pipe_ptr pipes = s->pipes;
+    char magic[8], name[48];
+    int p, count;
+
+    /* Header: which simulator wrote it */
+    memcpy(magic, CKPT_MAGIC, sizeof(magic));
+    memset(name, 0, sizeof(name));
+    strncpy(name, simname, sizeof(name)-1);
+    CKPT_IO(ck, magic);
+    if (!ck->error && memcmp(magic, CKPT_MAGIC, sizeof(magic)) != 0) {
+	ck->error = "not a checkpoint file";
+	return;
+    }
+    CKPT_IO(ck, name);
+    if (!ck->error && strncmp(name, simname, sizeof(name)-1) != 0) {
+	ck->error = "written by a psim built from a different HCL file";
+	return;
+    }
+    for (p = 0; p < NUM_PIPES; p++) {
+	count = pipes[p].count;
+	CKPT_IO(ck, count);
+	if (!ck->error && count != pipes[p].count) {
+	    ck->error = "written by a different version of psim";
+	    return;
+	}
+    }
+
+    /* Run control and program-visible state */
+    CKPT_IO(ck, s->icount);
+    CKPT_IO(ck, s->ccount);
+    CKPT_IO(ck, s->cycles);
+    CKPT_IO(ck, s->instructions);
+    CKPT_IO(ck, s->starting_up);
+    CKPT_IO(ck, s->cc);
+    CKPT_IO(ck, s->cc_in);
+    CKPT_IO(ck, s->status);
+    CKPT_IO(ck, s->wb_destE);
+    CKPT_IO(ck, s->wb_valE);
+    CKPT_IO(ck, s->wb_destM);
+    CKPT_IO(ck, s->wb_valM);
+    CKPT_IO(ck, s->mem_addr);
+    CKPT_IO(ck, s->mem_data);
+    CKPT_IO(ck, s->mem_write);
+    CKPT_IO(ck, s->f_pc);
+    CKPT_IO(ck, s->icache_stalled);
+    CKPT_IO(ck, s->dcache_stalled);
+
+    /* Pipe registers */
+    for (p = 0; p < NUM_PIPES; p++) {
+	CKPT_IO(ck, pipes[p].op);
+	ckpt_io(ck, pipes[p].current, pipes[p].count);
+	ckpt_io(ck, pipes[p].next, pipes[p].count);
+    }
+
+    ckpt_cache(ck, s->icache);
+    ckpt_cache(ck, s->dcache);
+    ckpt_profile(ck, s);
+    ckpt_mem(ck, &s->reg);
+    ckpt_mem(ck, &s->mem);
+    ckpt_mem(ck, reg0p);
+    ckpt_mem(ck, mem0p);
+}
+
+char *sim_ctx_save(sim_ctx_ptr c, FILE *f, mem_t mem0, mem_t reg0)
+{
+    ckpt_rec ck = { f, TRUE, NULL };
+    ckpt_state(&ck, c, &mem0, &reg0);
+    return ck.error;
+}
+
+char *sim_ctx_restore(sim_ctx_ptr c, FILE *f, mem_t *mem0p, mem_t *reg0p)
+{
+    ckpt_rec ck = { f, FALSE, NULL };
+    *mem0p = *reg0p = NULL;
+    ckpt_state(&ck, c, mem0p, reg0p);
+    return ck.error;
+}
@@ -1,3 +1,14 @@
+#ifndef SIM_H
+#define SIM_H
+
+/*
+ * Interface to the core of the PIPE simulator (sim.c).  The core keeps
+ * all of the state of a simulated machine in a simulation context, so
+ * that one process can simulate any number of machines, in turn on one
+ * thread or at the same time on several.  It has no user interface:
+ * psim.c is the command line front end, and psim-gui.c the optional
+ * Tcl/Tk interface.
+ */
 
 /********** Typedefs ************/
 
@@ -11,6 +22,10 @@ typedef enum { S_WEDGED, S_STALL, S_FORWARD } sim_mode_t;
 /* Pipeline stage identifiers for stage operation control */
 typedef enum { IF_STAGE, ID_STAGE, EX_STAGE, MEM_STAGE, WB_STAGE } stage_id_t;
 
+/* Why a bubble was injected into the pipeline (-p profiling) */
+typedef enum { CAUSE_NONE, CAUSE_LOAD_USE, CAUSE_MISPREDICT, CAUSE_RET,
+	       CAUSE_ICACHE, CAUSE_DCACHE, CAUSE_OTHER, NUM_CAUSES } bubble_cause_t;
+
 /********** Defines **************/
 
 /* Get ra out of one byte regid field */
@@ -20,134 +35,250 @@ typedef enum { IF_STAGE, ID_STAGE, EX_STAGE, MEM_STAGE, WB_STAGE } stage_id_t;
 #define GET_RB(r) LO4(r)
 
 
-/************ Global state declaration ****************/
-
-/* How many cycles have been simulated? */
-extern word_t cycles;
-/* How many instructions have passed through the EX stage? */
-extern word_t instructions;
-
-/* Both instruction and data memory */
-extern mem_t mem;
-
-/* Keep track of range of addresses that have been written */
-extern word_t minAddr;
-extern word_t memCnt;
-
-/* Register file */
-extern mem_t reg;
-/* Condition code register */
-extern cc_t cc;
-extern stat_t stat;
-
-/* Operand sources in EX (to show forwarding) */
-extern mux_source_t amux, bmux;
-
-/* Provide global access to current states of all pipeline registers */
-pipe_ptr pc_state, if_id_state, id_ex_state, ex_mem_state, mem_wb_state;
-
-/* Current States */
-extern pc_ptr pc_curr;
-extern if_id_ptr if_id_curr;
-extern id_ex_ptr id_ex_curr;
-extern ex_mem_ptr ex_mem_curr;
-extern mem_wb_ptr mem_wb_curr;
-
-/* Next States */
-extern pc_ptr pc_next;
-extern if_id_ptr if_id_next;
-extern id_ex_ptr id_ex_next;
-extern ex_mem_ptr ex_mem_next;
-extern mem_wb_ptr mem_wb_next;
-
-/* Pending updates to state */
-extern word_t cc_in;
-extern word_t wb_destE;
-extern word_t wb_valE;
-extern word_t wb_destM;
-extern word_t wb_valM;
-extern word_t mem_addr;
-extern word_t mem_data;
-extern bool_t mem_write;
-
-
-/* Intermdiate stage values that must be used by control functions */
-extern word_t f_pc;
-extern byte_t imem_icode;
-extern byte_t imem_ifun;
-extern bool_t imem_error;
-extern bool_t instr_valid;
-extern word_t d_regvala;
-extern word_t d_regvalb;
-extern word_t e_vala;
-extern word_t e_valb;
-extern bool_t e_bcond;
-extern bool_t dmem_error;
-
-/* Simulator operating mode */
-extern sim_mode_t sim_mode;
-/* Log file */
-extern FILE *dumpfile;
-
-/*************** Simulation Control Functions ***********/
-
-/* Bubble next execution of specified stage */
-void sim_bubble_stage(stage_id_t stage);
-
-/* Stall stage (has effect at next update) */
-void sim_stall_stage(stage_id_t stage);
-
-/* Sets the simulator name (called from main routine in HCL file) */
-void set_simname(char *name);
-
-/* Initialize simulator */
-void sim_init();
-
-/* Reset simulator state, including register, instruction, and data memories */
-void sim_reset();
+/* Number of pipeline registers */
+#define NUM_PIPES 5
+
+/* Default cache latencies in cycles (-I, -D) */
+#define CACHE_HIT 1
+#define CACHE_MISS 10
+
+/* Storage class of the per-thread pointer to the context being simulated */
+#define SIM_TLS __thread
+
+/*************** Simulation Options ***********/
+
+/* Geometry and latencies of an L1 cache */
+typedef struct {
+    word_t size;        /* Capacity in bytes (0 if absent) */
+    int assoc;          /* Ways per set */
+    int block;          /* Block size in bytes */
+    int hit_cycles;
+    int miss_cycles;
+} cache_cfg_rec;
+
+/* A branch prediction model (see sim_bp_model) */
+typedef struct bp_model_rec *bp_model_ptr;
 
 /*
-  Run pipeline until one of following occurs:
-  - A status error is encountered in WB.
-  - max_instr instructions have completed through WB
-  - max_cycle cycles have been simulated
-
-  Return number of instructions executed.
-  if statusp nonnull, then will be set to status of final instruction
-  if ccp nonnull, then will be set to condition codes of final instruction
-*/
-word_t sim_run_pipe(word_t max_instr, word_t max_cycle, byte_t *statusp, cc_t *ccp);
+ * What a context models and records besides the pipeline itself.  All
+ * zero gives the plain pipeline of the HCL file.  Only one context at
+ * a time can write to the trace file, which trace_open has opened.
+ */
+typedef struct sim_opts_rec {
+    cache_cfg_rec icache;   /* L1 instruction cache (-I) */
+    cache_cfg_rec dcache;   /* L1 data cache (-D) */
+    bp_model_ptr bp;        /* Branch predictor (-B), or NULL */
+    bool_t profile;         /* Attribute lost cycles to their causes (-p) */
+    bool_t trace;           /* Append every cycle to the trace file (-T) */
+    FILE *log;              /* Where to log every cycle, or NULL */
+} sim_opts_rec, *sim_opts_ptr;
 
-/* If dumpfile set nonNULL, lots of status info printed out */
-void sim_set_dumpfile(FILE *file);
+/*
+ * Parse an L1 cache geometry given as size:assoc:block[:hit[:miss]],
+ * where size may have a K/M suffix.  Returns FALSE if it is invalid
+ */
+bool_t sim_parse_cache(char *spec, cache_cfg_rec *cfg);
+
+/* Find the branch prediction model called name, or return NULL */
+bp_model_ptr sim_bp_model(char *name);
+
+/*************** Simulation Contexts ***********/
+
+/* State of the caches, the branch predictor, the -p profile and the
+   lockstep check, kept in sim.c */
+struct cache_rec;
+struct bp_rec;
+struct prof_rec;
+struct lock_rec;
 
 /*
- * sim_log dumps a formatted string to the dumpfile, if it exists
- * accepts variable argument list
+ * A simulation context holds one machine: its program-visible state,
+ * the pending updates, the pipeline registers and the signals computed
+ * from them, its caches, branch predictor and counters, and the
+ * control of its run.
  */
-void sim_log( const char *format, ... );
+typedef struct sim_ctx_rec {
+    sim_opts_rec opts;
+
+    /* Program-visible state */
+    mem_t mem;           /* Both instruction and data memory */
+    mem_t reg;           /* Register file */
+    cc_t cc;             /* Condition code register */
+    stat_t status;       /* Status code */
+
+    /* Pending updates to state */
+    word_t cc_in;
+    word_t wb_destE, wb_valE, wb_destM, wb_valM;
+    word_t mem_addr, mem_data;
+    bool_t mem_write;
+
+    /* Pipe registers, indexed by stage_id_t */
+    pipe_ele pipes[NUM_PIPES];
+
+    /* Intermediate stage values.  The control logic reads those from
+       imem_icode on under the names defined below */
+    word_t f_pc;
+    bool_t e_bcond;
+    bool_t mem_read;
+    byte_t imem_icode;
+    byte_t imem_ifun;
+    bool_t imem_error;
+    bool_t instr_valid;
+    word_t d_regvala;
+    word_t d_regvalb;
+    bool_t dmem_error;
+    word_t bp_target;    /* Target of a fetched jump or ret chosen by
+			    the branch predictor (-B) */
+
+    /* Operand sources in EX (to show forwarding) */
+    mux_source_t amux, bmux;
+
+    /* Performance monitoring */
+    word_t cycles;       /* Cycles simulated after the initial bubbles */
+    word_t instructions; /* Instructions that have passed through WB */
+    int starting_up;     /* Still in the initial bubbles? */
+
+    /* Run control, as counted by sim_ctx_run */
+    word_t icount, ccount;
+    byte_t run_status;
+    bool_t done;         /* Stopped by an error status or a divergence */
+
+    /* Caches, and whether they held up fetch or memory in the last
+       cycle (for -p) */
+    struct cache_rec *icache, *dcache;
+    bool_t icache_stalled, dcache_stalled;
+
+    /* Branch predictor, profile and lockstep check, or NULL if unused */
+    struct bp_rec *bp;
+    struct prof_rec *prof;
+    struct lock_rec *lock;
+
+    /* Called, if set, after every cycle and after every write to
+       memory, so that a display such as the GUI can follow the run */
+    void (*show_cycle)(struct sim_ctx_rec *c);
+    void (*show_store)(struct sim_ctx_rec *c, word_t addr);
+} sim_ctx_rec, *sim_ctx_ptr;
 
- 
-/******************* GUI Interface Functions **********************/
-#ifdef HAS_GUI
+/*
+ * The context that the calling thread is simulating, and the names by
+ * which the signal declarations of the HCL files refer to its state.
+ * The control logic that hcl2c generates takes no arguments, so it
+ * finds the context here.
+ */
+extern SIM_TLS sim_ctx_ptr sim_cur;
+
+#define pc_curr     ((pc_ptr) sim_cur->pipes[IF_STAGE].current)
+#define pc_next     ((pc_ptr) sim_cur->pipes[IF_STAGE].next)
+#define if_id_curr  ((if_id_ptr) sim_cur->pipes[ID_STAGE].current)
+#define if_id_next  ((if_id_ptr) sim_cur->pipes[ID_STAGE].next)
+#define id_ex_curr  ((id_ex_ptr) sim_cur->pipes[EX_STAGE].current)
+#define id_ex_next  ((id_ex_ptr) sim_cur->pipes[EX_STAGE].next)
+#define ex_mem_curr ((ex_mem_ptr) sim_cur->pipes[MEM_STAGE].current)
+#define ex_mem_next ((ex_mem_ptr) sim_cur->pipes[MEM_STAGE].next)
+#define mem_wb_curr ((mem_wb_ptr) sim_cur->pipes[WB_STAGE].current)
+#define mem_wb_next ((mem_wb_ptr) sim_cur->pipes[WB_STAGE].next)
+
+#define imem_icode  (sim_cur->imem_icode)
+#define imem_ifun   (sim_cur->imem_ifun)
+#define imem_error  (sim_cur->imem_error)
+#define instr_valid (sim_cur->instr_valid)
+#define d_regvala   (sim_cur->d_regvala)
+#define d_regvalb   (sim_cur->d_regvalb)
+#define dmem_error  (sim_cur->dmem_error)
+#define bp_target   (sim_cur->bp_target)
+
+/* Create a context with options opts (or none, if NULL) that runs the
+   program in memory m (which it takes over) from address pc */
+sim_ctx_ptr sim_ctx_new(mem_t m, word_t pc, sim_opts_ptr opts);
+
+/* Free context c and its memory */
+void sim_ctx_free(sim_ctx_ptr c);
 
-void signal_sources();
+/*
+  Simulate one cycle of context c, unless it is done or has reached
+  max_instr instructions or max_cycle cycles.  It is done once it
+  reaches an error status in WB.  Returns FALSE if it was not stepped,
+  or is done now.
+*/
+bool_t sim_ctx_step(sim_ctx_ptr c, word_t max_instr, word_t max_cycle);
 
-void signal_register_clear();
+/* Run context c until it is done or reaches the limits, as for
+   sim_ctx_step.  Returns the status of its last cycle */
+byte_t sim_ctx_run(sim_ctx_ptr c, word_t max_instr, word_t max_cycle);
 
-void report_pc(unsigned fpc, unsigned char fpcv,
-	       unsigned dpc, unsigned char dpcv,
-	       unsigned epc, unsigned char epcv,
-	       unsigned mpc, unsigned char mpcv,
-	       unsigned wpc, unsigned char wpcv);
+/*
+  Run context c, which has not been stepped yet, checking each
+  instruction against the ISA simulator as psim -t does, without
+  printing anything.  The run stops at the first divergence.  Returns
+  TRUE if the two agree throughout, including the final condition codes.
+*/
+bool_t sim_ctx_check(sim_ctx_ptr c, word_t max_instr, word_t max_cycle);
 
-void report_state(char *id, word_t current, char *txt);
+/*
+  Check each instruction of context c, which has not been stepped yet,
+  against the ISA simulator state isa, which is at the same point of
+  the program.  The run is done at the first divergence.  If verbosity
+  is not negative, the divergence is printed, and at verbosity 1 or
+  more, so are the values that differ.
+*/
+void sim_ctx_lock(sim_ctx_ptr c, state_ptr isa, int verbosity);
+
+/* Check the last instruction of the run of context c, stop checking,
+   and return TRUE if all instructions matched */
+bool_t sim_ctx_unlock(sim_ctx_ptr c);
+
+/*
+  Sampled simulation: empty the pipeline of context c and start it from
+  the architectural state s.  Run it until warm+detail instructions
+  have reached write-back, the pipeline stops with an error, or
+  5*(warm+detail) cycles pass, and leave the state of the ISA simulator
+  after the same number of steps in c.  Set *ncycles to the cycles
+  taken by the instructions after the first warm, *ninstr to their
+  number, and *statusp to the status of the last cycle.  Returns the
+  number of instructions completed.
+*/
+word_t sim_ctx_sample(sim_ctx_ptr c, state_ptr s, word_t warm, word_t detail,
+		      word_t *ncycles, word_t *ninstr, byte_t *statusp);
+
+/*
+  Write a checkpoint of context c to file f, with the memory mem0 and
+  registers reg0 that its run started with.  Returns NULL, or a
+  description of what went wrong.
+*/
+char *sim_ctx_save(sim_ctx_ptr c, FILE *f, mem_t mem0, mem_t reg0);
+
+/*
+  Restore the checkpoint in file f into context c, which has not been
+  stepped yet and has the options that the checkpointed one had, and
+  set *mem0p and *reg0p to the initial memory and registers of its
+  run.  Returns NULL, or a description of what went wrong.
+*/
+char *sim_ctx_restore(sim_ctx_ptr c, FILE *f, mem_t *mem0p, mem_t *reg0p);
+
+/*************** Reports ***********/
+
+/* Print the hit rates of the caches of context c */
+void sim_print_caches(sim_ctx_ptr c);
 
-void show_cc(cc_t cc);
-void show_cpi();
-void show_stat(stat_t stat);
+/* Print the lost cycles of context c by cause and by PC (-p) */
+void sim_print_profile(sim_ctx_ptr c);
+
+/* List the branch prediction models */
+void sim_print_bp_models();
+
+/*
+  Report the accuracy of the branch predictor of context c, whose run
+  has finished, and the cycles it saved over the pipe-std policy.  The
+  program is rerun from address 0 of the initial memory mem0 for the
+  baseline and, if all is set, for every other model.
+*/
+void sim_print_bp_compare(sim_ctx_ptr c, mem_t mem0, bool_t all,
+			  word_t max_instr);
+
+/*
+ * sim_log dumps a formatted string to the log of the context being
+ * simulated, if it has one.  accepts variable argument list
+ */
+void sim_log( const char *format, ... );
 
-void create_memory_display();
-void set_memory(word_t addr, word_t val);
-#endif
-								       
+#endif /* SIM_H */
@@ -1,7 +1,9 @@
 /* 
  * stages.h - Defines the layout of the pipe registers
- * Declares the functions that implement the pipeline stages
 */
+#ifndef STAGES_H
+#define STAGES_H
+
 
 /********** Pipeline register contents **************/
 
@@ -22,6 +24,12 @@ typedef struct {
     stat_t status;
     /* The following is included for debugging */
     word_t stage_pc;
+    /* For a bubble, why it was injected and the PC of the instruction
+       blamed for it (see bubble_cause_t) */
+    byte_t cause;
+    word_t cause_pc;
+    /* For a jump or ret, the target chosen by the branch predictor */
+    word_t predpc;
 } if_id_ele, *if_id_ptr;
 
 /* ID/EX Pipe Register */
@@ -38,6 +46,12 @@ typedef struct {
     stat_t status;
     /* The following is included for debugging */
     word_t stage_pc;
+    /* For a bubble, why it was injected and the PC of the instruction
+       blamed for it (see bubble_cause_t) */
+    byte_t cause;
+    word_t cause_pc;
+    /* For a jump or ret, the target chosen by the branch predictor */
+    word_t predpc;
 } id_ex_ele, *id_ex_ptr;
 
 /* EX/MEM Pipe Register */
@@ -53,6 +67,12 @@ typedef struct {
     stat_t status;
     /* The following is included for debugging */
     word_t stage_pc;
+    /* For a bubble, why it was injected and the PC of the instruction
+       blamed for it (see bubble_cause_t) */
+    byte_t cause;
+    word_t cause_pc;
+    /* For a jump or ret, the target chosen by the branch predictor */
+    word_t predpc;
 } ex_mem_ele, *ex_mem_ptr;
 
 /* Mem/WB Pipe Register */
@@ -66,6 +86,12 @@ typedef struct {
     stat_t status;
     /* The following is included for debugging */
     word_t stage_pc;
+    /* For a bubble, why it was injected and the PC of the instruction
+       blamed for it (see bubble_cause_t) */
+    byte_t cause;
+    word_t cause_pc;
+    /* For a jump or ret, the target chosen by the branch predictor */
+    word_t predpc;
 } mem_wb_ele, *mem_wb_ptr;
 
 /************ Global Declarations ********************/
@@ -76,15 +102,4 @@ extern id_ex_ele bubble_id_ex;
 extern ex_mem_ele bubble_ex_mem;
 extern mem_wb_ele bubble_mem_wb;
 
-/************ Function declarations *******************/
-
-/* Stage functions */
-void do_if_stage();
-void do_id_wb_stages();  /* Both ID and WB */
-void do_ex_stage();
-void do_mem_stage();
-
-/* Set stalling conditions for different stages */
-void do_stall_check();
-
-
+#endif /* STAGES_H */
@@ -0,0 +1,395 @@
+#!/usr/bin/perl
+#!/usr/local/bin/perl
+
+#
+# tune-ncopy.pl - Search a space of ncopy implementations for the best
+#                 tradeoffs between CPE and code size
+#
+# Each candidate is generated from one template, parameterized by
+#   - the unroll factor u of the main loop, from 1 to 10;
+#   - the schedule of the loads in each pass of the main loop:
+#       naive:  load, store and count one word at a time
+#       pair:   load two words, store both, count both
+#       group:  load all u words, then store them, then count them
+#   - how the 0 to u-1 words left over by the main loop are copied:
+#       loop:   a loop over one word at a time
+#       chain:  straight-line code that tests the length after each word
+#       table:  a jump table into a chain that needs no tests
+#   - how the positive words are counted:
+#       branch: a conditional jump around an increment of %rax
+#       cmov:   an increment of a copy of %rax, moved in with cmovg
+# Candidates use iaddq, so psim must be built with VERSION=full.
+#
+# Every candidate is assembled and evaluated with one run of
+# psim --sweep, which checks it for correctness on all lengths from 0
+# to 64 and rejects it if it is longer than the byte limit that
+# check-len.pl measures.  The candidates are evaluated in parallel.
+# The correct candidates that no other correct candidate beats on
+# both CPE and length form the Pareto frontier, which is printed in
+# order of length.
+#
+use Getopt::Std;
+
+#
+# Configuration
+#
+$yas = "../misc/yas";
+$pipe = "./psim";
+$fname = "tdriver";
+$verbose = 0;
+# Maximum allowable code length, as enforced by psim --sweep
+$bytelim = 1000;
+@unrolls = (1..10);
+@scheds = ("naive", "pair", "group");
+@rems = ("loop", "chain", "table");
+@counts = ("branch", "cmov");
+# Registers for the words in flight, in order of use
+@regs = ("%r8", "%r9", "%r10", "%r11", "%r12", "%r13", "%r14",
+	 "%rcx", "%rbx", "%rbp");
+# Scratch register for cmov counting, which leaves one fewer for words
+$cmovreg = "%rbp";
+
+#
+# usage - Print the help message and terminate
+#
+sub usage {
+    print STDERR "Usage: $0 [-hv] [-j N] [-u LIST] [-k DIR]\n";
+    print STDERR "   -h      Print help message\n";
+    print STDERR "   -v      Print the result of every candidate\n";
+    print STDERR "   -j N    Evaluate N candidates at a time (default: one per CPU)\n";
+    print STDERR "   -u LIST Try only the comma-separated unroll factors in LIST\n";
+    print STDERR "   -k DIR  Keep the source of each frontier candidate in DIR\n";
+    die "\n";
+}
+
+getopts('hvj:u:k:');
+
+if ($opt_h) {
+    usage();
+}
+
+if ($opt_v) {
+    $verbose = 1;
+}
+
+$jobs = `getconf _NPROCESSORS_ONLN 2>/dev/null`;
+chomp $jobs;
+if ($opt_j) {
+    $jobs = $opt_j;
+}
+if ($jobs !~ /^\d+$/ || $jobs < 1) {
+    $jobs = 1;
+}
+
+if ($opt_u) {
+    @unrolls = split(/,/, $opt_u);
+    foreach $u (@unrolls) {
+	if ($u !~ /^\d+$/ || $u < 1 || $u > @regs) {
+	    print STDERR "Unroll factors must be between 1 and " .
+		scalar(@regs) . "\n";
+	    die "\n";
+	}
+    }
+}
+
+if ($opt_k && !-d $opt_k) {
+    die "Directory $opt_k does not exist\n";
+}
+
+#
+# Code generation.  Each helper returns a list of lines of assembly
+#
+
+# count - Add one to %rax if the word in $reg is positive.  $lab
+# must be unique.  $count is the counting style of the candidate
+sub count {
+    my ($reg, $lab) = @_;
+    if ($count eq "cmov") {
+	return ("\trrmovq %rax, $cmovreg",
+		"\tiaddq \$1, $cmovreg",
+		"\tandq $reg, $reg",
+		"\tcmovg $cmovreg, %rax");
+    }
+    return ("\tandq $reg, $reg",
+	    "\tjle $lab",
+	    "\tiaddq \$1, %rax",
+	    "$lab:");
+}
+
+# copy_word - Copy the word at offset $off from src to dst and count it,
+# through $reg
+sub copy_word {
+    my ($off, $reg, $lab) = @_;
+    return ("\tmrmovq $off(%rdi), $reg",
+	    "\trmmovq $reg, $off(%rsi)",
+	    count($reg, $lab));
+}
+
+# body - One pass of the main loop, copying words 0 to $u-1
+sub body {
+    my ($u, $sched) = @_;
+    my @code = ();
+    my ($i, $a, $b);
+
+    if ($sched eq "group") {
+	for ($i = 0; $i < $u; $i++) {
+	    push @code, "\tmrmovq " . 8*$i . "(%rdi), $regs[$i]";
+	}
+	for ($i = 0; $i < $u; $i++) {
+	    push @code, "\trmmovq $regs[$i], " . 8*$i . "(%rsi)";
+	}
+	for ($i = 0; $i < $u; $i++) {
+	    push @code, count($regs[$i], "L$i");
+	}
+    } elsif ($sched eq "pair") {
+	for ($i = 0; $i + 1 < $u; $i += 2) {
+	    ($a, $b) = ($regs[0], $regs[1]);
+	    push @code, ("\tmrmovq " . 8*$i . "(%rdi), $a",
+			 "\tmrmovq " . 8*($i+1) . "(%rdi), $b",
+			 "\trmmovq $a, " . 8*$i . "(%rsi)",
+			 "\trmmovq $b, " . 8*($i+1) . "(%rsi)",
+			 count($a, "L$i"),
+			 count($b, "L" . ($i+1)));
+	}
+	if ($i < $u) {
+	    push @code, copy_word(8*$i, $regs[0], "L$i");
+	}
+    } else {
+	for ($i = 0; $i < $u; $i++) {
+	    push @code, copy_word(8*$i, $regs[0], "L$i");
+	}
+    }
+    return @code;
+}
+
+# rest - Copy the 0 to $u-1 words left in %rdx by the main loop
+sub rest {
+    my ($u, $rem) = @_;
+    my @code = ();
+    my $k;
+
+    if ($rem eq "loop") {
+	push @code, ("\tjle Done",
+		     "RLoop:",
+		     "\tmrmovq (%rdi), %r8",
+		     "\tiaddq \$8, %rdi",
+		     "\trmmovq %r8, (%rsi)",
+		     "\tiaddq \$8, %rsi",
+		     count("%r8", "RNpos"),
+		     "\tiaddq \$-1, %rdx",
+		     "\tjg RLoop");
+    } elsif ($rem eq "chain") {
+	push @code, "\tjle Done";
+	for ($k = 0; $k < $u - 1; $k++) {
+	    push @code, ("\tmrmovq " . 8*$k . "(%rdi), %r8",
+			 "\tiaddq \$-1, %rdx",
+			 "\trmmovq %r8, " . 8*$k . "(%rsi)",
+			 count("%r8", "R$k"));
+	    if ($k < $u - 2) {
+		push @code, ("\tandq %rdx, %rdx",
+			     "\tjle Done");
+	    }
+	}
+    } else {
+	# %rdx holds the number of words left; jump to entry E<n>,
+	# which copies words n-1 down to 0
+	push @code, ("\taddq %rdx, %rdx",
+		     "\taddq %rdx, %rdx",
+		     "\taddq %rdx, %rdx",
+		     "\tmrmovq Table(%rdx), %rdx",
+		     "\tpushq %rdx",
+		     "\tret");
+	for ($k = $u - 1; $k > 0; $k--) {
+	    push @code, ("E$k:",
+			 copy_word(8*($k-1), "%r8", "R" . ($k-1)));
+	}
+    }
+    return @code;
+}
+
+# gen_ncopy - Return the source of the candidate with unroll factor $u,
+# load schedule $sched, remainder handling $rem and counting style
+# $count
+sub gen_ncopy {
+    my ($u, $sched, $rem);
+    my @code = ();
+    my $k;
+
+    ($u, $sched, $rem, $count) = @_;
+    push @code, ("# ncopy.ys generated by tune-ncopy.pl:",
+		 "# unroll $u, schedule $sched, remainder $rem, count $count",
+		 "# %rdi = src, %rsi = dst, %rdx = len",
+		 "ncopy:",
+		 "\txorq %rax, %rax",
+		 "\tiaddq \$-$u, %rdx",
+		 "\tjl Rest",
+		 "Loop:",
+		 body($u, $sched),
+		 "\tiaddq \$" . 8*$u . ", %rdi",
+		 "\tiaddq \$" . 8*$u . ", %rsi",
+		 "\tiaddq \$-$u, %rdx",
+		 "\tjge Loop",
+		 "Rest:");
+    if ($u > 1) {
+	push @code, ("\tiaddq \$$u, %rdx",
+		     rest($u, $rem));
+    }
+    push @code, ("E0:",
+		 "Done:",
+		 "\tret");
+    if ($u > 1 && $rem eq "table") {
+	push @code, ("\t.align 8",
+		     "Table:");
+	for ($k = 0; $k < $u; $k++) {
+	    push @code, "\t.quad E$k";
+	}
+    }
+    push @code, "End:";
+    return join("\n", @code) . "\n";
+}
+
+# code_len - Length of ncopy in a .yo file, measured as check-len.pl does
+sub code_len {
+    my ($yofile) = @_;
+    my ($start, $end) = (-1, -1);
+
+    open(YO, $yofile) || return -1;
+    while (<YO>) {
+	if (/(0x[0-9a-fA-F]+):.* ncopy:/) {
+	    $start = hex($1);
+	}
+	if (/(0x[0-9a-fA-F]+):.* End:/) {
+	    $end = hex($1);
+	}
+    }
+    close(YO);
+    return ($start >= 0 && $end > $start) ? $end - $start : -1;
+}
+
+#
+# Generate the candidates.  Unroll factors 1 and 2 leave too few words
+# over for the remainder variants to differ, the load schedules differ
+# only from a factor of 2 (pair) or 3 (group), and a group of all the
+# registers leaves none for cmov counting
+#
+@cands = ();
+foreach $u (@unrolls) {
+    foreach $sched (@scheds) {
+	next if ($u < 2 && $sched ne "naive");
+	next if ($u < 3 && $sched eq "group");
+	foreach $rem (@rems) {
+	    next if ($u < 3 && $rem ne "loop");
+	    foreach $count (@counts) {
+		next if ($count eq "cmov" && $sched eq "group" && $u >= @regs);
+		push @cands, { u => $u, sched => $sched, rem => $rem,
+			       count => $count,
+			       name => "u$u-$sched-$rem-$count" };
+	    }
+	}
+    }
+}
+
+#
+# Evaluate them, up to $jobs at a time.  Each worker leaves the output
+# of psim in $fname-NAME.out
+#
+$running = 0;
+foreach $c (@cands) {
+    if ($running >= $jobs) {
+	wait();
+	$running--;
+    }
+    $base = "$fname-$$-$c->{name}";
+    open(YS, ">$base.ys") || die "Couldn't create $base.ys\n";
+    print YS gen_ncopy($c->{u}, $c->{sched}, $c->{rem}, $c->{count});
+    close(YS);
+    $pid = fork();
+    defined($pid) || die "Couldn't fork\n";
+    if ($pid == 0) {
+	exec("$yas $base.ys && $pipe --sweep -j 1 $base.yo > $base.out 2>&1");
+	exit(1);
+    }
+    $running++;
+}
+while ($running > 0) {
+    wait();
+    $running--;
+}
+
+#
+# Collect the results
+#
+@good = ();
+foreach $c (@cands) {
+    $base = "$fname-$$-$c->{name}";
+    $c->{len} = code_len("$base.yo");
+    $c->{pass} = 0;
+    $c->{cpe} = -1;
+    if (open(OUT, "$base.out")) {
+	while (<OUT>) {
+	    if (/^(\d+)\/\d+ pass correctness test/) {
+		$c->{pass} = $1;
+	    }
+	    if (/^Average CPE\s+([0-9.]+)/) {
+		$c->{cpe} = $1;
+	    }
+	}
+	close(OUT);
+    }
+    if ($c->{len} < 0 || $c->{cpe} < 0) {
+	$c->{verdict} = "Couldn't assemble or simulate";
+    } elsif ($c->{len} > $bytelim) {
+	$c->{verdict} = "Too long";
+    } elsif ($c->{pass} != 65) {
+	$c->{verdict} = "Fails $c->{pass}/65";
+    } else {
+	$c->{verdict} = "OK";
+	push @good, $c;
+    }
+    if ($opt_k) {
+	$c->{src} = `cat $base.ys`;
+    }
+    unlink("$base.ys", "$base.yo", "$base.out");
+}
+
+if ($verbose) {
+    print "Candidate\tBytes\tCPE\tResult\n";
+    foreach $c (@cands) {
+	printf "%s\t%d\t%.2f\t%s\n",
+	    $c->{name}, $c->{len}, $c->{cpe}, $c->{verdict};
+    }
+    print "\n";
+}
+
+printf "%d/%d candidates correct and within %d bytes\n",
+    scalar(@good), scalar(@cands), $bytelim;
+if (!@good) {
+    print "Is $pipe built with VERSION=full?\n";
+    exit(1);
+}
+
+#
+# A candidate is on the frontier if no correct candidate at most as
+# long has a lower CPE, or an equal CPE at a shorter length
+#
+@frontier = ();
+$best = -1;
+foreach $c (sort { $a->{len} <=> $b->{len} || $a->{cpe} <=> $b->{cpe} }
+	    @good) {
+    if ($best < 0 || $c->{cpe} < $best) {
+	push @frontier, $c;
+	$best = $c->{cpe};
+    }
+}
+
+print "Pareto frontier of CPE versus length:\n";
+print "Bytes\tCPE\tCandidate\n";
+foreach $c (@frontier) {
+    printf "%d\t%.2f\t%s\n", $c->{len}, $c->{cpe}, $c->{name};
+    if ($opt_k) {
+	open(YS, ">$opt_k/ncopy-$c->{name}.ys") ||
+	    die "Couldn't create $opt_k/ncopy-$c->{name}.ys\n";
+	print YS $c->{src};
+	close(YS);
+    }
+}
@@ -0,0 +1,615 @@
+/*
+ * mtest - Run the ptest regression suites on several PIPE variants at once
+ *
+ * Each variant is a psim built as a shared library (make psim-xxx.so in
+ * ../pipe).  The test programs of optest.pl, jtest.pl, ctest.pl,
+ * htest.pl and etest.pl are generated and assembled in memory, once,
+ * and every variant runs every test on a pool of threads.  A test
+ * passes if the pipeline agrees with the ISA simulator at every
+ * instruction, as with psim -t.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <time.h>
+
+#include "isa.h"
+#include "yas.h"
+#include "pipeline.h"
+#include "sim.h"
+
+#define MAX_VARIANTS 32
+#define INSTR_LIMIT 10000  /* As for psim -t */
+
+/* Test suites, in the order of the ptest scripts */
+typedef enum { S_OP, S_JUMP, S_CTRL, S_HAZ, S_EXC, NSUITES } suite_t;
+
+static char *suite_names[NSUITES] = {"optest", "jtest", "ctest", "htest", "etest"};
+
+/* An assembled test program */
+typedef struct {
+    suite_t suite;
+    char name[32];
+    char *yo;      /* Object code, in .yo form */
+    size_t len;
+} test_rec, *test_ptr;
+
+static test_ptr tests = NULL;
+static int test_cnt = 0;
+static int test_max = 0;
+
+/* What a variant's library provides, with the types that isa.h and
+   sim.h give those functions */
+typedef struct {
+    char *name;
+    void *lib;
+    typeof(init_mem) *init_mem;
+    typeof(load_mem) *load_mem;
+    typeof(sim_ctx_new) *ctx_new;
+    typeof(sim_ctx_check) *ctx_check;
+    typeof(sim_ctx_free) *ctx_free;
+} variant_rec, *variant_ptr;
+
+static variant_rec variants[MAX_VARIANTS];
+static int variant_cnt = 0;
+
+/* Outcome of running one test on one variant */
+typedef struct {
+    bool_t pass;
+    double secs;
+} result_rec;
+
+static result_rec *results;     /* variant_cnt rows of test_cnt */
+static int job_next = 0;        /* Next job for a worker to take */
+
+static bool_t test_iaddq = FALSE;
+static bool_t verbose = FALSE;
+
+static void usage(char *pname)
+{
+    printf("Usage: %s [-hiv] [-j n] lib.so ...\n", pname);
+    printf("   -h     Print this message\n");
+    printf("   -i     Test iaddq instruction\n");
+    printf("   -j n   Run tests on n threads (default: number of CPUs)\n");
+    printf("   -v     List the tests that fail\n");
+    exit(0);
+}
+
+/**************** Generating and assembling tests *****************/
+
+static FILE *ys;         /* Source of test being generated */
+static char *ys_buf;
+static size_t ys_size;
+
+/* Start writing test name of suite */
+static void begin_test(suite_t suite, char *name)
+{
+    test_ptr t;
+    if (test_cnt == test_max) {
+	test_max = test_max ? 2*test_max : 256;
+	tests = (test_ptr) realloc(tests, test_max*sizeof(test_rec));
+    }
+    t = &tests[test_cnt];
+    t->suite = suite;
+    strncpy(t->name, name, sizeof(t->name)-1);
+    t->name[sizeof(t->name)-1] = '\0';
+    ys = open_memstream(&ys_buf, &ys_size);
+}
+
+/* Assemble the test just written */
+static void end_test()
+{
+    test_ptr t = &tests[test_cnt];
+    FILE *in, *out;
+    int err;
+
+    fclose(ys);
+    in = fmemopen(ys_buf, ys_size, "r");
+    out = open_memstream(&t->yo, &t->len);
+    err = yas_assemble(in, out);
+    fclose(in);
+    fclose(out);
+    free(ys_buf);
+    if (err) {
+	fprintf(stderr, "Test %s doesn't assemble\n", t->name);
+	exit(1);
+    }
+    test_cnt++;
+}
+
+/* optest.pl: each instruction on its own */
+static void gen_optest()
+{
+    static int vals[] = {0x100, 0x020, 0x004};
+    static char *instr[] = {"rrmovq", "addq", "subq", "andq", "xorq"};
+    static char *regs[] = {"rdx", "rbx", "rsp"};
+    static char *stack_instr[] = {"pushq", "popq"};
+    static char *stack_regs[] = {"rdx", "rsp"};
+    char name[32];
+    int t, a, b, v;
+
+    for (t = 0; t < 5; t++)
+	for (a = 0; a < 3; a++)
+	    for (b = 0; b < 3; b++) {
+		sprintf(name, "op-%s-%s-%s", instr[t], regs[a], regs[b]);
+		begin_test(S_OP, name);
+		fprintf(ys, "\tirmovq $%d, %%%s\n", vals[0], regs[a]);
+		fprintf(ys, "\tirmovq $%d, %%%s\n", vals[1], regs[b]);
+		fprintf(ys, "\tnop\n\tnop\n\tnop\n");
+		fprintf(ys, "\t%s %%%s,%%%s\n", instr[t], regs[a], regs[b]);
+		fprintf(ys, "\tnop\n\tnop\n\thalt\n");
+		end_test();
+	    }
+
+    if (test_iaddq)
+	for (a = 0; a < 3; a++)
+	    for (v = 0; v < 3; v++) {
+		sprintf(name, "op-iaddq-%d-%s", vals[v], regs[a]);
+		begin_test(S_OP, name);
+		fprintf(ys, "\tirmovq $%d, %%%s\n", vals[v], regs[a]);
+		fprintf(ys, "\tnop\n\tnop\n\tnop\n");
+		fprintf(ys, "\tiaddq $-32, %%%s\n", regs[a]);
+		fprintf(ys, "\tnop\n\tnop\n\thalt\n");
+		end_test();
+	    }
+
+    for (t = 0; t < 2; t++)
+	for (a = 0; a < 2; a++) {
+	    sprintf(name, "op-%s-%s", stack_instr[t], stack_regs[a]);
+	    begin_test(S_OP, name);
+	    fprintf(ys, "\tirmovq $0x200,%%rsp\n");
+	    fprintf(ys, "\tirmovq $%d, %%rax\n", vals[1]);
+	    fprintf(ys, "\tnop\n\tnop\n\tnop\n");
+	    fprintf(ys, "\trmmovq %%rax, 0(%%rsp)\n");
+	    fprintf(ys, "\tirmovq $%d, %%rax\n", vals[2]);
+	    fprintf(ys, "\tnop\n\tnop\n\tnop\n");
+	    fprintf(ys, "\trmmovq %%rax, -4(%%rsp)\n");
+	    fprintf(ys, "\tirmovq $%d, %%rdx\n", vals[0]);
+	    fprintf(ys, "\tnop\n\tnop\n\tnop\n");
+	    fprintf(ys, "\t%s %%%s\n", stack_instr[t], stack_regs[a]);
+	    fprintf(ys, "\tnop\n\tnop\n\thalt\n");
+	    end_test();
+	}
+}
+
+/* jtest.pl: jumps and calls, taken and not, forward and backward */
+static void gen_jtest()
+{
+    static int vals[] = {32, 64};
+    static char *instr[] = {"jmp", "jle", "jl", "je", "jne", "jge", "jg", "call"};
+    static char *setup =
+	"\tirmovq stack, %rsp\n"
+	"\tirmovq $1, %rsi\n"
+	"\tirmovq $2, %rdi\n"
+	"\tirmovq $4, %rbp\n";
+    static char *target =
+	"target:\n"
+	"\taddq %rsi,%rdx\n"
+	"\taddq %rdi,%rdx\n"
+	"\taddq %rbp,%rdx\n"
+	"\tnop\n\tnop\n\thalt\n";
+    static char *fallthru =
+	"\taddq %rsi,%rax\n"
+	"\taddq %rdi,%rax\n"
+	"\taddq %rbp,%rax\n"
+	"\thalt\n";
+    static char *stack = ".pos 0x100\nstack:\n";
+    char name[32];
+    int t, a, b;
+
+    for (t = 0; t < 8; t++)
+	for (a = 0; a < 2; a++)
+	    for (b = 0; b < 2; b++) {
+		sprintf(name, "jf-%s-%d-%d", instr[t], vals[a], vals[b]);
+		begin_test(S_JUMP, name);
+		fputs(setup, ys);
+		fprintf(ys, "\tirmovq $%d, %%rax\n", vals[a]);
+		fprintf(ys, "\tirmovq $%d, %%rdx\n", vals[b]);
+		fprintf(ys, "\tsubq %%rdx,%%rax\n");
+		fprintf(ys, "\t%s target\n", instr[t]);
+		fputs(fallthru, ys);
+		fputs(target, ys);
+		fputs(stack, ys);
+		end_test();
+	    }
+
+    for (t = 0; t < 8; t++)
+	for (a = 0; a < 2; a++)
+	    for (b = 0; b < 2; b++) {
+		sprintf(name, "jb-%s-%d-%d", instr[t], vals[a], vals[b]);
+		begin_test(S_JUMP, name);
+		fputs(setup, ys);
+		fprintf(ys, "\tirmovq $%d, %%rax\n", vals[a]);
+		fprintf(ys, "\tirmovq $%d, %%rdx\n", vals[b]);
+		fprintf(ys, "\tjmp skip\n\thalt\n");
+		fputs(target, ys);
+		fprintf(ys, "skip:\n");
+		fprintf(ys, "\tsubq %%rdx,%%rax\n");
+		fprintf(ys, "\t%s target\n", instr[t]);
+		fputs(fallthru, ys);
+		fputs(stack, ys);
+		end_test();
+	    }
+
+    if (test_iaddq)
+	for (t = 0; t < 8; t++)
+	    for (a = 0; a < 2; a++)
+		for (b = 0; b < 2; b++) {
+		    sprintf(name, "ji-%s-%d-%d", instr[t], vals[a], vals[b]);
+		    begin_test(S_JUMP, name);
+		    fputs(setup, ys);
+		    fprintf(ys, "\tirmovq $%d, %%rax\n", vals[a]);
+		    fprintf(ys, "\tiaddq $-%d,%%rax\n", vals[b]);
+		    fprintf(ys, "\t%s target\n", instr[t]);
+		    fputs(fallthru, ys);
+		    fputs(target, ys);
+		    fputs(stack, ys);
+		    end_test();
+		}
+}
+
+/*
+ * ctest.pl: combinations of pipeline control cases.  Each template
+ * gives four instruction slots, separated by '|', and two templates
+ * combine if no slot holds different instructions in each
+ */
+static void gen_ctest()
+{
+    static char *templates[] = {
+	"||jne target\n\thalt\ntarget:|", /* M */
+	"|||ret",                           /* R */
+	"||mrmovq (%rax),%rsp|ret",         /* G1a */
+	"|mrmovq (%rax),%rsp||ret",         /* G1b */
+	"mrmovq (%rax),%rsp|||ret",         /* G1c */
+	"||irmovq $3,%rax|rrmovq %rax,%rdx", /* G2a */
+	"|irmovq $3,%rax||rrmovq %rax,%rdx", /* G2b */
+	"irmovq $3,%rax|||rrmovq %rax,%rdx", /* G2c */
+    };
+    int ntemp = sizeof(templates)/sizeof(templates[0]);
+    char slots[2][4][64];
+    char name[32];
+    int i1, i2, t, s, cnt = 0;
+
+    for (i1 = 0; i1 < ntemp; i1++)
+	for (i2 = i1+1; i2 < ntemp; i2++) {
+	    bool_t ok = TRUE;
+	    int pick[4];
+	    for (t = 0; t < 2; t++) {
+		char *p = templates[t ? i2 : i1];
+		for (s = 0; s < 4; s++) {
+		    int len = strcspn(p, "|");
+		    memcpy(slots[t][s], p, len);
+		    slots[t][s][len] = '\0';
+		    p += len;
+		    if (*p)
+			p++;
+		}
+	    }
+	    for (s = 0; s < 4; s++) {
+		pick[s] = slots[0][s][0] ? 0 : 1;
+		if (slots[0][s][0] && slots[1][s][0] &&
+		    strcmp(slots[0][s], slots[1][s]) != 0)
+		    ok = FALSE;
+	    }
+	    if (!ok)
+		continue;
+	    sprintf(name, "c-%d", cnt++);
+	    begin_test(S_CTRL, name);
+	    fprintf(ys,
+		    "\tirmovq Stack1,%%rsp\n"
+		    "\tirmovq rtnpt,%%rdx\n"
+		    "\trmmovq %%rdx,(%%rsp)\n"
+		    "\tirmovq Stack2,%%rax\n"
+		    "\trmmovq %%rsp,(%%rax)\n"
+		    "\tirmovq Stack3,%%rsp\n"
+		    "\tpushq %%rdx\n"
+		    "\trrmovq %%rsp,%%rbp\n"
+		    "\tirmovq $3,%%rdx\n"
+		    "\txorq %%rbx,%%rbx\n");
+	    for (s = 0; s < 4; s++)
+		fprintf(ys, "\t%s\n", slots[pick[s]][s][0] ?
+			slots[pick[s]][s] : "nop");
+	    fprintf(ys,
+		    "\tirmovq $3,%%rbx\n"
+		    "\thalt\n"
+		    "rtnpt:\tirmovq $5,%%rsi\n"
+		    "\thalt\n"
+		    ".pos 0x60\nStack1:\n"
+		    ".pos 0x68\nStack2:\n"
+		    ".pos 0x70\nStack3:\n"
+		    "\thalt\n");
+	    end_test();
+	}
+}
+
+/* Write a table of n jump targets named prefix1.. at address pos, padded
+   with halts */
+static void hazard_table(char *pos, char *prefix, int pad)
+{
+    int i;
+    fprintf(ys, ".pos %s\n", pos);
+    for (i = 1; i <= 6; i++)
+	fprintf(ys, "\t.quad %s%d\n", prefix, i);
+    for (i = 1; i <= 6; i++)
+	fprintf(ys, "%s%d:\n\thalt\n", prefix, i);
+    for (i = 0; i < pad; i++)
+	fprintf(ys, "\thalt\n");
+}
+
+/* Instruction i of the hazard test, with the type before the colon */
+static char *hazard_instr(char *s)
+{
+    return strchr(s, ':') + 1;
+}
+
+/* htest.pl: a register written by one instruction and read by another
+   0, 1 or 2 instructions later */
+static void gen_htest()
+{
+    static char *dest[] = {
+	"1:rrmovq %rcx,%rax", "1:irmovq $0x101,%rax", "1:mrmovq 0(%rbp),%rax",
+	"1:addq   %rax,%rax", "1:popq   %rax", "1:cmovne %rcx,%rax",
+	"1:cmove  %rcx,%rax",
+	"2:rrmovq %rax,%rbp", "2:irmovq $0x100,%rbp", "2:mrmovq 4(%rbp),%rbp",
+	"2:addq   %rax,%rbp", "2:popq   %rbp", "2:cmovne %rax,%rbp",
+	"2:cmove  %rax,%rbp",
+	"3:rrmovq %rbp,%rsp", "3:irmovq $0x104,%rsp", "3:mrmovq 4(%rbp),%rsp",
+	"3:addq   %rax,%rsp", "3:popq   %rbp", "3:pushq  %rax",
+	"3:pushq  %rsp", "3:popq   %rsp", "1:cmovne %rbp,%rsp",
+	"1:cmove  %rbp,%rsp",
+	/* With -i */
+	"1:iaddq $0x201,%rax", "2:iaddq $0x4,%rbp", "3:iaddq $0x4,%rsp",
+    };
+    static char *src[] = {
+	"1:rrmovq %rax,%rbp", "1:rmmovq %rax,0(%rbp)", "1:rmmovq %rbp,0(%rax)",
+	"1:mrmovq 4(%rax),%rbp", "1:addq   %rax,%rbp", "1:addq   %rbp,%rax",
+	"1:addq   %rax,%rax", "1:pushq  %rax",
+	"2:rrmovq %rbp,%rbp", "2:rmmovq %rbp,4(%rbp)", "2:rmmovq %rax,0(%rbp)",
+	"2:mrmovq 8(%rbp),%rax", "2:addq   %rbp,%rax", "2:addq   %rax,%rbp",
+	"2:addq   %rbp,%rbp", "2:pushq  %rbp",
+	"3:rrmovq %rsp,%rbp", "3:rmmovq %rsp,4(%rbp)", "3:rmmovq %rax,-4(%rsp)",
+	"3:mrmovq 4(%rsp),%rax", "3:addq   %rsp,%rax", "3:addq   %rax,%rsp",
+	"3:addq   %rsp,%rsp", "3:pushq  %rsp", "3:ret",
+	/* With -i */
+	"1:iaddq $0x301,%rax", "2:iaddq $0x8,%rbp", "3:iaddq $0x8,%rsp",
+    };
+    static char *prefix[] = {"hnn", "hn", "h"};
+    int ndest = sizeof(dest)/sizeof(dest[0]) - (test_iaddq ? 0 : 3);
+    int nsrc = sizeof(src)/sizeof(src[0]) - (test_iaddq ? 0 : 3);
+    char name[32];
+    int d, s, k;
+
+    for (d = 0; d < ndest; d++)
+	for (s = 0; s < nsrc; s++) {
+	    if (dest[d][0] != src[s][0])
+		continue;
+	    /* Two nops between them, one, and none */
+	    for (k = 0; k < 3; k++) {
+		sprintf(name, "%s-%d-%d", prefix[k], d, s);
+		begin_test(S_HAZ, name);
+		fprintf(ys,
+			"\tirmovq $0xf5,%%rax\n"
+			"\tirmovq $0,%%rbp\n"
+			"\trmmovq %%rax,0xe0(%%rbp)\n"
+			"\tirmovq $0xf7,%%rax\n"
+			"\trmmovq %%rax,0xe8(%%rbp)\n"
+			"\tirmovq $0xfb,%%rax\n"
+			"\trmmovq %%rax,0xf0(%%rbp)\n"
+			"\tirmovq $0xff,%%rax\n"
+			"\trmmovq %%rax,0xf8(%%rbp)\n"
+			"\tirmovq $0x100,%%rbp\n"
+			"\tirmovq $0x10c,%%rsp\n"
+			"\txorq %%rax,%%rax\n"
+			"\tirmovq $0x80,%%rax\n");
+		fprintf(ys, "\t%s\n", hazard_instr(dest[d]));
+		fprintf(ys, "\t%s\n", k < 2 ? "nop" : "");
+		fprintf(ys, "\t%s\n", k < 1 ? "nop" : "");
+		fprintf(ys, "\t%s\n", hazard_instr(src[s]));
+		fprintf(ys, "\trrmovq %%rsp,%%rbp\n\thalt\n");
+		hazard_table("0x08", "pos0", 14);
+		hazard_table("0x100", "pos1", 9);
+		hazard_table("0x180", "pos2", 9);
+		end_test();
+	    }
+	}
+}
+
+/* etest.pl: an exception followed closely by an instruction that
+   changes the condition codes or memory */
+static void gen_etest()
+{
+    static char *stateset[] = {"andq %rcx,%rcx", "rmmovq %rcx,(%rax)"};
+    static char *exceptset[] = {"halt", ".byte 0xFF",
+				"rmmovq %rax,0xF0000000(%rax)"};
+    char name[32];
+    int e, s, k;
+
+    for (e = 0; e < 3; e++)
+	for (s = 0; s < 2; s++)
+	    for (k = 0; k < 2; k++) {
+		sprintf(name, "%s-%d-%d", k ? "e" : "en", e, s);
+		begin_test(S_EXC, name);
+		fprintf(ys,
+			"\tirmovq $-1,%%rcx\n"
+			"\tirmovq $0x100,%%rax\n"
+			"\txorq %%rdx,%%rdx\n");
+		fprintf(ys, "\t%s\n", exceptset[e]);
+		fprintf(ys, "\t%s\n", k ? "" : "nop");
+		fprintf(ys, "\t%s\n", stateset[s]);
+		fprintf(ys, "\tnop\n\tnop\n\thalt\n");
+		end_test();
+	    }
+}
+
+/************************ Running tests ***************************/
+
+static void *load_sym(variant_ptr v, char *sym)
+{
+    void *p = dlsym(v->lib, sym);
+    if (!p) {
+	fprintf(stderr, "%s: no symbol %s\n", v->name, sym);
+	exit(1);
+    }
+    return p;
+}
+
+/* Load the simulator library at path */
+static void load_variant(char *path)
+{
+    variant_ptr v = &variants[variant_cnt++];
+    char *simname, *colon;
+
+    v->lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!v->lib) {
+	fprintf(stderr, "Couldn't load %s: %s\n", path, dlerror());
+	exit(1);
+    }
+    v->name = path;
+    simname = load_sym(v, "simname");
+    if ((colon = strrchr(simname, ':')) != NULL)
+	v->name = colon + 2;
+    v->init_mem = load_sym(v, "init_mem");
+    v->load_mem = load_sym(v, "load_mem");
+    v->ctx_new = load_sym(v, "sim_ctx_new");
+    v->ctx_check = load_sym(v, "sim_ctx_check");
+    v->ctx_free = load_sym(v, "sim_ctx_free");
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Run test t on variant v */
+static bool_t run_test(variant_ptr v, test_ptr t)
+{
+    mem_t m = v->init_mem(MEM_SIZE);
+    FILE *f = fmemopen(t->yo, t->len, "r");
+    sim_ctx_ptr c;
+    bool_t pass;
+
+    if (v->load_mem(m, f, 0) == 0) {
+	fclose(f);
+	return FALSE;
+    }
+    fclose(f);
+    c = v->ctx_new(m, 0, NULL);
+    pass = v->ctx_check(c, INSTR_LIMIT, 5*INSTR_LIMIT);
+    v->ctx_free(c);
+    return pass;
+}
+
+/* Worker thread, which takes jobs one at a time.  Job j is test
+   j % test_cnt on variant j / test_cnt */
+static void *worker(void *arg)
+{
+    int njobs = variant_cnt * test_cnt;
+    int j;
+
+    while ((j = __sync_fetch_and_add(&job_next, 1)) < njobs) {
+	double start = now();
+	results[j].pass = run_test(&variants[j / test_cnt],
+				   &tests[j % test_cnt]);
+	results[j].secs = now() - start;
+    }
+    return NULL;
+}
+
+/* Print the pass counts of each variant on each suite */
+static int print_table(double wall, int nworkers)
+{
+    int total[NSUITES] = {0};
+    int i, s, j, fails = 0;
+
+    for (j = 0; j < test_cnt; j++)
+	total[tests[j].suite]++;
+    printf("%-20s", "Variant");
+    for (s = 0; s < NSUITES; s++)
+	printf("%10s", suite_names[s]);
+    printf("%10s\n", "Seconds");
+    for (i = 0; i < variant_cnt; i++) {
+	int pass[NSUITES] = {0};
+	double secs = 0.0;
+	char cell[32];
+	for (j = 0; j < test_cnt; j++) {
+	    result_rec *r = &results[i*test_cnt + j];
+	    if (r->pass)
+		pass[tests[j].suite]++;
+	    else
+		fails++;
+	    secs += r->secs;
+	}
+	printf("%-20s", variants[i].name);
+	for (s = 0; s < NSUITES; s++) {
+	    sprintf(cell, "%d/%d", pass[s], total[s]);
+	    printf("%10s", cell);
+	}
+	printf("%10.3f\n", secs);
+    }
+    printf("%d tests on %d variants in %.3f seconds on %d threads\n",
+	   test_cnt, variant_cnt, wall, nworkers);
+    if (verbose)
+	for (i = 0; i < variant_cnt; i++)
+	    for (j = 0; j < test_cnt; j++)
+		if (!results[i*test_cnt + j].pass)
+		    printf("%s: Test %s failed\n", variants[i].name,
+			   tests[j].name);
+    return fails;
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t *workers;
+    int nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+    double start;
+    int c, w, fails;
+
+    while ((c = getopt(argc, argv, "hij:v")) != -1) {
+	switch(c) {
+	case 'i':
+	    test_iaddq = TRUE;
+	    break;
+	case 'j':
+	    nworkers = atoi(optarg);
+	    break;
+	case 'v':
+	    verbose = TRUE;
+	    break;
+	case 'h':
+	default:
+	    usage(argv[0]);
+	}
+    }
+    if (optind == argc || argc - optind > MAX_VARIANTS)
+	usage(argv[0]);
+    if (nworkers < 1)
+	nworkers = 1;
+
+    start = now();
+    for (; optind < argc; optind++)
+	load_variant(argv[optind]);
+    gen_optest();
+    gen_jtest();
+    gen_ctest();
+    gen_htest();
+    gen_etest();
+
+    results = (result_rec *) calloc(variant_cnt * test_cnt, sizeof(result_rec));
+    workers = (pthread_t *) malloc(nworkers * sizeof(pthread_t));
+    for (w = 0; w < nworkers; w++)
+	if (pthread_create(&workers[w], NULL, worker, NULL) != 0) {
+	    fprintf(stderr, "Couldn't start worker\n");
+	    exit(1);
+	}
+    for (w = 0; w < nworkers; w++)
+	pthread_join(workers[w], NULL);
+
+    fails = print_table(now() - start, nworkers);
+    return fails > 0;
+}
@@ -13,6 +13,7 @@
 #include <string.h>
 #include "isa.h"
 #include "sim.h"
+#include "trace.h"
 
 #define MAXBUF 1024
 
@@ -42,6 +43,9 @@ FILE *object_file;       /* Input file handle */
 bool_t verbosity = 2;    /* Verbosity level [TTY only] (-v) */ 
 word_t instr_limit = 10000; /* Instruction limit [TTY only] (-l) */
 bool_t do_check = FALSE; /* Test with YIS? [TTY only] (-t) */
+word_t mem_size = MEM_SIZE; /* Memory size in bytes (-m) */
+char *trace_filename = NULL; /* Binary cycle trace file (-T) */
+bool_t fast_mode = FALSE; /* Skip logging and display work? [TTY only] (-f) */
 
 /************* 
  * End Globals 
@@ -83,7 +87,7 @@ int sim_main(int argc, char **argv)
 
     
     /* Parse the command line arguments */
-    while ((c = getopt(argc, argv, "htgl:v:")) != -1) {
+    while ((c = getopt(argc, argv, "htgfl:v:m:T:")) != -1) {
 	switch(c) {
 	case 'h':
 	    usage(argv[0]);
@@ -101,9 +105,22 @@ int sim_main(int argc, char **argv)
 	case 't':
 	    do_check = TRUE;
 	    break;
+	case 'm':
+	    mem_size = parse_mem_size(optarg);
+	    if (mem_size <= 0) {
+		printf("Invalid memory size '%s'\n", optarg);
+		usage(argv[0]);
+	    }
+	    break;
 	case 'g':
 	    gui_mode = TRUE;
 	    break;
+	case 'f':
+	    fast_mode = TRUE;
+	    break;
+	case 'T':
+	    trace_filename = optarg;
+	    break;
 	default:
 	    printf("Invalid option '%c'\n", c);
 	    usage(argv[0]);
@@ -112,6 +129,15 @@ int sim_main(int argc, char **argv)
     }
 
 
+    if (gui_mode && trace_filename) {
+	printf("Option -T cannot be used in GUI mode\n");
+	usage(argv[0]);
+    }
+    if (gui_mode && fast_mode) {
+	printf("Option -f cannot be used in GUI mode\n");
+	usage(argv[0]);
+    }
+
     /* Do we have too many arguments? */
     if (optind < argc - 1) {
 	printf("Too many command line arguments:");
@@ -206,7 +232,7 @@ static void run_tty_sim()
     }
 
     /* Initializations */
-    if (verbosity >= 2)
+    if (verbosity >= 2 && !fast_mode)
 	sim_set_dumpfile(stdout);
     sim_init();
 
@@ -234,7 +260,13 @@ static void run_tty_sim()
     reg0 = copy_mem(reg);
     
 
+    if (trace_filename && !trace_open(trace_filename, TRACE_SEQ, simname)) {
+	fprintf(stderr, "Couldn't open trace file %s\n", trace_filename);
+	exit(1);
+    }
     icount = sim_run(instr_limit, &status, &result_cc);
+    if (trace_filename)
+	trace_close();
     if (verbosity > 0) {
 	printf("%lld instructions executed\n", icount);
 	printf("Status = %s\n", stat_name(status));
@@ -250,7 +282,7 @@ static void run_tty_sim()
 	bool_t match = TRUE;
 
 	for (step = 0; step < instr_limit && e == STAT_AOK; step++) {
-	    e = step_state(isa_state, stdout);
+	    e = step_state_fast(isa_state, stdout);
 	}
 
 	if (diff_reg(isa_state->r, reg, NULL)) {
@@ -289,13 +321,18 @@ static void run_tty_sim()
  */
 static void usage(char *name)
 {
-    printf("Usage: %s [-htg] [-l m] [-v n] file.yo\n", name);
+    printf("Usage: %s [-htgf] [-T f] [-l m] [-v n] [-m s] file.yo\n", name);
     printf("file.yo required in GUI mode, optional in TTY mode (default stdin)\n");
     printf("   -h     Print this message\n");
     printf("   -g     Run in GUI mode instead of TTY mode (default TTY)\n");  
     printf("   -l m   Set instruction limit to m [TTY mode only] (default %lld)\n", instr_limit);
     printf("   -v n   Set verbosity level to 0 <= n <= 2 [TTY mode only] (default %d)\n", verbosity);
     printf("   -t     Test result against ISA simulator (yis) [TTY mode only]\n");
+    printf("   -f     Fast mode: compute only the signals that update the state,\n");
+    printf("          without the per-instruction log of -v 2 [TTY mode only]\n");
+    printf("   -T f   Write a binary trace of every cycle to file f, to be read\n");
+    printf("          with ../misc/ytrace [TTY mode only]\n");
+    printf("   -m s   Set memory size to s bytes, with optional K/M/G suffix (default %d)\n", MEM_SIZE);
     exit(0);
 }
 
@@ -546,7 +583,7 @@ void sim_init()
 
     /* Create memory and register files */
     initialized = 1;
-    mem = init_mem(MEM_SIZE);
+    mem = init_mem(mem_size);
     reg = init_reg();
     sim_reset();
     clear_mem(mem);
@@ -783,6 +820,119 @@ static byte_t sim_step()
     return status;
 }
 
+/*
+ * Execute one instruction in fast mode (-f), returning the resulting
+ * status.  The control logic is evaluated as in sim_step, but the
+ * step does no logging or display work, and it skips the signals
+ * that only the GUI and the SEQ+ PC logic look at.  mem_data is only
+ * computed for a write, and bcond only for SEQ+.
+ */
+static byte_t sim_step_fast()
+{
+    word_t aluA;
+    word_t aluB;
+    word_t alufun;
+    byte_t regids;
+
+    imem_error = dmem_error = FALSE;
+
+    /* Update state from last cycle, as update_state does */
+    if (plusmode) {
+	prev_icode = prev_icode_in;
+	prev_ifun  = prev_ifun_in;
+	prev_valc  = prev_valc_in;
+	prev_valm  = prev_valm_in;
+	prev_valp  = prev_valp_in;
+	prev_bcond = prev_bcond_in;
+	pc = gen_pc();
+    } else {
+	pc = pc_in;
+    }
+    cc = cc_in;
+    if (destE != REG_NONE)
+	set_reg_val(reg, destE, vale);
+    if (destM != REG_NONE)
+	set_reg_val(reg, destM, valm);
+    if (mem_write)
+	set_word_val(mem, mem_addr, mem_data);
+
+    /* Fetch */
+    status = STAT_AOK;
+    instr = HPACK(I_NOP, F_NONE);
+    imem_error = !get_byte_val(mem, pc, &instr);
+    imem_icode = HI4(instr);
+    imem_ifun = LO4(instr);
+    icode = gen_icode();
+    ifun  = gen_ifun();
+    instr_valid = gen_instr_valid();
+    valp = pc + 1;
+    ra = REG_NONE;
+    rb = REG_NONE;
+    if (gen_need_regids()) {
+	if (get_byte_val(mem, valp, &regids)) {
+	    ra = GET_RA(regids);
+	    rb = GET_RB(regids);
+	} else
+	    status = STAT_ADR;
+	valp++;
+    }
+    valc = 0;
+    if (gen_need_valC()) {
+	if (!get_word_val(mem, valp, &valc)) {
+	    valc = 0;
+	    status = STAT_ADR;
+	}
+	valp += 8;
+    }
+    if (status == STAT_AOK && icode == I_HALT)
+	status = STAT_HLT;
+
+    /* Decode and execute */
+    srcA = gen_srcA();
+    vala = srcA != REG_NONE ? get_reg_val(reg, srcA) : 0;
+    srcB = gen_srcB();
+    valb = srcB != REG_NONE ? get_reg_val(reg, srcB) : 0;
+    cond = cond_holds(cc, ifun);
+    destE = gen_dstE();
+    destM = gen_dstM();
+    aluA = gen_aluA();
+    aluB = gen_aluB();
+    alufun = gen_alufun();
+    vale = compute_alu(alufun, aluA, aluB);
+    cc_in = cc;
+    if (gen_set_cc())
+	cc_in = compute_cc(alufun, aluA, aluB);
+
+    /* Memory */
+    mem_addr = gen_mem_addr();
+    if (gen_mem_read()) {
+	if (!get_word_val(mem, mem_addr, &valm))
+	    dmem_error = TRUE;
+    } else
+	valm = 0;
+    mem_write = gen_mem_write();
+    if (mem_write) {
+	word_t junk;
+	mem_data = gen_mem_data();
+	dmem_error = dmem_error || !get_word_val(mem, mem_addr, &junk);
+    }
+
+    status = gen_Stat();
+
+    if (plusmode) {
+	bcond = cond && (icode == I_JMP);
+	prev_icode_in = icode;
+	prev_ifun_in = ifun;
+	prev_valc_in = valc;
+	prev_valm_in = valm;
+	prev_valp_in = valp;
+	prev_bcond_in = bcond;
+    } else {
+	pc_in = gen_new_pc();
+    }
+    return status;
+}
+
 /*
   Run processor until one of following occurs:
   - An error status is encountered in WB.
@@ -792,12 +942,32 @@ static byte_t sim_step()
   if statusp nonnull, then will be set to status of final instruction
   if ccp nonnull, then will be set to condition codes of final instruction
 */
+/* Append the record for cycle cyc to the trace (-T) */
+static void trace_step(word_t cyc)
+{
+    static trace_rec_t rec;
+
+    rec.cycle = cyc;
+    rec.pc[0] = pc;
+    rec.instr[0] = HPACK(icode, ifun);
+    rec.stat[0] = status;
+    rec.vala = vala;
+    rec.valb = valb;
+    rec.vale = vale;
+    rec.valm = valm;
+    rec.cc = cc;
+    rec.status = status;
+    trace_write(&rec);
+}
+
 word_t sim_run(word_t max_instr, byte_t *statusp, cc_t *ccp)
 {
     word_t icount = 0;
     byte_t run_status = STAT_AOK;
     while (icount < max_instr) {
-	run_status = sim_step();
+	run_status = fast_mode ? sim_step_fast() : sim_step();
+	if (trace_filename)
+	    trace_step(icount);
 	icount++;
 	if (run_status != STAT_AOK)
 	    break;